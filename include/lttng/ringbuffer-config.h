@@ -126,6 +126,14 @@ struct lttng_ust_lib_ring_buffer_client_cb {
  * RING_BUFFER_ALLOC_GLOBAL and RING_BUFFER_SYNC_GLOBAL :
  *   Global shared buffer with global synchronization.
  *
+ * RING_BUFFER_ALLOC_PER_THREAD and RING_BUFFER_SYNC_GLOBAL :
+ *   Pool of buffers, each claimed lazily by the first thread writing to
+ *   it. The owner thread is the only writer on the fast path, so the
+ *   reservation is uncontended, but the switch timer and consumer
+ *   flush can still race with it, hence the global synchronization.
+ *   When the pool is exhausted, threads share buffers. No processor ID
+ *   lookup is performed.
+ *
  * wakeup:
  *
  * RING_BUFFER_WAKEUP_BY_TIMER uses per-cpu deferrable timers to poll the
@@ -145,6 +153,7 @@ struct lttng_ust_lib_ring_buffer_client_cb {
 enum lttng_ust_lib_ring_buffer_alloc_types {
 	RING_BUFFER_ALLOC_PER_CPU,
 	RING_BUFFER_ALLOC_GLOBAL,
+	RING_BUFFER_ALLOC_PER_THREAD,
 };
 
 enum lttng_ust_lib_ring_buffer_sync_types {
@@ -382,6 +391,9 @@ int lib_ring_buffer_check_config(const struct lttng_ust_lib_ring_buffer_config *
 	    && config->sync == RING_BUFFER_SYNC_PER_CPU
 	    && switch_timer_interval)
 		return -EINVAL;
+	if (config->alloc == RING_BUFFER_ALLOC_PER_THREAD
+	    && config->sync != RING_BUFFER_SYNC_GLOBAL)
+		return -EINVAL;
 	return 0;
 }
 
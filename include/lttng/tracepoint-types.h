@@ -35,7 +35,8 @@ struct lttng_ust_tracepoint {
 	struct lttng_ust_tracepoint_probe *probes;
 	int *tracepoint_provider_ref;
 	const char *signature;
-	char padding[LTTNG_UST_TRACEPOINT_PADDING];
+	unsigned int name_hash;		/* Computed at registration */
+	char padding[LTTNG_UST_TRACEPOINT_PADDING - sizeof(unsigned int)];
 };
 
 #endif /* _LTTNG_TRACEPOINT_TYPES_H */
@@ -58,6 +58,30 @@ extern "C" {
 			do_tracepoint(provider, name, __VA_ARGS__);	    \
 	} while (0)
 
+/*
+ * tracepoint_batch: emit @nr records of a tracepoint in a loop, with
+ * @iter (declared by the macro) counting from 0 to @nr - 1 and usable
+ * within the arguments. The records are staged by the tracer and
+ * written with a single ring buffer reservation per channel. The whole
+ * batch is a single RCU read-side critical section: keep the argument
+ * expressions short.
+ */
+#define tracepoint_batch(provider, name, nr, iter, ...)			    \
+	do {								    \
+		unsigned int iter;					    \
+		int __tp_batch = tracepoint_enabled(provider, name);	    \
+									    \
+		if (__tp_batch)						    \
+			__tracepoint_batch_begin();			    \
+		for (iter = 0; iter < (nr); iter++) {			    \
+			STAP_PROBEV(provider, name, ## __VA_ARGS__);	    \
+			if (__tp_batch)					    \
+				do_tracepoint(provider, name, __VA_ARGS__); \
+		}							    \
+		if (__tp_batch)						    \
+			__tracepoint_batch_end();			    \
+	} while (0)
+
 #define TP_ARGS(...)       __VA_ARGS__
 
 /*
@@ -222,10 +246,30 @@ struct lttng_ust_tracepoint_dlopen {
 	void (*rcu_read_unlock_sym_bp)(void);
 	void *(*rcu_dereference_sym_bp)(void *p);
 #endif
+	void (*tp_batch_begin_sym)(void);
+	void (*tp_batch_end_sym)(void);
 };
 
 extern struct lttng_ust_tracepoint_dlopen tracepoint_dlopen;
 
+static inline lttng_ust_notrace
+void __tracepoint_batch_begin(void);
+static inline
+void __tracepoint_batch_begin(void)
+{
+	if (tracepoint_dlopen.tp_batch_begin_sym)
+		tracepoint_dlopen.tp_batch_begin_sym();
+}
+
+static inline lttng_ust_notrace
+void __tracepoint_batch_end(void);
+static inline
+void __tracepoint_batch_end(void)
+{
+	if (tracepoint_dlopen.tp_batch_end_sym)
+		tracepoint_dlopen.tp_batch_end_sym();
+}
+
 #if defined(TRACEPOINT_DEFINE) || defined(TRACEPOINT_CREATE_PROBES)
 
 /*
@@ -275,6 +319,26 @@ __tracepoint__init_urcu_sym(void)
 }
 #endif
 
+static inline void lttng_ust_notrace
+__tracepoint__init_batch_sym(void);
+static inline void
+__tracepoint__init_batch_sym(void)
+{
+	/*
+	 * Symbols below are needed by tracepoint_batch() call sites.
+	 */
+	if (!tracepoint_dlopen.tp_batch_begin_sym)
+		tracepoint_dlopen.tp_batch_begin_sym =
+			URCU_FORCE_CAST(void (*)(void),
+				dlsym(tracepoint_dlopen.liblttngust_handle,
+					"tp_batch_begin"));
+	if (!tracepoint_dlopen.tp_batch_end_sym)
+		tracepoint_dlopen.tp_batch_end_sym =
+			URCU_FORCE_CAST(void (*)(void),
+				dlsym(tracepoint_dlopen.liblttngust_handle,
+					"tp_batch_end"));
+}
+
 static void lttng_ust_notrace __attribute__((constructor))
 __tracepoints__init(void);
 static void
@@ -289,6 +353,7 @@ __tracepoints__init(void)
 	if (!tracepoint_dlopen.liblttngust_handle)
 		return;
 	__tracepoint__init_urcu_sym();
+	__tracepoint__init_batch_sym();
 }
 
 static void lttng_ust_notrace __attribute__((destructor))
@@ -359,6 +424,7 @@ extern struct lttng_ust_tracepoint * const __stop___tracepoints_ptrs[]
 			NULL,							\
 			_TRACEPOINT_UNDEFINED_REF(_provider), 			\
 			_TP_EXTRACT_STRING(_args),				\
+			0,							\
 			{ },							\
 		};								\
 	static struct lttng_ust_tracepoint *					\
@@ -387,6 +453,7 @@ __tracepoints__ptrs_init(void)
 				dlsym(tracepoint_dlopen.liblttngust_handle,
 					"tracepoint_unregister_lib"));
 	__tracepoint__init_urcu_sym();
+	__tracepoint__init_batch_sym();
 	if (tracepoint_dlopen.tracepoint_register_lib) {
 		tracepoint_dlopen.tracepoint_register_lib(__start___tracepoints_ptrs,
 				__stop___tracepoints_ptrs -
@@ -621,3 +688,25 @@ enum {
 #define TRACEPOINT_MODEL_EMF_URI(provider, name, uri)
 
 #endif /* #ifndef TRACEPOINT_MODEL_EMF_URI */
+
+#ifndef TRACEPOINT_STATIC_FILTER
+
+/*
+ * Declare a static filter for a tracepoint: a C expression over the
+ * tracepoint arguments, compiled within the probe. The first field is
+ * the provider name, the second field is the name of the tracepoint,
+ * the third field repeats the arguments of the TRACEPOINT_EVENT, and
+ * the fourth field is the expression, which must be true for the event
+ * to be recorded.
+ *
+ *      TRACEPOINT_STATIC_FILTER(< [com_company_]project[_component] >,
+ *              < event >, TP_ARGS(< args >), < expression >)
+ *
+ * The static filter is evaluated in the sessions which enable it on the
+ * event enablers, before any filter bytecode. A TRACEPOINT_EVENT should
+ * be declared prior to the TRACEPOINT_STATIC_FILTER for a given
+ * tracepoint name.
+ */
+#define TRACEPOINT_STATIC_FILTER(provider, name, args, expr)
+
+#endif /* #ifndef TRACEPOINT_STATIC_FILTER */
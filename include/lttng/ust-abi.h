@@ -43,7 +43,7 @@
 
 /* Version for ABI between liblttng-ust, sessiond, consumerd */
 #define LTTNG_UST_ABI_MAJOR_VERSION		6
-#define LTTNG_UST_ABI_MINOR_VERSION		0
+#define LTTNG_UST_ABI_MINOR_VERSION		1
 
 enum lttng_ust_instrumentation {
 	LTTNG_UST_TRACEPOINT		= 0,
@@ -64,6 +64,7 @@ enum lttng_ust_output {
 enum lttng_ust_chan_type {
 	LTTNG_UST_CHAN_PER_CPU = 0,
 	LTTNG_UST_CHAN_METADATA = 1,
+	LTTNG_UST_CHAN_PER_THREAD = 2,
 };
 
 struct lttng_ust_tracer_version {
@@ -181,6 +182,31 @@ struct lttng_ust_tracepoint_iter {
 	char padding[LTTNG_UST_TRACEPOINT_ITER_PADDING];
 } LTTNG_PACKED;
 
+/*
+ * Filter statistics of an event: events seen and kept by the sampling
+ * and rate limiting operators of its filters, summed over filters and
+ * cpus. The evaluation statistics are only kept when the application
+ * runs with LTTNG_UST_FILTER_STATS set. Events evaluating a static
+ * filter are listed even without statistics. cycles[i] counts the filter
+ * evaluations which took [2^(i-1), 2^i) cycles, or nanoseconds on
+ * architectures without a cycle counter, the last bucket counting all
+ * the longer ones.
+ */
+#define LTTNG_UST_FILTER_STATS_NR_BUCKETS	32
+#define LTTNG_UST_FILTER_STATS_ITER_PADDING	32
+struct lttng_ust_filter_stats_iter {
+	char event_name[LTTNG_UST_SYM_NAME_LEN];
+	int session_handle;
+	int channel_handle;
+	uint64_t sample_seen;			/* sampling operators */
+	uint64_t sample_kept;
+	uint64_t evaluations;			/* LTTNG_UST_FILTER_STATS */
+	uint64_t accepts;
+	uint64_t cycles[LTTNG_UST_FILTER_STATS_NR_BUCKETS];
+	char static_filter[LTTNG_UST_SYM_NAME_LEN];	/* expression, if evaluated */
+	char padding[LTTNG_UST_FILTER_STATS_ITER_PADDING];
+} LTTNG_PACKED;
+
 enum lttng_ust_object_type {
 	LTTNG_UST_OBJECT_TYPE_UNKNOWN = -1,
 	LTTNG_UST_OBJECT_TYPE_CHANNEL = 0,
@@ -261,6 +287,7 @@ struct lttng_ust_event_exclusion {
 #define LTTNG_UST_WAIT_QUIESCENT		_UST_CMD(0x43)
 #define LTTNG_UST_REGISTER_DONE			_UST_CMD(0x44)
 #define LTTNG_UST_TRACEPOINT_FIELD_LIST		_UST_CMD(0x45)
+#define LTTNG_UST_FILTER_STATS_LIST		_UST_CMD(0x46)
 
 /* Session FD commands */
 #define LTTNG_UST_CHANNEL			\
@@ -286,10 +313,13 @@ struct lttng_ust_event_exclusion {
 /* Tracepoint list commands */
 #define LTTNG_UST_TRACEPOINT_LIST_GET		_UST_CMD(0x90)
 #define LTTNG_UST_TRACEPOINT_FIELD_LIST_GET	_UST_CMD(0x91)
+#define LTTNG_UST_FILTER_STATS_LIST_GET		_UST_CMD(0x92)
 
 /* Event FD commands */
 #define LTTNG_UST_FILTER			_UST_CMD(0xA0)
 #define LTTNG_UST_EXCLUSION			_UST_CMD(0xA1)
+#define LTTNG_UST_STATIC_FILTER			_UST_CMD(0xA2)
+#define LTTNG_UST_CLEAR_STATIC_FILTER		_UST_CMD(0xA3)
 
 #define LTTNG_UST_ROOT_HANDLE	0
 
@@ -307,6 +337,9 @@ union ust_args {
 	struct {
 		struct lttng_ust_field_iter entry;
 	} field_list;
+	struct {
+		struct lttng_ust_filter_stats_iter entry;
+	} filter_stats_list;
 };
 
 struct lttng_ust_objd_ops {
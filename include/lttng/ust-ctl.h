@@ -43,6 +43,35 @@
 struct lttng_ust_shm_handle;
 struct lttng_ust_lib_ring_buffer;
 
+/*
+ * Stream reader wakeup mechanism. USTCTL_WAKEUP_EVENTFD uses a single
+ * eventfd per stream for both wait and wakeup. Older applications only
+ * understand USTCTL_WAKEUP_PIPE, and wake the reader up by writing one
+ * byte, which an eventfd rejects. USTCTL_WAKEUP_EVENTFD should thus only
+ * be requested for buffers written by applications registered with
+ * LTTNG_UST_ABI minor version >= 1 exclusively, e.g. per-PID buffers of
+ * such an application. Per-UID buffers, shared by applications of
+ * different versions, should keep USTCTL_WAKEUP_PIPE.
+ */
+enum ustctl_wakeup {
+	USTCTL_WAKEUP_PIPE = 0,
+	USTCTL_WAKEUP_EVENTFD = 1,
+};
+
+/*
+ * Pages backing the stream buffers. Transparent huge pages are advised
+ * on the stream mappings. Hugetlb pages are taken from stream files on
+ * hugetlbfs if they already are, else the stream fds are replaced by
+ * anonymous MFD_HUGETLB memfds. Both fall back on base pages when huge
+ * pages are unavailable: ustctl_get_mmap_page_size() reports the page
+ * size actually obtained.
+ */
+enum ustctl_page_type {
+	USTCTL_PAGE_DEFAULT = 0,
+	USTCTL_PAGE_THP = 1,
+	USTCTL_PAGE_HUGETLB = 2,
+};
+
 struct ustctl_consumer_channel_attr {
 	enum lttng_ust_chan_type type;
 	uint64_t subbuf_size;			/* bytes */
@@ -55,6 +84,20 @@ struct ustctl_consumer_channel_attr {
 	unsigned char uuid[LTTNG_UST_UUID_LEN]; /* Trace session unique ID */
 } LTTNG_PACKED;
 
+/*
+ * Channel attributes added after struct ustctl_consumer_channel_attr,
+ * which is frozen, given to ustctl_create_channel_ext(). Zeroed fields
+ * select the ustctl_create_channel() defaults. New attributes take
+ * their room from the padding, so the structure size does not change.
+ */
+#define USTCTL_CONSUMER_CHANNEL_EXT_ATTR_PADDING	52
+struct ustctl_consumer_channel_ext_attr {
+	enum ustctl_wakeup wakeup;		/* pipe, eventfd */
+	enum ustctl_page_type page_type;	/* default, thp, hugetlb */
+	int lazy_alloc;				/* 1: commit sub-buffers on first use */
+	char padding[USTCTL_CONSUMER_CHANNEL_EXT_ATTR_PADDING];
+} LTTNG_PACKED;
+
 /*
  * API used by sessiond.
  */
@@ -76,6 +119,8 @@ int ustctl_set_filter(int sock, struct lttng_ust_filter_bytecode *bytecode,
 		struct lttng_ust_object_data *obj_data);
 int ustctl_set_exclusion(int sock, struct lttng_ust_event_exclusion *exclusion,
 		struct lttng_ust_object_data *obj_data);
+int ustctl_set_static_filter(int sock, struct lttng_ust_object_data *obj_data);
+int ustctl_clear_static_filter(int sock, struct lttng_ust_object_data *obj_data);
 
 int ustctl_enable(int sock, struct lttng_ust_object_data *object);
 int ustctl_disable(int sock, struct lttng_ust_object_data *object);
@@ -110,6 +155,22 @@ int ustctl_tracepoint_field_list(int sock);
 int ustctl_tracepoint_field_list_get(int sock, int tp_field_list_handle,
 		struct lttng_ust_field_iter *iter);
 
+/*
+ * ustctl_filter_stats_list returns a handle on a snapshot of the filter
+ * statistics of the events, or negative error value. Evaluation
+ * statistics are only kept by applications running with
+ * LTTNG_UST_FILTER_STATS set.
+ */
+int ustctl_filter_stats_list(int sock);
+
+/*
+ * ustctl_filter_stats_list_get is used to iterate on the filter stats
+ * list handle. End is iteration is reached when -LTTNG_UST_ERR_NOENT
+ * is returned.
+ */
+int ustctl_filter_stats_list_get(int sock, int filter_stats_list_handle,
+		struct lttng_ust_filter_stats_iter *iter);
+
 int ustctl_tracer_version(int sock, struct lttng_ust_tracer_version *v);
 int ustctl_wait_quiescent(int sock);
 
@@ -148,11 +209,25 @@ struct ustctl_consumer_channel;
 struct ustctl_consumer_stream;
 struct ustctl_consumer_channel_attr;
 
+/*
+ * Number of streams of a per-cpu channel. Per-thread channels
+ * (LTTNG_UST_CHAN_PER_THREAD) have a stream pool sized by the caller
+ * through the number of stream file descriptors given to
+ * ustctl_create_channel().
+ */
 int ustctl_get_nr_stream_per_channel(void);
 
 struct ustctl_consumer_channel *
 	ustctl_create_channel(struct ustctl_consumer_channel_attr *attr,
 		const int *stream_fds, int nr_stream_fds);
+/*
+ * Same as ustctl_create_channel(), with the attributes of @ext_attr.
+ * Returns NULL if @ext_attr holds unknown values.
+ */
+struct ustctl_consumer_channel *
+	ustctl_create_channel_ext(struct ustctl_consumer_channel_attr *attr,
+		const struct ustctl_consumer_channel_ext_attr *ext_attr,
+		const int *stream_fds, int nr_stream_fds);
 /*
  * Each stream created needs to be destroyed before calling
  * ustctl_destroy_channel().
@@ -185,6 +260,12 @@ int ustctl_stream_close_wait_fd(struct ustctl_consumer_stream *stream);
 int ustctl_stream_close_wakeup_fd(struct ustctl_consumer_stream *stream);
 int ustctl_stream_get_wait_fd(struct ustctl_consumer_stream *stream);
 int ustctl_stream_get_wakeup_fd(struct ustctl_consumer_stream *stream);
+/*
+ * Consume the pending wakeups of the stream wait fd, whether it is a
+ * pipe or an eventfd. To be called before checking for data, prior to
+ * waiting on the wait fd again.
+ */
+int ustctl_stream_clear_wakeup(struct ustctl_consumer_stream *stream);
 
 /* Create/destroy stream buffers for read */
 struct ustctl_consumer_stream *
@@ -195,9 +276,26 @@ void ustctl_destroy_stream(struct ustctl_consumer_stream *stream);
 /* For mmap mode, readable without "get" operation */
 int ustctl_get_mmap_len(struct ustctl_consumer_stream *stream,
 		unsigned long *len);
+int ustctl_get_mmap_page_size(struct ustctl_consumer_stream *stream,
+		unsigned long *page_size);
 int ustctl_get_max_subbuf_size(struct ustctl_consumer_stream *stream,
 		unsigned long *len);
 
+/*
+ * Per-thread channels: get the thread ID owning the stream. Returns
+ * -ENODATA if no thread has claimed the stream yet.
+ */
+int ustctl_get_stream_owner_tid(struct ustctl_consumer_stream *stream,
+		int32_t *tid);
+
+/*
+ * Per-cpu channels: get the memory node the stream buffer is placed
+ * on, to run its reader locally. Returns -ENODATA if the buffer is not
+ * bound to a node.
+ */
+int ustctl_get_stream_numa_node(struct ustctl_consumer_stream *stream,
+		int *node);
+
 /*
  * For mmap mode, operate on the current packet (between get/put or
  * get_next/put_next).
@@ -212,6 +310,21 @@ int ustctl_get_padded_subbuf_size(struct ustctl_consumer_stream *stream,
 int ustctl_get_next_subbuf(struct ustctl_consumer_stream *stream);
 int ustctl_put_next_subbuf(struct ustctl_consumer_stream *stream);
 
+/*
+ * For mmap mode, hand @len bytes of the current packet to @fd (pipe,
+ * file or socket). Returns the number of bytes handed off, or a
+ * negative error value if none were. This is not zero-copy: the data
+ * is copied once. Regular files are written with splice(2), the kernel
+ * copying the data into the page cache without going through user
+ * space. Other fds are written with write(2), as splicing to them
+ * would leave references to the sub-buffer pages in @fd, which the
+ * writer reuses once the packet is put. Either way, @fd holds no
+ * reference to the sub-buffer pages on return, so the packet can be
+ * put right away.
+ */
+ssize_t ustctl_splice_subbuf(struct ustctl_consumer_stream *stream,
+		int fd, unsigned long len);
+
 /* snapshot */
 
 int ustctl_snapshot(struct ustctl_consumer_stream *stream);
@@ -73,6 +73,8 @@ enum lttng_client_types {
 	LTTNG_CLIENT_OVERWRITE = 2,
 	LTTNG_CLIENT_DISCARD_RT = 3,
 	LTTNG_CLIENT_OVERWRITE_RT = 4,
+	LTTNG_CLIENT_DISCARD_PT = 5,
+	LTTNG_CLIENT_OVERWRITE_PT = 6,
 	LTTNG_NR_CLIENT_TYPES,
 };
 
@@ -279,6 +281,8 @@ struct lttng_event_desc {
 	union {
 		struct {
 			const char **model_emf_uri;
+			void (**static_filter)(void);
+			const char **static_filter_expr;
 		} ext;
 		char padding[LTTNG_UST_EVENT_DESC_PADDING];
 	} u;
@@ -321,6 +325,7 @@ struct lttng_enabler {
 	struct lttng_channel *chan;
 	struct lttng_ctx *ctx;
 	unsigned int enabled:1;
+	unsigned int static_filter:1;	/* evaluate static filters */
 };
 
 struct tp_list_entry {
@@ -343,6 +348,16 @@ struct lttng_ust_field_list {
 	struct cds_list_head head;
 };
 
+struct filter_stats_list_entry {
+	struct lttng_ust_filter_stats_iter stats;
+	struct cds_list_head head;
+};
+
+struct lttng_ust_filter_stats_list {
+	struct filter_stats_list_entry *iter;
+	struct cds_list_head head;
+};
+
 struct ust_pending_probe;
 struct lttng_event;
 
@@ -374,14 +389,37 @@ enum lttng_filter_ret {
 	/* Other bits are kept for future use. */
 };
 
+/*
+ * Bit of lttng_bytecode_runtime field_mask for the event field at
+ * index @i. Fields past the 63rd share the last bit.
+ */
+#define LTTNG_UST_FILTER_FIELD_BIT(i)	(1ULL << ((i) < 63 ? (i) : 63))
+
+/*
+ * IMPORTANT: this structure is part of the ABI between the probe and
+ * UST. Fields need to be only added at the end, never reordered, never
+ * removed.
+ */
 struct lttng_bytecode_runtime {
 	/* Associated bytecode */
 	struct lttng_ust_filter_bytecode_node *bc;
 	uint64_t (*filter)(void *filter_data, const char *filter_stack_data);
 	int link_failed;
 	struct cds_list_head node;	/* list of bytecode runtime in event */
+	/*
+	 * Event fields loaded by the filter. Only valid if the channel
+	 * ops have has_filter_field_mask set.
+	 */
+	uint64_t field_mask;
 };
 
+/*
+ * Filter function of the runtimes which are not evaluated: disabled,
+ * failed to link, or identical to an earlier filter of the event.
+ */
+uint64_t lttng_filter_false(void *filter_data,
+		const char *filter_stack_data);
+
 /*
  * Objects in a linked-list of enablers, owned by an event.
  */
@@ -420,10 +458,19 @@ struct lttng_event {
 	struct cds_list_head enablers_ref_head;
 	struct cds_hlist_node hlist;	/* session ht of events */
 	int registered;			/* has reg'd tracepoint probe */
+
+	/* LTTng-UST 2.8 starts here */
+	/*
+	 * NULL if not evaluated. Only valid if the channel ops have
+	 * has_static_filter set.
+	 */
+	void (*static_filter)(void);
 };
 
 struct channel;
 struct lttng_ust_shm_handle;
+struct lttng_ust_batch;
+struct lttng_ust_shm_attr;
 
 /*
  * IMPORTANT: this structure is part of the ABI between the probe and
@@ -438,11 +485,18 @@ struct lttng_channel_ops {
 			unsigned int read_timer_interval,
 			unsigned char *uuid,
 			uint32_t chan_id,
-			const int *stream_fds, int nr_stream_fds);
+			const int *stream_fds, int nr_stream_fds,
+			const struct lttng_ust_shm_attr *shm_attr);
 	void (*channel_destroy)(struct lttng_channel *chan);
 	union {
 		void *_deprecated1;
-		unsigned long has_strcpy:1;		/* ABI has strcpy */
+		struct {
+			unsigned long has_strcpy:1;	/* ABI has strcpy */
+			/* ABI has lttng_bytecode_runtime field_mask */
+			unsigned long has_filter_field_mask:1;
+			/* ABI has lttng_event static_filter */
+			unsigned long has_static_filter:1;
+		};
 	} u;
 	void *_deprecated2;
 	int (*event_reserve)(struct lttng_ust_lib_ring_buffer_ctx *ctx,
@@ -464,6 +518,14 @@ struct lttng_channel_ops {
 	int (*flush_buffer)(struct channel *chan, struct lttng_ust_shm_handle *handle);
 	void (*event_strcpy)(struct lttng_ust_lib_ring_buffer_ctx *ctx,
 			const char *src, size_t len);
+	/*
+	 * Batched records: a single reservation and commit cover all
+	 * the records staged in @batch for the channel of @ctx.
+	 */
+	int (*event_reserve_batch)(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_ust_batch *batch);
+	void (*event_commit_batch)(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			struct lttng_ust_batch *batch);
 };
 
 /*
@@ -570,6 +632,8 @@ int lttng_enabler_attach_context(struct lttng_enabler *enabler,
 		struct lttng_ust_context *ctx);
 int lttng_enabler_attach_exclusion(struct lttng_enabler *enabler,
 		struct lttng_ust_excluder_node *excluder);
+int lttng_enabler_attach_static_filter(struct lttng_enabler *enabler);
+int lttng_enabler_clear_static_filter(struct lttng_enabler *enabler);
 
 int lttng_attach_context(struct lttng_ust_context *context_param,
 		struct lttng_ctx **ctx, struct lttng_session *session);
@@ -649,9 +713,17 @@ void lttng_filter_event_link_bytecode(struct lttng_event *event);
 void lttng_enabler_event_link_bytecode(struct lttng_event *event,
 		struct lttng_enabler *enabler);
 void lttng_free_event_filter_runtime(struct lttng_event *event);
-void lttng_filter_sync_state(struct lttng_bytecode_runtime *runtime);
+void lttng_filter_event_sync_state(struct lttng_event *event);
+void lttng_filter_event_sample_counts(struct lttng_event *event,
+		uint64_t *seen, uint64_t *kept);
+int lttng_filter_get_stats_list(struct lttng_ust_filter_stats_list *list);
+void lttng_filter_prune_stats_list(struct lttng_ust_filter_stats_list *list);
+struct lttng_ust_filter_stats_iter *
+	lttng_ust_filter_stats_list_get_iter_next(struct lttng_ust_filter_stats_list *list);
 
 struct cds_list_head *lttng_get_probe_list_head(void);
+int lttng_probes_match_desc(const char *name, size_t len, int prefix,
+		const struct lttng_event_desc ***descs, size_t *nr);
 int lttng_session_active(void);
 
 typedef int (*t_statedump_func_ptr)(struct lttng_session *session);
@@ -43,6 +43,9 @@
 #undef TRACEPOINT_MODEL_EMF_URI
 #define TRACEPOINT_MODEL_EMF_URI(provider, name, uri)
 
+#undef TRACEPOINT_STATIC_FILTER
+#define TRACEPOINT_STATIC_FILTER(provider, name, args, expr)
+
 #undef _ctf_integer_ext
 #define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, \
 			_nowrite)
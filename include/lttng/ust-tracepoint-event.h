@@ -304,111 +304,122 @@ size_t __event_get_size__##_provider##___##_name(size_t *__dynamic_len, _TP_ARGS
 #include <lttng/ust-tracepoint-event-write.h>
 #include <lttng/ust-tracepoint-event-nowrite.h>
 
+/*
+ * Only the fields loaded by the filters attached to the event are
+ * evaluated and stored. The stack layout is unchanged.
+ */
+#undef _TP_FILTER_FIELD_USED
+#define _TP_FILTER_FIELD_USED()						       \
+	(__filter_field_idx++,						       \
+	 __filter_field_mask & LTTNG_UST_FILTER_FIELD_BIT(__filter_field_idx - 1))
+
 #undef _ctf_integer_ext
 #define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _nowrite)     \
-	if (lttng_is_signed_type(_type)) {				       \
-		int64_t __ctf_tmp_int64;				       \
-		switch (sizeof(_type)) {				       \
-		case 1:							       \
-		{							       \
-			union { _type t; int8_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_int64 = (int64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 2:							       \
-		{							       \
-			union { _type t; int16_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_int64 = (int64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 4:							       \
-		{							       \
-			union { _type t; int32_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_int64 = (int64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 8:							       \
-		{							       \
-			union { _type t; int64_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_int64 = (int64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		default:						       \
-			abort();					       \
-		};							       \
-		memcpy(__stack_data, &__ctf_tmp_int64, sizeof(int64_t));       \
-	} else {							       \
-		uint64_t __ctf_tmp_uint64;				       \
-		switch (sizeof(_type)) {				       \
-		case 1:							       \
-		{							       \
-			union { _type t; uint8_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_uint64 = (uint64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 2:							       \
-		{							       \
-			union { _type t; uint16_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_uint64 = (uint64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 4:							       \
-		{							       \
-			union { _type t; uint32_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_uint64 = (uint64_t) __tmp.v;		       \
-			break;						       \
-		}							       \
-		case 8:							       \
-		{							       \
-			union { _type t; uint64_t v; } __tmp = { (_type) (_src) }; \
-			__ctf_tmp_uint64 = (uint64_t) __tmp.v;		       \
-			break;						       \
+	if (_TP_FILTER_FIELD_USED()) {					       \
+		if (lttng_is_signed_type(_type)) {			       \
+			int64_t __ctf_tmp_int64;			       \
+			switch (sizeof(_type)) {			       \
+			case 1:						       \
+			{						       \
+				union { _type t; int8_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_int64 = (int64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 2:						       \
+			{						       \
+				union { _type t; int16_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_int64 = (int64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 4:						       \
+			{						       \
+				union { _type t; int32_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_int64 = (int64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 8:						       \
+			{						       \
+				union { _type t; int64_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_int64 = (int64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			default:					       \
+				abort();				       \
+			};						       \
+			memcpy(__stack_data, &__ctf_tmp_int64, sizeof(int64_t)); \
+		} else {						       \
+			uint64_t __ctf_tmp_uint64;			       \
+			switch (sizeof(_type)) {			       \
+			case 1:						       \
+			{						       \
+				union { _type t; uint8_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_uint64 = (uint64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 2:						       \
+			{						       \
+				union { _type t; uint16_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_uint64 = (uint64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 4:						       \
+			{						       \
+				union { _type t; uint32_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_uint64 = (uint64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			case 8:						       \
+			{						       \
+				union { _type t; uint64_t v; } __tmp = { (_type) (_src) }; \
+				__ctf_tmp_uint64 = (uint64_t) __tmp.v;	       \
+				break;					       \
+			}						       \
+			default:					       \
+				abort();				       \
+			};						       \
+			memcpy(__stack_data, &__ctf_tmp_uint64, sizeof(uint64_t)); \
 		}							       \
-		default:						       \
-			abort();					       \
-		};							       \
-		memcpy(__stack_data, &__ctf_tmp_uint64, sizeof(uint64_t));     \
 	}								       \
 	__stack_data += sizeof(int64_t);
 
 #undef _ctf_float
 #define _ctf_float(_type, _item, _src, _nowrite)			       \
-	{								       \
+	if (_TP_FILTER_FIELD_USED()) {					       \
 		double __ctf_tmp_double = (double) (_type) (_src);	       \
 		memcpy(__stack_data, &__ctf_tmp_double, sizeof(double));       \
-		__stack_data += sizeof(double);				       \
-	}
+	}								       \
+	__stack_data += sizeof(double);
 
 #undef _ctf_array_encoded
 #define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _nowrite)   \
-	{								       \
+	if (_TP_FILTER_FIELD_USED()) {					       \
 		unsigned long __ctf_tmp_ulong = (unsigned long) (_length);     \
 		const void *__ctf_tmp_ptr = (_src);			       \
 		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
-		__stack_data += sizeof(unsigned long);			       \
-		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
-		__stack_data += sizeof(void *);				       \
-	}
+		memcpy(__stack_data + sizeof(unsigned long), &__ctf_tmp_ptr,   \
+			sizeof(void *));				       \
+	}								       \
+	__stack_data += sizeof(unsigned long) + sizeof(void *);
 
 #undef _ctf_sequence_encoded
 #define _ctf_sequence_encoded(_type, _item, _src, _length_type,		       \
 			_src_length, _encoding, _nowrite, _elem_type_base)     \
-	{								       \
+	if (_TP_FILTER_FIELD_USED()) {					       \
 		unsigned long __ctf_tmp_ulong = (unsigned long) (_src_length); \
 		const void *__ctf_tmp_ptr = (_src);			       \
 		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
-		__stack_data += sizeof(unsigned long);			       \
-		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
-		__stack_data += sizeof(void *);				       \
-	}
+		memcpy(__stack_data + sizeof(unsigned long), &__ctf_tmp_ptr,   \
+			sizeof(void *));				       \
+	}								       \
+	__stack_data += sizeof(unsigned long) + sizeof(void *);
 
 #undef _ctf_string
 #define _ctf_string(_item, _src, _nowrite)				       \
-	{								       \
+	if (_TP_FILTER_FIELD_USED()) {					       \
 		const void *__ctf_tmp_ptr = (_src);			       \
 		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
-		__stack_data += sizeof(void *);				       \
-	}
+	}								       \
+	__stack_data += sizeof(void *);
 
 #undef TP_ARGS
 #define TP_ARGS(...) __VA_ARGS__
@@ -420,8 +431,13 @@ size_t __event_get_size__##_provider##___##_name(size_t *__dynamic_len, _TP_ARGS
 #define TRACEPOINT_EVENT_CLASS(_provider, _name, _args, _fields)	      \
 static inline								      \
 void __event_prepare_filter_stack__##_provider##___##_name(char *__stack_data,\
+						 uint64_t __filter_field_mask,\
 						 _TP_ARGS_DATA_PROTO(_args))  \
 {									      \
+	unsigned int __filter_field_idx = 0;				      \
+									      \
+	if (0)								      \
+		(void) __filter_field_idx;	/* don't warn if unused */    \
 	_fields								      \
 }
 
@@ -590,6 +606,7 @@ void __event_probe__##_provider##___##_name(_TP_ARGS_DATA_PROTO(_args))	      \
 	struct lttng_event *__event = (struct lttng_event *) __tp_data;			      \
 	struct lttng_channel *__chan = __event->chan;			      \
 	struct lttng_ust_lib_ring_buffer_ctx __ctx;			      \
+	void (*__static_filter)(void);					      \
 	size_t __event_len, __event_align;				      \
 	size_t __dynamic_len_idx = 0;					      \
 	union {								      \
@@ -610,14 +627,39 @@ void __event_probe__##_provider##___##_name(_TP_ARGS_DATA_PROTO(_args))	      \
 		return;							      \
 	if (caa_unlikely(!TP_RCU_LINK_TEST()))				      \
 		return;							      \
+	if (caa_likely(__chan->ops->u.has_static_filter)) {		      \
+		__static_filter = CMM_ACCESS_ONCE(__event->static_filter);    \
+		if (caa_unlikely(__static_filter)			      \
+				&& !((int (*)(_TP_ARGS_PROTO(_args))) __static_filter)(_TP_ARGS_VAR(_args))) \
+			return;						      \
+	}								      \
 	if (caa_unlikely(!cds_list_empty(&__event->bytecode_runtime_head))) { \
 		struct lttng_bytecode_runtime *bc_runtime;		      \
 		int __filter_record = __event->has_enablers_without_bytecode; \
+		uint64_t __filter_field_mask = 0;			      \
 									      \
-		__event_prepare_filter_stack__##_provider##___##_name(__stackvar.__filter_stack_data, \
-			_TP_ARGS_DATA_VAR(_args));			      \
+		if (caa_unlikely(!__chan->ops->u.has_filter_field_mask)) {    \
+			__filter_field_mask = ~0ULL;			      \
+			__event_prepare_filter_stack__##_provider##___##_name(__stackvar.__filter_stack_data, \
+				__filter_field_mask, _TP_ARGS_DATA_VAR(_args)); \
+		}							      \
 		tp_list_for_each_entry_rcu(bc_runtime, &__event->bytecode_runtime_head, node) { \
-			if (caa_unlikely(bc_runtime->filter(bc_runtime,	      \
+			uint64_t (*__filter)(void *filter_data,		      \
+				const char *filter_stack_data);		      \
+									      \
+			__filter = CMM_ACCESS_ONCE(bc_runtime->filter);	      \
+			/* Not evaluated: no field to store. */		      \
+			if (__filter == lttng_filter_false)		      \
+				continue;				      \
+			/* Store the fields not loaded by previous filters. */ \
+			if (__filter_field_mask != ~0ULL		      \
+					&& (bc_runtime->field_mask & ~__filter_field_mask)) { \
+				__event_prepare_filter_stack__##_provider##___##_name(__stackvar.__filter_stack_data, \
+					bc_runtime->field_mask & ~__filter_field_mask, \
+					_TP_ARGS_DATA_VAR(_args));	      \
+				__filter_field_mask |= bc_runtime->field_mask; \
+			}						      \
+			if (caa_unlikely(__filter(bc_runtime,		      \
 					__stackvar.__filter_stack_data) & LTTNG_FILTER_RECORD_FLAG)) \
 				__filter_record = 1;			      \
 		}							      \
@@ -699,12 +741,41 @@ static const char *_model_emf_uri___##__provider##___##__name = __uri;
 
 #include TRACEPOINT_INCLUDE
 
+/*
+ * Stage 6.2 of tracepoint event generation.
+ *
+ * Tracepoint static filter predicates, called by the probe with the
+ * tracepoint arguments, and their expression.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <lttng/ust-tracepoint-event-reset.h>
+
+#undef TP_ARGS
+#define TP_ARGS(...) __VA_ARGS__
+
+#undef TRACEPOINT_STATIC_FILTER
+#define TRACEPOINT_STATIC_FILTER(__provider, __name, __args, __expr)	   \
+static lttng_ust_notrace						   \
+int _static_filter_func___##__provider##___##__name(_TP_ARGS_PROTO(__args)); \
+static									   \
+int _static_filter_func___##__provider##___##__name(_TP_ARGS_PROTO(__args)) \
+{									   \
+	return !!(__expr);						   \
+}									   \
+static void (*_static_filter___##__provider##___##__name)(void) =	   \
+		(void (*)(void)) &_static_filter_func___##__provider##___##__name; \
+static const char *_static_filter_expr___##__provider##___##__name = #__expr;
+
+#include TRACEPOINT_INCLUDE
+
 /*
  * Stage 7.1 of tracepoint event generation.
  *
  * Create events description structures. We use a weakref because
  * loglevels are optional. If not declared, the event will point to the
- * a loglevel that contains NULL.
+ * a loglevel that contains NULL. Same for static filters, which are
+ * NULL if not declared.
  */
 
 /* Reset all macros within TRACEPOINT_EVENT */
@@ -718,6 +789,12 @@ static const int *							       \
 static const char *							       \
 	__ref_model_emf_uri___##_provider##___##_name			       \
 	__attribute__((weakref ("_model_emf_uri___" #_provider "___" #_name)));\
+static void (*								       \
+	__ref_static_filter___##_provider##___##_name)(void)		       \
+	__attribute__((weakref ("_static_filter___" #_provider "___" #_name)));\
+static const char *							       \
+	__ref_static_filter_expr___##_provider##___##_name		       \
+	__attribute__((weakref ("_static_filter_expr___" #_provider "___" #_name)));\
 const struct lttng_event_desc __event_desc___##_provider##_##_name = {	       \
 	.name = #_provider ":" #_name,					       \
 	.probe_callback = (void (*)(void)) &__event_probe__##_provider##___##_template,\
@@ -726,7 +803,13 @@ const struct lttng_event_desc __event_desc___##_provider##_##_name = {	       \
 	.nr_fields = _TP_ARRAY_SIZE(__event_fields___##_provider##___##_template), \
 	.loglevel = &__ref_loglevel___##_provider##___##_name,		       \
 	.signature = __tp_event_signature___##_provider##___##_template,       \
-	.u = { .ext = { .model_emf_uri = &__ref_model_emf_uri___##_provider##___##_name } }, \
+	.u = {								       \
+		.ext = {						       \
+			.model_emf_uri = &__ref_model_emf_uri___##_provider##___##_name, \
+			.static_filter = &__ref_static_filter___##_provider##___##_name, \
+			.static_filter_expr = &__ref_static_filter_expr___##_provider##___##_name, \
+		},							       \
+	},								       \
 };
 
 #include TRACEPOINT_INCLUDE
@@ -22,6 +22,10 @@
 #include <lttng/ust-abi.h>
 #include <lttng/ust-events.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <byteswap.h>
 
 #include <usterr-signal-safe.h>
@@ -62,17 +66,22 @@ struct ustctl_consumer_stream {
 	int shm_fd, wait_fd, wakeup_fd;
 	int cpu;
 	uint64_t memory_map_size;
+	int splice_pipe[2];			/* splice to non-pipe fds */
 };
 
 extern void lttng_ring_buffer_client_overwrite_init(void);
 extern void lttng_ring_buffer_client_overwrite_rt_init(void);
 extern void lttng_ring_buffer_client_discard_init(void);
 extern void lttng_ring_buffer_client_discard_rt_init(void);
+extern void lttng_ring_buffer_client_discard_pt_init(void);
+extern void lttng_ring_buffer_client_overwrite_pt_init(void);
 extern void lttng_ring_buffer_metadata_client_init(void);
 extern void lttng_ring_buffer_client_overwrite_exit(void);
 extern void lttng_ring_buffer_client_overwrite_rt_exit(void);
 extern void lttng_ring_buffer_client_discard_exit(void);
 extern void lttng_ring_buffer_client_discard_rt_exit(void);
+extern void lttng_ring_buffer_client_discard_pt_exit(void);
+extern void lttng_ring_buffer_client_overwrite_pt_exit(void);
 extern void lttng_ring_buffer_metadata_client_exit(void);
 
 volatile enum ust_loglevel ust_loglevel;
@@ -308,6 +317,51 @@ int ustctl_set_exclusion(int sock, struct lttng_ust_event_exclusion *exclusion,
 	return ustcomm_recv_app_reply(sock, &lur, lum.handle, lum.cmd);
 }
 
+/*
+ * Evaluate the static filters, declared with TRACEPOINT_STATIC_FILTER,
+ * of the events of an enabler.
+ */
+int ustctl_set_static_filter(int sock, struct lttng_ust_object_data *obj_data)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	int ret;
+
+	if (!obj_data)
+		return -EINVAL;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = obj_data->handle;
+	lum.cmd = LTTNG_UST_STATIC_FILTER;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		return ret;
+	DBG("static filter set on handle %u", obj_data->handle);
+	return 0;
+}
+
+/*
+ * Stop evaluating the static filters of the events of an enabler.
+ */
+int ustctl_clear_static_filter(int sock, struct lttng_ust_object_data *obj_data)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	int ret;
+
+	if (!obj_data)
+		return -EINVAL;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = obj_data->handle;
+	lum.cmd = LTTNG_UST_CLEAR_STATIC_FILTER;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		return ret;
+	DBG("static filter cleared on handle %u", obj_data->handle);
+	return 0;
+}
+
 /* Enable event, channel and session ioctl */
 int ustctl_enable(int sock, struct lttng_ust_object_data *object)
 {
@@ -450,6 +504,51 @@ int ustctl_tracepoint_field_list_get(int sock, int tp_field_list_handle,
 	return 0;
 }
 
+int ustctl_filter_stats_list(int sock)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	int ret, filter_stats_list_handle;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = LTTNG_UST_ROOT_HANDLE;
+	lum.cmd = LTTNG_UST_FILTER_STATS_LIST;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		return ret;
+	filter_stats_list_handle = lur.ret_val;
+	DBG("received filter stats list handle %u", filter_stats_list_handle);
+	return filter_stats_list_handle;
+}
+
+int ustctl_filter_stats_list_get(int sock, int filter_stats_list_handle,
+		struct lttng_ust_filter_stats_iter *iter)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+	int ret;
+	ssize_t len;
+
+	if (!iter)
+		return -EINVAL;
+
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = filter_stats_list_handle;
+	lum.cmd = LTTNG_UST_FILTER_STATS_LIST_GET;
+	ret = ustcomm_send_app_cmd(sock, &lum, &lur);
+	if (ret)
+		return ret;
+	len = ustcomm_recv_unix_sock(sock, iter, sizeof(*iter));
+	if (len != sizeof(*iter)) {
+		return -EINVAL;
+	}
+	DBG("received filter stats list entry event_name %s session_handle %d channel_handle %d",
+		iter->event_name,
+		iter->session_handle,
+		iter->channel_handle);
+	return 0;
+}
+
 int ustctl_tracer_version(int sock, struct lttng_ust_tracer_version *v)
 {
 	struct ustcomm_ust_msg lum;
@@ -949,12 +1048,14 @@ int ustctl_get_nr_stream_per_channel(void)
 }
 
 struct ustctl_consumer_channel *
-	ustctl_create_channel(struct ustctl_consumer_channel_attr *attr,
+	ustctl_create_channel_ext(struct ustctl_consumer_channel_attr *attr,
+		const struct ustctl_consumer_channel_ext_attr *ext_attr,
 		const int *stream_fds, int nr_stream_fds)
 {
 	struct ustctl_consumer_channel *chan;
 	const char *transport_name;
 	struct lttng_transport *transport;
+	struct lttng_ust_shm_attr shm_attr;
 
 	switch (attr->type) {
 	case LTTNG_UST_CHAN_PER_CPU:
@@ -976,6 +1077,16 @@ struct ustctl_consumer_channel *
 			return NULL;
 		}
 		break;
+	case LTTNG_UST_CHAN_PER_THREAD:
+		/* Per-thread buffers only support wakeup by writer. */
+		if (attr->output != LTTNG_UST_MMAP
+				|| attr->read_timer_interval)
+			return NULL;
+		if (attr->overwrite)
+			transport_name = "relay-overwrite-pt-mmap";
+		else
+			transport_name = "relay-discard-pt-mmap";
+		break;
 	case LTTNG_UST_CHAN_METADATA:
 		if (attr->output == LTTNG_UST_MMAP)
 			transport_name = "relay-metadata-mmap";
@@ -994,6 +1105,32 @@ struct ustctl_consumer_channel *
 		return NULL;
 	}
 
+	memset(&shm_attr, 0, sizeof(shm_attr));
+	switch (ext_attr->wakeup) {
+	case USTCTL_WAKEUP_PIPE:
+		shm_attr.wakeup_type = SHM_WAKEUP_PIPE;
+		break;
+	case USTCTL_WAKEUP_EVENTFD:
+		shm_attr.wakeup_type = SHM_WAKEUP_EVENTFD;
+		break;
+	default:
+		return NULL;
+	}
+	switch (ext_attr->page_type) {
+	case USTCTL_PAGE_DEFAULT:
+		shm_attr.page_type = SHM_PAGE_DEFAULT;
+		break;
+	case USTCTL_PAGE_THP:
+		shm_attr.page_type = SHM_PAGE_THP;
+		break;
+	case USTCTL_PAGE_HUGETLB:
+		shm_attr.page_type = SHM_PAGE_HUGETLB;
+		break;
+	default:
+		return NULL;
+	}
+	shm_attr.lazy_alloc = !!ext_attr->lazy_alloc;
+
 	chan = zmalloc(sizeof(*chan));
 	if (!chan)
 		return NULL;
@@ -1003,7 +1140,7 @@ struct ustctl_consumer_channel *
 			attr->switch_timer_interval,
 			attr->read_timer_interval,
 			attr->uuid, attr->chan_id,
-			stream_fds, nr_stream_fds);
+			stream_fds, nr_stream_fds, &shm_attr);
 	if (!chan->chan) {
 		goto chan_error;
 	}
@@ -1018,6 +1155,17 @@ chan_error:
 	return NULL;
 }
 
+struct ustctl_consumer_channel *
+	ustctl_create_channel(struct ustctl_consumer_channel_attr *attr,
+		const int *stream_fds, int nr_stream_fds)
+{
+	struct ustctl_consumer_channel_ext_attr ext_attr;
+
+	memset(&ext_attr, 0, sizeof(ext_attr));
+	return ustctl_create_channel_ext(attr, &ext_attr, stream_fds,
+			nr_stream_fds);
+}
+
 void ustctl_destroy_channel(struct ustctl_consumer_channel *chan)
 {
 	(void) ustctl_channel_close_wait_fd(chan);
@@ -1216,12 +1364,16 @@ struct ustctl_consumer_stream *
 	stream->wakeup_fd = wakeup_fd;
 	stream->memory_map_size = memory_map_size;
 	stream->cpu = cpu;
+	stream->splice_pipe[0] = stream->splice_pipe[1] = -1;
 	return stream;
 
 alloc_error:
 	return NULL;
 }
 
+static
+void splice_pipe_close(struct ustctl_consumer_stream *stream);
+
 void ustctl_destroy_stream(struct ustctl_consumer_stream *stream)
 {
 	struct lttng_ust_lib_ring_buffer *buf;
@@ -1232,6 +1384,7 @@ void ustctl_destroy_stream(struct ustctl_consumer_stream *stream)
 	consumer_chan = stream->chan;
 	(void) ustctl_stream_close_wait_fd(stream);
 	(void) ustctl_stream_close_wakeup_fd(stream);
+	splice_pipe_close(stream);
 	lib_ring_buffer_release_read(buf, consumer_chan->chan->handle);
 	free(stream);
 }
@@ -1276,6 +1429,61 @@ int ustctl_stream_get_wakeup_fd(struct ustctl_consumer_stream *stream)
 	return shm_get_wakeup_fd(consumer_chan->chan->handle, &buf->self._ref);
 }
 
+int ustctl_stream_clear_wakeup(struct ustctl_consumer_stream *stream)
+{
+	struct lttng_ust_lib_ring_buffer *buf;
+	struct ustctl_consumer_channel *consumer_chan;
+	struct lttng_ust_shm_handle *handle;
+	int wait_fd, ret;
+	ssize_t len;
+
+	if (!stream)
+		return -EINVAL;
+	buf = stream->buf;
+	consumer_chan = stream->chan;
+	handle = consumer_chan->chan->handle;
+	wait_fd = shm_get_wait_fd(handle, &buf->self._ref);
+	if (wait_fd < 0)
+		return -ENOENT;
+
+	if (shm_get_wakeup_type(handle, &buf->self._ref) == SHM_WAKEUP_EVENTFD) {
+		uint64_t count;
+
+		/* Non-blocking read resets the counter. */
+		do {
+			len = read(wait_fd, &count, sizeof(count));
+		} while (len < 0 && errno == EINTR);
+		if (len < 0 && errno != EAGAIN)
+			return -errno;
+		return 0;
+	}
+
+	/* The pipe read end is blocking: only read what is available. */
+	for (;;) {
+		struct pollfd pfd = {
+			.fd = wait_fd,
+			.events = POLLIN,
+		};
+		char dummy[64];
+
+		ret = poll(&pfd, 1, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret || !(pfd.revents & POLLIN))
+			return 0;
+		do {
+			len = read(wait_fd, dummy, sizeof(dummy));
+		} while (len < 0 && errno == EINTR);
+		if (len < 0)
+			return -errno;
+		if (len == 0)
+			return 0;
+	}
+}
+
 /* For mmap mode, readable without "get" operation */
 
 void *ustctl_get_mmap_base(struct ustctl_consumer_stream *stream)
@@ -1313,6 +1521,27 @@ int ustctl_get_mmap_len(struct ustctl_consumer_stream *stream,
 	return 0;
 }
 
+/* returns the size of the pages backing the stream mapping. */
+int ustctl_get_mmap_page_size(struct ustctl_consumer_stream *stream,
+		unsigned long *page_size)
+{
+	struct lttng_ust_lib_ring_buffer *buf;
+	struct ustctl_consumer_channel *consumer_chan;
+	uint64_t size;
+	int ret;
+
+	if (!stream)
+		return -EINVAL;
+	buf = stream->buf;
+	consumer_chan = stream->chan;
+	ret = shm_get_page_size(consumer_chan->chan->handle, &buf->self._ref,
+			&size);
+	if (ret)
+		return ret;
+	*page_size = size;
+	return 0;
+}
+
 /* returns the maximum size for sub-buffers. */
 int ustctl_get_max_subbuf_size(struct ustctl_consumer_stream *stream,
 		unsigned long *len)
@@ -1328,6 +1557,45 @@ int ustctl_get_max_subbuf_size(struct ustctl_consumer_stream *stream,
 	return 0;
 }
 
+int ustctl_get_stream_owner_tid(struct ustctl_consumer_stream *stream,
+		int32_t *tid)
+{
+	struct ustctl_consumer_channel *consumer_chan;
+	struct channel *chan;
+	int32_t owner;
+
+	if (!stream || !tid)
+		return -EINVAL;
+	consumer_chan = stream->chan;
+	chan = consumer_chan->chan->chan;
+	if (chan->backend.config.alloc != RING_BUFFER_ALLOC_PER_THREAD)
+		return -EINVAL;
+	owner = CMM_LOAD_SHARED(stream->buf->owner_tid);
+	if (owner <= 0)
+		return -ENODATA;
+	*tid = owner;
+	return 0;
+}
+
+int ustctl_get_stream_numa_node(struct ustctl_consumer_stream *stream,
+		int *node)
+{
+	struct ustctl_consumer_channel *consumer_chan;
+	int ret;
+
+	if (!stream || !node)
+		return -EINVAL;
+	consumer_chan = stream->chan;
+	ret = shm_get_numa_node(consumer_chan->chan->handle,
+			&stream->buf->self._ref);
+	if (ret == -EPERM)
+		return ret;
+	if (ret < 0)
+		return -ENODATA;
+	*node = ret;
+	return 0;
+}
+
 /*
  * For mmap mode, operate on the current packet (between get/put or
  * get_next/put_next).
@@ -1402,6 +1670,199 @@ int ustctl_get_padded_subbuf_size(struct ustctl_consumer_stream *stream,
 	return 0;
 }
 
+/*
+ * Move up to @len bytes from the shm file at @*off, or from the mapping
+ * at @addr if the shm file cannot be spliced, into the pipe @pipe_fd.
+ * Returns the number of bytes moved, or a negative error value.
+ */
+static
+ssize_t splice_to_pipe(int shm_fd, loff_t *off, char *addr, int pipe_fd,
+		size_t len, int *use_vmsplice)
+{
+	ssize_t ret;
+
+	if (!*use_vmsplice) {
+		do {
+			ret = splice(shm_fd, off, pipe_fd, NULL, len,
+					SPLICE_F_MOVE | SPLICE_F_MORE);
+		} while (ret < 0 && errno == EINTR);
+		if (ret >= 0)
+			return ret;
+		if (errno != EINVAL)
+			return -errno;
+		/* shm file system without splice support. */
+		*use_vmsplice = 1;
+	}
+	do {
+		struct iovec iov = {
+			.iov_base = addr,
+			.iov_len = len,
+		};
+
+		ret = vmsplice(pipe_fd, &iov, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	*off += ret;
+	return ret;
+}
+
+/*
+ * Move @len bytes from the pipe @pipe_fd into @fd. Returns 0 on
+ * success, a negative error value otherwise.
+ */
+static
+int splice_from_pipe(int pipe_fd, int fd, size_t len)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = splice(pipe_fd, NULL, fd, NULL, len,
+				SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret)
+			return -EPIPE;
+		len -= ret;
+	}
+	return 0;
+}
+
+static
+int splice_pipe_open(struct ustctl_consumer_stream *stream,
+		unsigned long subbuf_size)
+{
+	int ret;
+
+	if (stream->splice_pipe[0] >= 0)
+		return 0;
+	ret = pipe2(stream->splice_pipe, O_CLOEXEC);
+	if (ret < 0)
+		return -errno;
+	/* Best effort: hold a whole sub-buffer in the pipe. */
+	(void) fcntl(stream->splice_pipe[1], F_SETPIPE_SZ, subbuf_size);
+	return 0;
+}
+
+static
+void splice_pipe_close(struct ustctl_consumer_stream *stream)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (stream->splice_pipe[i] < 0)
+			continue;
+		if (close(stream->splice_pipe[i]))
+			PERROR("close");
+		stream->splice_pipe[i] = -1;
+	}
+}
+
+/*
+ * Copy @len bytes at @addr to @fd. Returns the number of bytes written,
+ * or a negative error value if none were.
+ */
+static
+ssize_t copy_to_fd(int fd, const char *addr, size_t len)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < len) {
+		ret = write(fd, addr + done, len - done);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return done ? (ssize_t) done : -errno;
+		}
+		if (!ret)
+			break;
+		done += ret;
+	}
+	return done;
+}
+
+/*
+ * Hand @len bytes of the current packet (between get/put or
+ * get_next/put_next) to @fd. Returns the number of bytes handed off,
+ * which is smaller than @len only if an error occurred after part of
+ * the packet was written, or a negative error value if nothing was
+ * written.
+ *
+ * The sub-buffer pages are reused by the writer as soon as the packet
+ * is put, so no reference to them may outlive this call. A regular
+ * file copies the data into its page cache when spliced to, so it is
+ * spliced to through the stream pipe, without copying the data through
+ * user space. Pipes and sockets would keep references to the pages
+ * until read or sent, even with vmsplice(SPLICE_F_GIFT), and give no
+ * notice once done with them: the data is written to them instead. A
+ * zero-copy hand-off would need to hold the packet until then.
+ */
+ssize_t ustctl_splice_subbuf(struct ustctl_consumer_stream *stream,
+		int fd, unsigned long len)
+{
+	struct ustctl_consumer_channel *consumer_chan;
+	struct lttng_ust_lib_ring_buffer *buf;
+	unsigned long read_offset;
+	int use_vmsplice = 0, ret;
+	size_t done = 0;
+	struct stat st;
+	struct channel *chan;
+	char *addr;
+	loff_t off;
+
+	if (!stream || fd < 0)
+		return -EINVAL;
+	buf = stream->buf;
+	consumer_chan = stream->chan;
+	chan = consumer_chan->chan->chan;
+	if (len > chan->backend.subbuf_size)
+		return -EINVAL;
+	ret = ustctl_get_mmap_read_offset(stream, &read_offset);
+	if (ret)
+		return ret;
+	addr = ustctl_get_mmap_base(stream);
+	if (!addr)
+		return -EINVAL;
+	addr += read_offset;
+	if (fstat(fd, &st) < 0)
+		return -errno;
+	if (!S_ISREG(st.st_mode))
+		return copy_to_fd(fd, addr, len);
+	ret = splice_pipe_open(stream, chan->backend.subbuf_size);
+	if (ret)
+		return ret;
+	/* The mapping starts at the memory map offset within the shm file. */
+	off = buf->backend.memory_map._ref.offset + read_offset;
+
+	while (done < len) {
+		ssize_t count;
+
+		count = splice_to_pipe(stream->shm_fd, &off, addr + done,
+				stream->splice_pipe[1], len - done,
+				&use_vmsplice);
+		if (count <= 0) {
+			ret = count ? count : -EPIPE;
+			goto error;
+		}
+		/* Returns once the data is copied into the file. */
+		ret = splice_from_pipe(stream->splice_pipe[0], fd, count);
+		if (ret) {
+			/* Don't leave stale data in the pipe. */
+			splice_pipe_close(stream);
+			goto error;
+		}
+		done += count;
+	}
+	return done;
+
+error:
+	return done ? (ssize_t) done : ret;
+}
+
 /* Get exclusive read access to the next sub-buffer that can be read. */
 int ustctl_get_next_subbuf(struct ustctl_consumer_stream *stream)
 {
@@ -2020,12 +2481,16 @@ void ustctl_init(void)
 	lttng_ring_buffer_client_overwrite_rt_init();
 	lttng_ring_buffer_client_discard_init();
 	lttng_ring_buffer_client_discard_rt_init();
+	lttng_ring_buffer_client_discard_pt_init();
+	lttng_ring_buffer_client_overwrite_pt_init();
 	lib_ringbuffer_signal_init();
 }
 
 static __attribute__((destructor))
 void ustctl_exit(void)
 {
+	lttng_ring_buffer_client_overwrite_pt_exit();
+	lttng_ring_buffer_client_discard_pt_exit();
 	lttng_ring_buffer_client_discard_rt_exit();
 	lttng_ring_buffer_client_discard_exit();
 	lttng_ring_buffer_client_overwrite_rt_exit();
@@ -42,6 +42,7 @@ struct lttng_trace_clock {
 extern struct lttng_trace_clock *lttng_trace_clock;
 
 void lttng_ust_clock_init(void);
+int lttng_ust_clock_tsc_init(void);
 
 /* Use the kernel MONOTONIC clock. */
 
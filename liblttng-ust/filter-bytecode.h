@@ -147,7 +147,52 @@ enum filter_op {
 	FILTER_OP_GET_CONTEXT_REF_S64,
 	FILTER_OP_GET_CONTEXT_REF_DOUBLE,
 
+	/* load userspace field ref, reserved for the kernel tracer */
+	FILTER_OP_LOAD_FIELD_REF_USER_STRING,
+	FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE,
+
+	/* load star globbing pattern from immediate operand */
+	FILTER_OP_LOAD_STAR_GLOB_STRING,
+
+	/* star globbing pattern binary comparators */
+	FILTER_OP_EQ_STAR_GLOB_STRING,
+	FILTER_OP_NE_STAR_GLOB_STRING,
+
+	/* load integer array or sequence element, length or aggregate */
+	FILTER_OP_LOAD_FIELD_REF_ELEM,
+	FILTER_OP_LOAD_FIELD_REF_LEN,
+	FILTER_OP_LOAD_FIELD_REF_ANY,
+	FILTER_OP_LOAD_FIELD_REF_ALL,
+
+	/* sampling and rate limiting, push 1 if the event is kept */
+	FILTER_OP_SAMPLE,
+	FILTER_OP_RATE_LIMIT,
+
 	NR_FILTER_OPS,
+
+	/*
+	 * Internal opcodes, written by the tracer when linking and
+	 * specializing the bytecode. They are not part of the wire
+	 * format, and never sent by the session daemon.
+	 */
+
+	/* load string without wildcard nor escape from immediate operand */
+	FILTER_OP_LOAD_STRING_PLAIN = NR_FILTER_OPS,
+
+	/* get built-in context ref, reading the context cache directly */
+	FILTER_OP_GET_CONTEXT_REF_VTID,
+	FILTER_OP_GET_CONTEXT_REF_VPID,
+	FILTER_OP_GET_CONTEXT_REF_CPU_ID,
+	FILTER_OP_GET_CONTEXT_REF_PROCNAME,
+
+	/* typed integer array or sequence element, length or aggregate */
+	FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+	FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64,
+	FILTER_OP_LOAD_FIELD_REF_LEN_S64,
+	FILTER_OP_LOAD_FIELD_REF_ANY_S64,
+	FILTER_OP_LOAD_FIELD_REF_ALL_S64,
+
+	NR_FILTER_INTERNAL_OPS,
 };
 
 typedef uint8_t filter_opcode_t;
@@ -180,4 +225,48 @@ struct return_op {
 	filter_opcode_t op;
 } __attribute__((packed));
 
+/* Keep one evaluation out of period, on each cpu. */
+struct sample_op {
+	filter_opcode_t op;
+	uint16_t slot;		/* set at link: sampling state index */
+	uint32_t period;
+} __attribute__((packed));
+
+/*
+ * Keep at most rate evaluations per second on each cpu, and up to
+ * burst evaluations back-to-back.
+ */
+struct rate_limit_op {
+	filter_opcode_t op;
+	uint16_t slot;		/* set at link: sampling state index */
+	uint32_t rate;
+	uint32_t burst;
+} __attribute__((packed));
+
+/*
+ * Element of an integer array or sequence field. Array indexes are
+ * checked against the array length at link, sequence indexes against
+ * the sequence length at each evaluation.
+ */
+struct field_elem_ref {
+	/* Initially, symbol offset. After link, field offset. */
+	uint16_t offset;
+	/* Element index, or number of elements compared by ANY/ALL. */
+	uint16_t index;
+	/* Set at link: element size in bytes and signedness. */
+	uint8_t elem_size;
+	uint8_t elem_signed;
+} __attribute__((packed));
+
+/*
+ * ANY (resp. ALL) is true if the comparison of at least one (resp.
+ * every) element with the literal is true. Only the first
+ * elem.index elements are compared.
+ */
+struct field_aggr_ref {
+	struct field_elem_ref elem;
+	filter_opcode_t cmp;	/* FILTER_OP_EQ to FILTER_OP_LE */
+	int64_t v;
+} __attribute__((packed));
+
 #endif /* _FILTER_BYTECODE_H */
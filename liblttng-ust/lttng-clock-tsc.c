@@ -0,0 +1,364 @@
+/*
+ * lttng-clock-tsc.c
+ *
+ * Built-in trace clock reading the CPU cycle counter directly, without
+ * going through clock_gettime().
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <usterr-signal-safe.h>
+#include <lttng/ust-clock.h>
+
+#include "clock.h"
+#include "getenv.h"
+
+/* Kernel-exported TSC frequency, available on some kernels. */
+#define TSC_FREQ_KHZ_PATH	"/sys/devices/system/cpu/cpu0/tsc_freq_khz"
+
+/* Calibration interval against CLOCK_MONOTONIC. */
+#define TSC_CALIBRATE_NSEC	1000000ULL	/* 1ms */
+/* Samples taken to keep the one with the shortest clock read. */
+#define TSC_SAMPLE_TRIES	5
+/*
+ * Calibrated frequencies are rounded to the MHz, which absorbs the
+ * measurement error, so that processes calibrating the same counter
+ * agree on the frequency reported in the metadata.
+ */
+#define TSC_FREQ_ROUND		1000000ULL
+/* Maximum deviation tolerated between shared and measured frequency. */
+#define TSC_FREQ_MAX_ERROR_DIV	100		/* 1% */
+
+#if defined(__x86_64__)
+
+#include <cpuid.h>
+
+/*
+ * The lfence orders rdtsc after the preceding loads, so that records
+ * are not timestamped ahead of the code that produced them.
+ */
+static
+uint64_t tsc_read64(void)
+{
+	uint32_t low, high;
+
+	__asm__ __volatile__ ("lfence; rdtsc" : "=a" (low), "=d" (high)
+			: : "memory");
+	return ((uint64_t) high << 32) | low;
+}
+
+/*
+ * The TSC is usable as trace clock if it is invariant (constant rate
+ * and running in deep C-states), and if the kernel did not mark it as
+ * unstable, which it does when it detects TSC skew across CPUs by
+ * switching to another clocksource.
+ */
+static
+int tsc_reliable(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	char clocksource[32];
+	FILE *fp;
+	int ret = 0;
+
+	if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+		return 0;
+	if (!(edx & (1U << 8)))		/* Invariant TSC */
+		return 0;
+	fp = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+	if (!fp)
+		return 0;
+	if (fgets(clocksource, sizeof(clocksource), fp)
+			&& !strncmp(clocksource, "tsc\n", sizeof("tsc\n")))
+		ret = 1;
+	fclose(fp);
+	return ret;
+}
+
+/*
+ * Nominal TSC frequency from the CPUID "Time Stamp Counter and Nominal
+ * Core Crystal Clock" leaf, if enumerated. Returns 0 if unknown.
+ */
+static
+uint64_t tsc_nominal_freq(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 0x15)
+		return 0;
+	__cpuid(0x15, eax, ebx, ecx, edx);
+	if (!eax || !ebx || !ecx)
+		return 0;
+	return (uint64_t) ecx * ebx / eax;
+}
+
+static
+const char *tsc_name(void)
+{
+	return "tsc";
+}
+
+static
+const char *tsc_description(void)
+{
+	return "Invariant TSC";
+}
+
+#elif defined(__aarch64__)
+
+static
+uint64_t tsc_read64(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r" (val) : : "memory");
+	return val;
+}
+
+/* The architected generic timer is system-wide and constant rate. */
+static
+int tsc_reliable(void)
+{
+	return 1;
+}
+
+static
+uint64_t tsc_nominal_freq(void)
+{
+	uint64_t val;
+
+	__asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (val));
+	return val;
+}
+
+static
+const char *tsc_name(void)
+{
+	return "cntvct";
+}
+
+static
+const char *tsc_description(void)
+{
+	return "ARMv8 generic timer virtual counter";
+}
+
+#else
+
+static
+uint64_t tsc_read64(void)
+{
+	return 0;
+}
+
+static
+int tsc_reliable(void)
+{
+	return 0;
+}
+
+static
+uint64_t tsc_nominal_freq(void)
+{
+	return 0;
+}
+
+static
+const char *tsc_name(void)
+{
+	return NULL;
+}
+
+static
+const char *tsc_description(void)
+{
+	return NULL;
+}
+
+#endif
+
+static
+uint64_t tsc_freq_value;
+
+static
+uint64_t tsc_freq(void)
+{
+	return tsc_freq_value;
+}
+
+/*
+ * Sample the counter and CLOCK_MONOTONIC at the same instant. The clock
+ * read is bracketed by two counter reads, and the shortest of a few
+ * tries is kept, which bounds the error an interrupt would add.
+ */
+static
+void tsc_sample(uint64_t *tsc, uint64_t *ns)
+{
+	uint64_t before, after, now, best = UINT64_MAX;
+	unsigned int i;
+
+	for (i = 0; i < TSC_SAMPLE_TRIES; i++) {
+		before = tsc_read64();
+		now = trace_clock_read64_monotonic();
+		after = tsc_read64();
+		if (after - before < best) {
+			best = after - before;
+			*tsc = before + best / 2;
+			*ns = now;
+		}
+	}
+}
+
+/*
+ * Measure the counter frequency against CLOCK_MONOTONIC between two
+ * samples TSC_CALIBRATE_NSEC apart. Returns 0 if the counter does not
+ * progress.
+ */
+static
+uint64_t tsc_calibrate(void)
+{
+	uint64_t ns_begin, ns_end, tsc_begin, tsc_end, freq;
+
+	tsc_sample(&tsc_begin, &ns_begin);
+	do {
+		tsc_sample(&tsc_end, &ns_end);
+	} while (ns_end - ns_begin < TSC_CALIBRATE_NSEC);
+	if (tsc_end <= tsc_begin)
+		return 0;
+	freq = (uint64_t) ((double) (tsc_end - tsc_begin) * 1000000000ULL
+			/ (ns_end - ns_begin));
+	return (freq + TSC_FREQ_ROUND / 2) / TSC_FREQ_ROUND * TSC_FREQ_ROUND;
+}
+
+/*
+ * Counter frequency set with LTTNG_UST_CLOCK_TSC_FREQ (in Hz), 0 if
+ * unset or invalid.
+ */
+static
+uint64_t tsc_env_freq(void)
+{
+	const char *str;
+	char *endptr;
+	uint64_t freq;
+
+	str = lttng_secure_getenv("LTTNG_UST_CLOCK_TSC_FREQ");
+	if (!str)
+		return 0;
+	errno = 0;
+	freq = strtoull(str, &endptr, 10);
+	if (!errno && endptr != str && *endptr == '\0' && freq)
+		return freq;
+	WARN("Invalid LTTNG_UST_CLOCK_TSC_FREQ value \"%s\"", str);
+	return 0;
+}
+
+/*
+ * Counter frequency known to the whole system: the frequency exported
+ * by the kernel in sysfs, or the nominal frequency enumerated by the
+ * CPU. Returns 0 if unknown.
+ */
+static
+uint64_t tsc_system_freq(void)
+{
+	unsigned long long khz;
+	FILE *fp;
+
+	fp = fopen(TSC_FREQ_KHZ_PATH, "r");
+	if (fp) {
+		int ret;
+
+		ret = fscanf(fp, "%llu", &khz);
+		fclose(fp);
+		if (ret == 1 && khz)
+			return (uint64_t) khz * 1000;
+	}
+	return tsc_nominal_freq();
+}
+
+/*
+ * Counter frequency, preferably from a source shared by all processes,
+ * so that they and the session daemon agree on the frequency reported
+ * in the metadata. The system frequency is checked against a short
+ * calibration, which is used instead when the system does not know
+ * the frequency or reports a wrong one. Returns 0 if unknown.
+ */
+static
+uint64_t tsc_get_freq(void)
+{
+	uint64_t shared, measured, delta;
+
+	shared = tsc_env_freq();
+	if (shared)
+		return shared;
+	measured = tsc_calibrate();
+	if (!measured)
+		return 0;
+	shared = tsc_system_freq();
+	if (!shared)
+		return measured;
+	delta = shared > measured ? shared - measured : measured - shared;
+	if (delta > shared / TSC_FREQ_MAX_ERROR_DIV) {
+		DBG("Cycle counter frequency %" PRIu64 " Hz differs from calibrated %" PRIu64 " Hz",
+			shared, measured);
+		return measured;
+	}
+	return shared;
+}
+
+/*
+ * Use the cycle counter as trace clock if it is reliable and its
+ * frequency is known. Returns 0 on success, a negative error value if
+ * the default clock should be kept.
+ */
+int lttng_ust_clock_tsc_init(void)
+{
+	int ret;
+
+	if (!tsc_reliable()) {
+		DBG("Cycle counter unreliable, keeping monotonic trace clock");
+		return -ENODEV;
+	}
+	tsc_freq_value = tsc_get_freq();
+	if (!tsc_freq_value) {
+		DBG("Cycle counter calibration failed, keeping monotonic trace clock");
+		return -ENODEV;
+	}
+
+	ret = lttng_ust_trace_clock_set_read64_cb(tsc_read64);
+	if (ret)
+		return ret;
+	ret = lttng_ust_trace_clock_set_freq_cb(tsc_freq);
+	if (ret)
+		return ret;
+	ret = lttng_ust_trace_clock_set_name_cb(tsc_name);
+	if (ret)
+		return ret;
+	ret = lttng_ust_trace_clock_set_description_cb(tsc_description);
+	if (ret)
+		return ret;
+	ret = lttng_ust_enable_trace_clock_override();
+	if (ret)
+		return ret;
+	DBG("Using cycle counter trace clock, frequency %" PRIu64 " Hz",
+		tsc_freq_value);
+	return 0;
+}
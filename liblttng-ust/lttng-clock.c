@@ -102,8 +102,11 @@ void lttng_ust_clock_init(void)
 	if (clock_handle)
 		return;
 	libname = lttng_secure_getenv("LTTNG_UST_CLOCK_PLUGIN");
-	if (!libname)
+	if (!libname) {
+		if (lttng_secure_getenv("LTTNG_UST_CLOCK_TSC"))
+			(void) lttng_ust_clock_tsc_init();
 		return;
+	}
 	clock_handle = dlopen(libname, RTLD_NOW);
 	if (!clock_handle) {
 		PERROR("Cannot load LTTng UST clock override library %s",
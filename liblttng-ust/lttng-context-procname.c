@@ -26,6 +26,7 @@
 #include <urcu/tls-compat.h>
 #include <assert.h>
 #include "compat.h"
+#include "lttng-tracer-core.h"
 
 /*
  * We cache the result to ensure we don't trigger a system call for
@@ -36,22 +37,17 @@
  * be set for a thread before the first event is logged within this
  * thread.
  */
-typedef char procname_array[17];
-static DEFINE_URCU_TLS(procname_array, cached_procname);
+DEFINE_URCU_TLS(lttng_procname_array, lttng_cached_procname);
 
-static inline
-char *wrapper_getprocname(void)
+void lttng_context_procname_fill(void)
 {
-	if (caa_unlikely(!URCU_TLS(cached_procname)[0])) {
-		lttng_ust_getprocname(URCU_TLS(cached_procname));
-		URCU_TLS(cached_procname)[LTTNG_UST_PROCNAME_LEN - 1] = '\0';
-	}
-	return URCU_TLS(cached_procname);
+	lttng_ust_getprocname(URCU_TLS(lttng_cached_procname));
+	URCU_TLS(lttng_cached_procname)[LTTNG_UST_PROCNAME_LEN - 1] = '\0';
 }
 
 void lttng_context_procname_reset(void)
 {
-	URCU_TLS(cached_procname)[0] = '\0';
+	URCU_TLS(lttng_cached_procname)[0] = '\0';
 }
 
 static
@@ -70,7 +66,7 @@ void procname_record(struct lttng_ctx_field *field,
 {
 	char *procname;
 
-	procname = wrapper_getprocname();
+	procname = lttng_context_procname_get();
 	chan->ops->event_write(ctx, procname, LTTNG_UST_PROCNAME_LEN);
 }
 
@@ -80,7 +76,7 @@ void procname_get_value(struct lttng_ctx_field *field,
 {
 	char *procname;
 
-	procname = wrapper_getprocname();
+	procname = lttng_context_procname_get();
 	value->str = procname;
 }
 
@@ -117,5 +113,5 @@ int lttng_add_procname_to_ctx(struct lttng_ctx **ctx)
  */
 void lttng_fixup_procname_tls(void)
 {
-	asm volatile ("" : : "m" (URCU_TLS(cached_procname)[0]));
+	asm volatile ("" : : "m" (URCU_TLS(lttng_cached_procname)[0]));
 }
@@ -25,6 +25,7 @@
 #include <lttng/ust-events.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/ringbuffer-config.h>
+#include "lttng-tracer-core.h"
 
 #ifdef __linux__
 static inline
@@ -61,6 +62,11 @@ void lttng_context_vpid_reset(void)
 }
 #endif
 
+pid_t lttng_context_vpid_get(void)
+{
+	return wrapper_getpid();
+}
+
 static
 size_t vpid_get_size(size_t offset)
 {
@@ -33,7 +33,7 @@
  * We cache the result to ensure we don't trigger a system call for
  * each event.
  */
-static DEFINE_URCU_TLS(pid_t, cached_vtid);
+DEFINE_URCU_TLS(pid_t, lttng_cached_vtid);
 
 /*
  * Upon fork or clone, the TID assigned to our thread is not the same as
@@ -42,7 +42,13 @@ static DEFINE_URCU_TLS(pid_t, cached_vtid);
  */
 void lttng_context_vtid_reset(void)
 {
-	URCU_TLS(cached_vtid) = 0;
+	URCU_TLS(lttng_cached_vtid) = 0;
+}
+
+pid_t lttng_context_vtid_fill(void)
+{
+	URCU_TLS(lttng_cached_vtid) = gettid();
+	return URCU_TLS(lttng_cached_vtid);
 }
 
 static
@@ -60,20 +66,18 @@ void vtid_record(struct lttng_ctx_field *field,
 		 struct lttng_ust_lib_ring_buffer_ctx *ctx,
 		 struct lttng_channel *chan)
 {
-	if (caa_unlikely(!URCU_TLS(cached_vtid)))
-		URCU_TLS(cached_vtid) = gettid();
-	lib_ring_buffer_align_ctx(ctx, lttng_alignof(URCU_TLS(cached_vtid)));
-	chan->ops->event_write(ctx, &URCU_TLS(cached_vtid),
-		sizeof(URCU_TLS(cached_vtid)));
+	pid_t vtid;
+
+	vtid = lttng_context_vtid_get();
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(vtid));
+	chan->ops->event_write(ctx, &vtid, sizeof(vtid));
 }
 
 static
 void vtid_get_value(struct lttng_ctx_field *field,
 		union lttng_ctx_value *value)
 {
-	if (caa_unlikely(!URCU_TLS(cached_vtid)))
-		URCU_TLS(cached_vtid) = gettid();
-	value->s64 = URCU_TLS(cached_vtid);
+	value->s64 = lttng_context_vtid_get();
 }
 
 int lttng_add_vtid_to_ctx(struct lttng_ctx **ctx)
@@ -107,5 +111,5 @@ int lttng_add_vtid_to_ctx(struct lttng_ctx **ctx)
  */
 void lttng_fixup_vtid_tls(void)
 {
-	asm volatile ("" : : "m" (URCU_TLS(cached_vtid)));
+	asm volatile ("" : : "m" (URCU_TLS(lttng_cached_vtid)));
 }
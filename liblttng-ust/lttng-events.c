@@ -78,6 +78,10 @@ void lttng_session_lazy_sync_enablers(struct lttng_session *session);
 static
 void lttng_session_sync_enablers(struct lttng_session *session);
 static
+void lttng_enabler_lazy_sync(struct lttng_enabler *enabler);
+static
+void lttng_event_sync_enablers(struct lttng_event *event);
+static
 void lttng_enabler_destroy(struct lttng_enabler *enabler);
 
 /*
@@ -134,6 +138,8 @@ struct lttng_session *lttng_session_create(void)
 	struct lttng_session *session;
 	int i;
 
+	/* Callsites of deferred libraries are needed from now on. */
+	tracepoint_wire_pending_libs();
 	session = zmalloc(sizeof(struct lttng_session));
 	if (!session)
 		return NULL;
@@ -288,6 +294,9 @@ int lttng_session_enable(struct lttng_session *session)
 	/* We need to sync enablers with session before activation. */
 	lttng_session_sync_enablers(session);
 
+	/* Record the events hit before registration completed. */
+	lttng_ust_early_replay(session);
+
 	/* Set atomically the state to "active" */
 	CMM_ACCESS_ONCE(session->active) = 1;
 	CMM_ACCESS_ONCE(session->been_active) = 1;
@@ -380,10 +389,13 @@ int lttng_event_create(const struct lttng_event_desc *desc,
 		}
 	}
 
-	notify_socket = lttng_get_notify_socket(session->owner);
-	if (notify_socket < 0) {
-		ret = notify_socket;
-		goto socket_error;
+	/* Early session events are not known to the session daemon. */
+	if (!lttng_ust_is_early_session(session)) {
+		notify_socket = lttng_get_notify_socket(session->owner);
+		if (notify_socket < 0) {
+			ret = notify_socket;
+			goto socket_error;
+		}
 	}
 
 	/*
@@ -413,19 +425,21 @@ int lttng_event_create(const struct lttng_event_desc *desc,
 		uri = NULL;
 
 	/* Fetch event ID from sessiond */
-	ret = ustcomm_register_event(notify_socket,
-		session->objd,
-		chan->objd,
-		event_name,
-		loglevel,
-		desc->signature,
-		desc->nr_fields,
-		desc->fields,
-		uri,
-		&event->id);
-	if (ret < 0) {
-		DBG("Error (%d) registering event to sessiond", ret);
-		goto sessiond_register_error;
+	if (!lttng_ust_is_early_session(session)) {
+		ret = ustcomm_register_event(notify_socket,
+			session->objd,
+			chan->objd,
+			event_name,
+			loglevel,
+			desc->signature,
+			desc->nr_fields,
+			desc->fields,
+			uri,
+			&event->id);
+		if (ret < 0) {
+			DBG("Error (%d) registering event to sessiond", ret);
+			goto sessiond_register_error;
+		}
 	}
 
 	/* Populate lttng_event structure before tracepoint registration. */
@@ -527,17 +541,6 @@ int lttng_desc_match_enabler(const struct lttng_event_desc *desc,
 	}
 }
 
-static
-int lttng_event_match_enabler(struct lttng_event *event,
-		struct lttng_enabler *enabler)
-{
-	if (lttng_desc_match_enabler(event->desc, enabler)
-			&& event->chan == enabler->chan)
-		return 1;
-	else
-		return 0;
-}
-
 static
 struct lttng_enabler_ref * lttng_event_enabler_ref(struct lttng_event *event,
 		struct lttng_enabler *enabler)
@@ -553,86 +556,85 @@ struct lttng_enabler_ref * lttng_event_enabler_ref(struct lttng_event *event,
 }
 
 /*
- * Create struct lttng_event if it is missing and present in the list of
- * tracepoint probes.
+ * Lookup the event of @desc in @chan.
  */
 static
-void lttng_create_event_if_missing(struct lttng_enabler *enabler)
+struct lttng_event *lttng_event_lookup(const struct lttng_event_desc *desc,
+		struct lttng_channel *chan)
 {
-	struct lttng_session *session = enabler->chan->session;
-	struct lttng_probe_desc *probe_desc;
-	const struct lttng_event_desc *desc;
 	struct lttng_event *event;
-	int i;
-	struct cds_list_head *probe_list;
-
-	probe_list = lttng_get_probe_list_head();
-	/*
-	 * For each probe event, if we find that a probe event matches
-	 * our enabler, create an associated lttng_event if not
-	 * already present.
-	 */
-	cds_list_for_each_entry(probe_desc, probe_list, head) {
-		for (i = 0; i < probe_desc->nr_events; i++) {
-			int found = 0, ret;
-			struct cds_hlist_head *head;
-			struct cds_hlist_node *node;
-			const char *event_name;
-			size_t name_len;
-			uint32_t hash;
-
-			desc = probe_desc->event_desc[i];
-			if (!lttng_desc_match_enabler(desc, enabler))
-				continue;
-			event_name = desc->name;
-			name_len = strlen(event_name);
-
-			/*
-			 * Check if already created.
-			 */
-			hash = jhash(event_name, name_len, 0);
-			head = &session->events_ht.table[hash & (LTTNG_UST_EVENT_HT_SIZE - 1)];
-			cds_hlist_for_each_entry(event, node, head, hlist) {
-				if (event->desc == desc
-						&& event->chan == enabler->chan)
-					found = 1;
-			}
-			if (found)
-				continue;
+	struct cds_hlist_head *head;
+	struct cds_hlist_node *node;
+	uint32_t hash;
 
-			/*
-			 * We need to create an event for this
-			 * event probe.
-			 */
-			ret = lttng_event_create(probe_desc->event_desc[i],
-					enabler->chan);
-			if (ret) {
-				DBG("Unable to create event %s, error %d\n",
-					probe_desc->event_desc[i]->name, ret);
-			}
-		}
+	hash = jhash(desc->name, strlen(desc->name), 0);
+	head = &chan->session->events_ht.table[hash & (LTTNG_UST_EVENT_HT_SIZE - 1)];
+	cds_hlist_for_each_entry(event, node, head, hlist) {
+		if (event->desc == desc && event->chan == chan)
+			return event;
 	}
+	return NULL;
 }
 
 /*
- * Create events associated with an enabler (if not already present),
- * and add backward reference from the event to the enabler.
+ * Create the events matching an enabler if they are missing, and add
+ * backward references from the events to the enabler. If @sync is set,
+ * also sync the state of the events referencing the enabler.
+ *
+ * The event descriptors are looked up by name in the probe index, so
+ * this is proportional to the number of events the enabler name
+ * matches, rather than to the number of registered events.
  */
 static
-int lttng_enabler_ref_events(struct lttng_enabler *enabler)
+int lttng_enabler_ref_events(struct lttng_enabler *enabler, int sync)
 {
-	struct lttng_session *session = enabler->chan->session;
-	struct lttng_event *event;
+	const struct lttng_event_desc **descs;
+	const char *name = enabler->event_param.name;
+	size_t len, nr, i;
+	int ret;
 
-	/* First ensure that probe events are created for this enabler. */
-	lttng_create_event_if_missing(enabler);
+	len = strnlen(name, LTTNG_UST_SYM_NAME_LEN);
+	switch (enabler->type) {
+	case LTTNG_ENABLER_WILDCARD:
+		/* Match excluding final '*' */
+		ret = lttng_probes_match_desc(name, len ? len - 1 : 0, 1,
+				&descs, &nr);
+		break;
+	case LTTNG_ENABLER_EVENT:
+		ret = lttng_probes_match_desc(name, len, 0, &descs, &nr);
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (ret)
+		return ret;
 
-	/* For each event matching enabler in session event list. */
-	cds_list_for_each_entry(event, &session->events_head, node) {
+	for (i = 0; i < nr; i++) {
+		const struct lttng_event_desc *desc = descs[i];
 		struct lttng_enabler_ref *enabler_ref;
+		struct lttng_event *event;
 
-		if (!lttng_event_match_enabler(event, enabler))
+		event = lttng_event_lookup(desc, enabler->chan);
+		if (!lttng_desc_match_enabler(desc, enabler)) {
+			/* Excluded events keep their existing backward ref. */
+			if (sync && event && lttng_event_enabler_ref(event, enabler))
+				lttng_event_sync_enablers(event);
 			continue;
+		}
+		if (!event) {
+			/*
+			 * We need to create an event for this
+			 * event probe.
+			 */
+			ret = lttng_event_create(desc, enabler->chan);
+			if (ret) {
+				DBG("Unable to create event %s, error %d\n",
+					desc->name, ret);
+				continue;
+			}
+			event = lttng_event_lookup(desc, enabler->chan);
+			assert(event);
+		}
 
 		enabler_ref = lttng_event_enabler_ref(event, enabler);
 		if (!enabler_ref) {
@@ -654,6 +656,9 @@ int lttng_enabler_ref_events(struct lttng_enabler *enabler)
 		lttng_enabler_event_link_bytecode(event, enabler);
 
 		/* TODO: merge event context. */
+
+		if (sync)
+			lttng_event_sync_enablers(event);
 	}
 	return 0;
 }
@@ -748,21 +753,21 @@ struct lttng_enabler *lttng_enabler_create(enum lttng_enabler_type type,
 	/* ctx left NULL */
 	enabler->enabled = 0;
 	cds_list_add(&enabler->node, &enabler->chan->session->enablers_head);
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_enabler_lazy_sync(enabler);
 	return enabler;
 }
 
 int lttng_enabler_enable(struct lttng_enabler *enabler)
 {
 	enabler->enabled = 1;
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_enabler_lazy_sync(enabler);
 	return 0;
 }
 
 int lttng_enabler_disable(struct lttng_enabler *enabler)
 {
 	enabler->enabled = 0;
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_enabler_lazy_sync(enabler);
 	return 0;
 }
 
@@ -771,7 +776,7 @@ int lttng_enabler_attach_bytecode(struct lttng_enabler *enabler,
 {
 	bytecode->enabler = enabler;
 	cds_list_add_tail(&bytecode->node, &enabler->filter_bytecode_head);
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_enabler_lazy_sync(enabler);
 	return 0;
 }
 
@@ -780,7 +785,21 @@ int lttng_enabler_attach_exclusion(struct lttng_enabler *enabler,
 {
 	excluder->enabler = enabler;
 	cds_list_add_tail(&excluder->node, &enabler->excluder_head);
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_enabler_lazy_sync(enabler);
+	return 0;
+}
+
+int lttng_enabler_attach_static_filter(struct lttng_enabler *enabler)
+{
+	enabler->static_filter = 1;
+	lttng_enabler_lazy_sync(enabler);
+	return 0;
+}
+
+int lttng_enabler_clear_static_filter(struct lttng_enabler *enabler)
+{
+	enabler->static_filter = 0;
+	lttng_enabler_lazy_sync(enabler);
 	return 0;
 }
 
@@ -866,73 +885,93 @@ void lttng_enabler_destroy(struct lttng_enabler *enabler)
 }
 
 /*
- * lttng_session_sync_enablers should be called just before starting a
- * session.
+ * If at least one of the enablers of an event is enabled, and its
+ * channel and session transient states are enabled, we enable the
+ * event, else we disable it. Then sync its filters with its enablers.
  */
 static
-void lttng_session_sync_enablers(struct lttng_session *session)
+void lttng_event_sync_enablers(struct lttng_event *event)
 {
-	struct lttng_enabler *enabler;
-	struct lttng_event *event;
+	struct lttng_session *session = event->chan->session;
+	struct lttng_enabler_ref *enabler_ref;
+	int enabled = 0, has_enablers_without_bytecode = 0;
+	void (*static_filter)(void);
 
-	cds_list_for_each_entry(enabler, &session->enablers_head, node)
-		lttng_enabler_ref_events(enabler);
+	/* Enable events */
+	cds_list_for_each_entry(enabler_ref,
+			&event->enablers_ref_head, node) {
+		if (enabler_ref->ref->enabled) {
+			enabled = 1;
+			break;
+		}
+	}
 	/*
-	 * For each event, if at least one of its enablers is enabled,
-	 * and its channel and session transient states are enabled, we
-	 * enable the event, else we disable it.
+	 * Enabled state is based on union of enablers, with
+	 * intesection of session and channel transient enable
+	 * states.
 	 */
-	cds_list_for_each_entry(event, &session->events_head, node) {
-		struct lttng_enabler_ref *enabler_ref;
-		struct lttng_bytecode_runtime *runtime;
-		int enabled = 0, has_enablers_without_bytecode = 0;
-
-		/* Enable events */
-		cds_list_for_each_entry(enabler_ref,
-				&event->enablers_ref_head, node) {
-			if (enabler_ref->ref->enabled) {
-				enabled = 1;
-				break;
-			}
-		}
-		/*
-		 * Enabled state is based on union of enablers, with
-		 * intesection of session and channel transient enable
-		 * states.
-		 */
-		enabled = enabled && session->tstate && event->chan->tstate;
+	enabled = enabled && session->tstate && event->chan->tstate;
 
-		CMM_STORE_SHARED(event->enabled, enabled);
-		/*
-		 * Sync tracepoint registration with event enabled
-		 * state.
-		 */
-		if (enabled) {
-			if (!event->registered)
-				register_event(event);
-		} else {
-			if (event->registered)
-				unregister_event(event);
-		}
+	CMM_STORE_SHARED(event->enabled, enabled);
+	/*
+	 * Sync tracepoint registration with event enabled
+	 * state.
+	 */
+	if (enabled) {
+		if (!event->registered)
+			register_event(event);
+	} else {
+		if (event->registered)
+			unregister_event(event);
+	}
 
-		/* Check if has enablers without bytecode enabled */
-		cds_list_for_each_entry(enabler_ref,
-				&event->enablers_ref_head, node) {
-			if (enabler_ref->ref->enabled
-					&& cds_list_empty(&enabler_ref->ref->filter_bytecode_head)) {
-				has_enablers_without_bytecode = 1;
-				break;
-			}
+	/* Check if has enablers without bytecode enabled */
+	cds_list_for_each_entry(enabler_ref,
+			&event->enablers_ref_head, node) {
+		if (enabler_ref->ref->enabled
+				&& cds_list_empty(&enabler_ref->ref->filter_bytecode_head)) {
+			has_enablers_without_bytecode = 1;
+			break;
 		}
-		event->has_enablers_without_bytecode =
-			has_enablers_without_bytecode;
+	}
+	event->has_enablers_without_bytecode =
+		has_enablers_without_bytecode;
 
-		/* Enable filters */
-		cds_list_for_each_entry(runtime,
-				&event->bytecode_runtime_head, node) {
-			lttng_filter_sync_state(runtime);
+	/*
+	 * The static filter is evaluated if all the enabled
+	 * enablers of the event ask for it.
+	 */
+	static_filter = NULL;
+	if (event->desc->u.ext.static_filter)
+		static_filter = *event->desc->u.ext.static_filter;
+	cds_list_for_each_entry(enabler_ref,
+			&event->enablers_ref_head, node) {
+		if (enabler_ref->ref->enabled
+				&& !enabler_ref->ref->static_filter) {
+			static_filter = NULL;
+			break;
 		}
 	}
+	CMM_STORE_SHARED(event->static_filter, static_filter);
+
+	/* Enable filters */
+	lttng_filter_event_sync_state(event);
+}
+
+/*
+ * lttng_session_sync_enablers should be called just before starting a
+ * session.
+ */
+static
+void lttng_session_sync_enablers(struct lttng_session *session)
+{
+	struct lttng_enabler *enabler;
+	struct lttng_event *event;
+
+	cds_list_for_each_entry(enabler, &session->enablers_head, node)
+		lttng_enabler_ref_events(enabler, 0);
+	cds_list_for_each_entry(event, &session->events_head, node)
+		lttng_event_sync_enablers(event);
 }
 
 /*
@@ -949,3 +988,22 @@ void lttng_session_lazy_sync_enablers(struct lttng_session *session)
 		return;
 	lttng_session_sync_enablers(session);
 }
+
+/*
+ * Apply a modified enabler to the events it matches, the state of the
+ * other events of the session does not depend on it. "lazy" sync means
+ * we only sync if required.
+ */
+static
+void lttng_enabler_lazy_sync(struct lttng_enabler *enabler)
+{
+	int ret;
+
+	/* We can skip if session is not active */
+	if (!enabler->chan->session->active)
+		return;
+	ret = lttng_enabler_ref_events(enabler, 1);
+	if (ret)
+		DBG("Error (%d) syncing enabler %s", ret,
+			enabler->event_param.name);
+}
@@ -21,6 +21,9 @@
  */
 
 #include "lttng-filter.h"
+#include "lttng-tracer-core.h"
+#include "../libringbuffer/getcpu.h"
+#include "clock.h"
 
 /*
  * -1: wildcard found.
@@ -55,6 +58,12 @@ int stack_strcmp(struct estack *stack, int top, const char *cmp_type)
 	int ret;
 	int diff;
 
+	if (!estack_bx(stack, top)->u.s.literal
+			&& !estack_ax(stack, top)->u.s.literal)
+		return lttng_filter_strcmp_plain(p,
+				estack_bx(stack, top)->u.s.seq_len, q,
+				estack_ax(stack, top)->u.s.seq_len);
+
 	for (;;) {
 		int escaped_r0 = 0;
 
@@ -115,6 +124,202 @@ int stack_strcmp(struct estack *stack, int top, const char *cmp_type)
 	return diff;
 }
 
+/*
+ * Match the candidate string against the globbing pattern, either of
+ * which may be on top of the stack.
+ */
+static
+int stack_star_glob_match(struct estack *stack, int top, const char *cmp_type)
+{
+	struct estack_entry *pattern, *candidate;
+
+	if (estack_bx(stack, top)->u.s.star_glob) {
+		pattern = estack_bx(stack, top);
+		candidate = estack_ax(stack, top);
+	} else {
+		pattern = estack_ax(stack, top);
+		candidate = estack_bx(stack, top);
+	}
+	return lttng_filter_star_glob_match(pattern->u.s.str,
+			candidate->u.s.str, candidate->u.s.seq_len);
+}
+
+/*
+ * Load element @index of an integer array or sequence, whose layout
+ * was checked by the validator.
+ */
+static inline
+int64_t load_elem(const char *ptr, const struct field_elem_ref *ref,
+		unsigned int index)
+{
+	ptr += (size_t) index * ref->elem_size;
+	switch (ref->elem_size) {
+	case 1:
+	{
+		uint8_t v;
+
+		memcpy(&v, ptr, sizeof(v));
+		return ref->elem_signed ? (int64_t) (int8_t) v : (int64_t) v;
+	}
+	case 2:
+	{
+		uint16_t v;
+
+		memcpy(&v, ptr, sizeof(v));
+		return ref->elem_signed ? (int64_t) (int16_t) v : (int64_t) v;
+	}
+	case 4:
+	{
+		uint32_t v;
+
+		memcpy(&v, ptr, sizeof(v));
+		return ref->elem_signed ? (int64_t) (int32_t) v : (int64_t) v;
+	}
+	default:
+	{
+		int64_t v;
+
+		memcpy(&v, ptr, sizeof(v));
+		return v;
+	}
+	}
+}
+
+static inline
+int cmp_s64(filter_opcode_t cmp, int64_t a, int64_t b)
+{
+	switch (cmp) {
+	case FILTER_OP_EQ:
+		return a == b;
+	case FILTER_OP_NE:
+		return a != b;
+	case FILTER_OP_GT:
+		return a > b;
+	case FILTER_OP_LT:
+		return a < b;
+	case FILTER_OP_GE:
+		return a >= b;
+	default:
+		return a <= b;
+	}
+}
+
+/*
+ * ANY (@all = 0) or ALL (@all = 1) of the first elements of the array
+ * or sequence compared with the literal.
+ */
+static
+int load_aggr(const char *ptr, unsigned long len,
+		const struct field_aggr_ref *ref, int all)
+{
+	unsigned int i, nr = min_t(unsigned long, len, ref->elem.index);
+
+	for (i = 0; i < nr; i++) {
+		if (cmp_s64(ref->cmp, load_elem(ptr, &ref->elem, i),
+				ref->v) != all)
+			return !all;
+	}
+	return all;
+}
+
+/*
+ * Sampling state of @slot for the current cpu. A thread preempted while
+ * updating it may race with the next thread running on that cpu: the
+ * counters are updated atomically, the rate limit may let an extra
+ * event through.
+ */
+static inline
+struct filter_sample_state *sample_state(struct bytecode_runtime *bytecode,
+		unsigned int slot)
+{
+	int cpu = lttng_ust_get_cpu();
+
+	if (unlikely(cpu < 0 || cpu >= bytecode->nr_cpus))
+		cpu = 0;
+	return &bytecode->sample_state[slot * bytecode->nr_cpus + cpu];
+}
+
+static
+int sample_keep(struct bytecode_runtime *bytecode,
+		const struct sample_op *insn)
+{
+	struct filter_sample_state *state = sample_state(bytecode, insn->slot);
+
+	if (uatomic_add_return(&state->seen, 1) % insn->period)
+		return 0;
+	uatomic_inc(&state->kept);
+	return 1;
+}
+
+/*
+ * Generic cell rate algorithm: each kept event pushes the theoretical
+ * arrival time one interval further, and events arriving more than
+ * burst - 1 intervals before it are discarded.
+ */
+static
+int rate_limit_keep(struct bytecode_runtime *bytecode,
+		const struct rate_limit_op *insn)
+{
+	struct filter_sample_state *state = sample_state(bytecode, insn->slot);
+	uint64_t now, tat, interval;
+
+	uatomic_inc(&state->seen);
+	interval = 1000000000ULL / insn->rate;
+	now = trace_clock_read64_monotonic();
+	tat = CMM_LOAD_SHARED(state->tat);
+	if (tat < now)
+		tat = now;
+	if (tat - now > (uint64_t) (insn->burst - 1) * interval)
+		return 0;
+	CMM_STORE_SHARED(state->tat, tat + interval);
+	uatomic_inc(&state->kept);
+	return 1;
+}
+
+/*
+ * Context values read during one evaluation, indexed by context field.
+ * A context referenced several times by a filter is only read once.
+ */
+#define FILTER_CTX_MEMO_LEN	32
+
+struct filter_ctx_memo {
+	uint32_t loaded;		/* bitmask of memoized values */
+	union lttng_ctx_value values[FILTER_CTX_MEMO_LEN];
+};
+
+static inline
+int filter_ctx_memo_get(struct filter_ctx_memo *memo, unsigned int idx,
+		union lttng_ctx_value *v)
+{
+	if (idx >= FILTER_CTX_MEMO_LEN || !(memo->loaded & (1U << idx)))
+		return 0;
+	*v = memo->values[idx];
+	return 1;
+}
+
+static inline
+void filter_ctx_memo_set(struct filter_ctx_memo *memo, unsigned int idx,
+		const union lttng_ctx_value *v)
+{
+	if (idx >= FILTER_CTX_MEMO_LEN)
+		return;
+	memo->values[idx] = *v;
+	memo->loaded |= 1U << idx;
+}
+
+static inline
+void filter_get_context(struct filter_ctx_memo *memo, unsigned int idx,
+		union lttng_ctx_value *v)
+{
+	struct lttng_ctx_field *ctx_field;
+
+	if (filter_ctx_memo_get(memo, idx, v))
+		return;
+	ctx_field = &lttng_static_ctx->fields[idx];
+	ctx_field->get_value(ctx_field, v);
+	filter_ctx_memo_set(memo, idx, v);
+}
+
 uint64_t lttng_filter_false(void *filter_data,
 		const char *filter_stack_data)
 {
@@ -183,8 +388,9 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 	struct estack *stack = &_stack;
 	register int64_t ax = 0, bx = 0;
 	register int top = FILTER_STACK_EMPTY;
+	struct filter_ctx_memo ctx_memo;
 #ifndef INTERPRETER_USE_SWITCH
-	static void *dispatch[NR_FILTER_OPS] = {
+	static void *dispatch[NR_FILTER_INTERNAL_OPS] = {
 		[ FILTER_OP_UNKNOWN ] = &&LABEL_FILTER_OP_UNKNOWN,
 
 		[ FILTER_OP_RETURN ] = &&LABEL_FILTER_OP_RETURN,
@@ -217,6 +423,10 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		[ FILTER_OP_GE_STRING ] = &&LABEL_FILTER_OP_GE_STRING,
 		[ FILTER_OP_LE_STRING ] = &&LABEL_FILTER_OP_LE_STRING,
 
+		/* globbing pattern binary comparator */
+		[ FILTER_OP_EQ_STAR_GLOB_STRING ] = &&LABEL_FILTER_OP_EQ_STAR_GLOB_STRING,
+		[ FILTER_OP_NE_STAR_GLOB_STRING ] = &&LABEL_FILTER_OP_NE_STAR_GLOB_STRING,
+
 		/* s64 binary comparator */
 		[ FILTER_OP_EQ_S64 ] = &&LABEL_FILTER_OP_EQ_S64,
 		[ FILTER_OP_NE_S64 ] = &&LABEL_FILTER_OP_NE_S64,
@@ -274,6 +484,8 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		[ FILTER_OP_LOAD_STRING ] = &&LABEL_FILTER_OP_LOAD_STRING,
 		[ FILTER_OP_LOAD_S64 ] = &&LABEL_FILTER_OP_LOAD_S64,
 		[ FILTER_OP_LOAD_DOUBLE ] = &&LABEL_FILTER_OP_LOAD_DOUBLE,
+		[ FILTER_OP_LOAD_STAR_GLOB_STRING ] = &&LABEL_FILTER_OP_LOAD_STAR_GLOB_STRING,
+		[ FILTER_OP_LOAD_STRING_PLAIN ] = &&LABEL_FILTER_OP_LOAD_STRING_PLAIN,
 
 		/* cast */
 		[ FILTER_OP_CAST_TO_S64 ] = &&LABEL_FILTER_OP_CAST_TO_S64,
@@ -285,13 +497,38 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		[ FILTER_OP_GET_CONTEXT_REF_STRING ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_STRING,
 		[ FILTER_OP_GET_CONTEXT_REF_S64 ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_S64,
 		[ FILTER_OP_GET_CONTEXT_REF_DOUBLE ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_DOUBLE,
+		[ FILTER_OP_GET_CONTEXT_REF_VTID ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_VTID,
+		[ FILTER_OP_GET_CONTEXT_REF_VPID ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_VPID,
+		[ FILTER_OP_GET_CONTEXT_REF_CPU_ID ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_CPU_ID,
+		[ FILTER_OP_GET_CONTEXT_REF_PROCNAME ] = &&LABEL_FILTER_OP_GET_CONTEXT_REF_PROCNAME,
+
+		/* load array or sequence element, length or aggregate */
+		[ FILTER_OP_LOAD_FIELD_REF_ELEM ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ELEM,
+		[ FILTER_OP_LOAD_FIELD_REF_LEN ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_LEN,
+		[ FILTER_OP_LOAD_FIELD_REF_ANY ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ANY,
+		[ FILTER_OP_LOAD_FIELD_REF_ALL ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ALL,
+		[ FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+		[ FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64,
+		[ FILTER_OP_LOAD_FIELD_REF_LEN_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_LEN_S64,
+		[ FILTER_OP_LOAD_FIELD_REF_ANY_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ANY_S64,
+		[ FILTER_OP_LOAD_FIELD_REF_ALL_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_ALL_S64,
+
+		/* sampling and rate limiting */
+		[ FILTER_OP_SAMPLE ] = &&LABEL_FILTER_OP_SAMPLE,
+		[ FILTER_OP_RATE_LIMIT ] = &&LABEL_FILTER_OP_RATE_LIMIT,
 	};
 #endif /* #ifndef INTERPRETER_USE_SWITCH */
 
+	ctx_memo.loaded = 0;
+
 	START_OP
 
 		OP(FILTER_OP_UNKNOWN):
 		OP(FILTER_OP_LOAD_FIELD_REF):
+		OP(FILTER_OP_LOAD_FIELD_REF_ELEM):
+		OP(FILTER_OP_LOAD_FIELD_REF_LEN):
+		OP(FILTER_OP_LOAD_FIELD_REF_ANY):
+		OP(FILTER_OP_LOAD_FIELD_REF_ALL):
 		OP(FILTER_OP_GET_CONTEXT_REF):
 #ifdef INTERPRETER_USE_SWITCH
 		default:
@@ -395,6 +632,27 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		OP(FILTER_OP_EQ_STAR_GLOB_STRING):
+		{
+			int res;
+
+			res = stack_star_glob_match(stack, top, "==");
+			estack_pop(stack, top, ax, bx);
+			estack_ax_v = res;
+			next_pc += sizeof(struct binary_op);
+			PO;
+		}
+		OP(FILTER_OP_NE_STAR_GLOB_STRING):
+		{
+			int res;
+
+			res = !stack_star_glob_match(stack, top, "!=");
+			estack_pop(stack, top, ax, bx);
+			estack_ax_v = res;
+			next_pc += sizeof(struct binary_op);
+			PO;
+		}
+
 		OP(FILTER_OP_EQ_S64):
 		{
 			int res;
@@ -736,6 +994,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			}
 			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
 			estack_ax(stack, top)->u.s.literal = 0;
+			estack_ax(stack, top)->u.s.star_glob = 0;
 			dbg_printf("ref load string %s\n", estack_ax(stack, top)->u.s.str);
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			PO;
@@ -760,10 +1019,79 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 				goto end;
 			}
 			estack_ax(stack, top)->u.s.literal = 0;
+			estack_ax(stack, top)->u.s.star_glob = 0;
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			PO;
 		}
 
+		OP(FILTER_OP_LOAD_FIELD_REF_LEN_S64):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_ref *ref = (struct field_ref *) insn->data;
+
+			dbg_printf("load field ref offset %u type length\n",
+				ref->offset);
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = *(unsigned long *) &filter_stack_data[ref->offset];
+			dbg_printf("ref load length %" PRIi64 "\n", estack_ax_v);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64):
+		OP(FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_elem_ref *ref = (struct field_elem_ref *) insn->data;
+			unsigned long len;
+			const char *ptr;
+
+			dbg_printf("load field ref offset %u element %u\n",
+				ref->offset, ref->index);
+			len = *(unsigned long *) &filter_stack_data[ref->offset];
+			ptr = *(const char **) (&filter_stack_data[ref->offset
+							+ sizeof(unsigned long)]);
+			/*
+			 * Also check array indexes: the bytecode may come
+			 * with the element loads already linked.
+			 */
+			if (unlikely(!ptr || ref->index >= len)) {
+				dbg_printf("Filter warning: element out of bounds.\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = load_elem(ptr, ref, ref->index);
+			dbg_printf("ref load element %" PRIi64 "\n", estack_ax_v);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_elem_ref);
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_FIELD_REF_ANY_S64):
+		OP(FILTER_OP_LOAD_FIELD_REF_ALL_S64):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_aggr_ref *ref = (struct field_aggr_ref *) insn->data;
+			unsigned long len;
+			const char *ptr;
+
+			dbg_printf("load field ref offset %u aggregate\n",
+				ref->elem.offset);
+			len = *(unsigned long *) &filter_stack_data[ref->elem.offset];
+			ptr = *(const char **) (&filter_stack_data[ref->elem.offset
+							+ sizeof(unsigned long)]);
+			if (unlikely(len && !ptr)) {
+				dbg_printf("Filter warning: loading a NULL sequence.\n");
+				ret = -EINVAL;
+				goto end;
+			}
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = load_aggr(ptr, len, ref,
+				*(filter_opcode_t *) pc == FILTER_OP_LOAD_FIELD_REF_ALL_S64);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_aggr_ref);
+			PO;
+		}
+
 		OP(FILTER_OP_LOAD_FIELD_REF_S64):
 		{
 			struct load_op *insn = (struct load_op *) pc;
@@ -794,6 +1122,27 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		/* sampling and rate limiting */
+		OP(FILTER_OP_SAMPLE):
+		{
+			struct sample_op *insn = (struct sample_op *) pc;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = sample_keep(bytecode, insn);
+			next_pc += sizeof(struct sample_op);
+			PO;
+		}
+
+		OP(FILTER_OP_RATE_LIMIT):
+		{
+			struct rate_limit_op *insn = (struct rate_limit_op *) pc;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = rate_limit_keep(bytecode, insn);
+			next_pc += sizeof(struct rate_limit_op);
+			PO;
+		}
+
 		/* load from immediate operand */
 		OP(FILTER_OP_LOAD_STRING):
 		{
@@ -804,6 +1153,35 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			estack_ax(stack, top)->u.s.str = insn->data;
 			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
 			estack_ax(stack, top)->u.s.literal = 1;
+			estack_ax(stack, top)->u.s.star_glob = 0;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_STAR_GLOB_STRING):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			dbg_printf("load globbing pattern %s\n", insn->data);
+			estack_push(stack, top, ax, bx);
+			estack_ax(stack, top)->u.s.str = insn->data;
+			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
+			estack_ax(stack, top)->u.s.literal = 1;
+			estack_ax(stack, top)->u.s.star_glob = 1;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_STRING_PLAIN):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			dbg_printf("load plain string %s\n", insn->data);
+			estack_push(stack, top, ax, bx);
+			estack_ax(stack, top)->u.s.str = insn->data;
+			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
+			estack_ax(stack, top)->u.s.literal = 0;
+			estack_ax(stack, top)->u.s.star_glob = 0;
 			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
 			PO;
 		}
@@ -858,13 +1236,11 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		{
 			struct load_op *insn = (struct load_op *) pc;
 			struct field_ref *ref = (struct field_ref *) insn->data;
-			struct lttng_ctx_field *ctx_field;
 			union lttng_ctx_value v;
 
 			dbg_printf("get context ref offset %u type string\n",
 				ref->offset);
-			ctx_field = &lttng_static_ctx->fields[ref->offset];
-			ctx_field->get_value(ctx_field, &v);
+			filter_get_context(&ctx_memo, ref->offset, &v);
 			estack_push(stack, top, ax, bx);
 			estack_ax(stack, top)->u.s.str = v.str;
 			if (unlikely(!estack_ax(stack, top)->u.s.str)) {
@@ -874,6 +1250,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			}
 			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
 			estack_ax(stack, top)->u.s.literal = 0;
+			estack_ax(stack, top)->u.s.star_glob = 0;
 			dbg_printf("ref get context string %s\n", estack_ax(stack, top)->u.s.str);
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			PO;
@@ -883,13 +1260,11 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		{
 			struct load_op *insn = (struct load_op *) pc;
 			struct field_ref *ref = (struct field_ref *) insn->data;
-			struct lttng_ctx_field *ctx_field;
 			union lttng_ctx_value v;
 
 			dbg_printf("get context ref offset %u type s64\n",
 				ref->offset);
-			ctx_field = &lttng_static_ctx->fields[ref->offset];
-			ctx_field->get_value(ctx_field, &v);
+			filter_get_context(&ctx_memo, ref->offset, &v);
 			estack_push(stack, top, ax, bx);
 			estack_ax_v = v.s64;
 			dbg_printf("ref get context s64 %" PRIi64 "\n", estack_ax_v);
@@ -901,13 +1276,11 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		{
 			struct load_op *insn = (struct load_op *) pc;
 			struct field_ref *ref = (struct field_ref *) insn->data;
-			struct lttng_ctx_field *ctx_field;
 			union lttng_ctx_value v;
 
 			dbg_printf("get context ref offset %u type double\n",
 				ref->offset);
-			ctx_field = &lttng_static_ctx->fields[ref->offset];
-			ctx_field->get_value(ctx_field, &v);
+			filter_get_context(&ctx_memo, ref->offset, &v);
 			estack_push(stack, top, ax, bx);
 			memcpy(&estack_ax(stack, top)->u.d, &v.d, sizeof(struct literal_double));
 			dbg_printf("ref get context double %g\n", estack_ax(stack, top)->u.d);
@@ -915,6 +1288,62 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		OP(FILTER_OP_GET_CONTEXT_REF_VTID):
+		{
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = lttng_context_vtid_get();
+			dbg_printf("ref get context vtid %" PRIi64 "\n", estack_ax_v);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			PO;
+		}
+
+		OP(FILTER_OP_GET_CONTEXT_REF_VPID):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_ref *ref = (struct field_ref *) insn->data;
+			union lttng_ctx_value v;
+
+			if (!filter_ctx_memo_get(&ctx_memo, ref->offset, &v)) {
+				v.s64 = lttng_context_vpid_get();
+				filter_ctx_memo_set(&ctx_memo, ref->offset, &v);
+			}
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = v.s64;
+			dbg_printf("ref get context vpid %" PRIi64 "\n", estack_ax_v);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			PO;
+		}
+
+		OP(FILTER_OP_GET_CONTEXT_REF_CPU_ID):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_ref *ref = (struct field_ref *) insn->data;
+			union lttng_ctx_value v;
+
+			/* Same cpu for all references within one evaluation. */
+			if (!filter_ctx_memo_get(&ctx_memo, ref->offset, &v)) {
+				v.s64 = lttng_ust_get_cpu();
+				filter_ctx_memo_set(&ctx_memo, ref->offset, &v);
+			}
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = v.s64;
+			dbg_printf("ref get context cpu_id %" PRIi64 "\n", estack_ax_v);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			PO;
+		}
+
+		OP(FILTER_OP_GET_CONTEXT_REF_PROCNAME):
+		{
+			estack_push(stack, top, ax, bx);
+			estack_ax(stack, top)->u.s.str = lttng_context_procname_get();
+			estack_ax(stack, top)->u.s.seq_len = UINT_MAX;
+			estack_ax(stack, top)->u.s.literal = 0;
+			estack_ax(stack, top)->u.s.star_glob = 0;
+			dbg_printf("ref get context procname %s\n", estack_ax(stack, top)->u.s.str);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			PO;
+		}
+
 	END_OP
 end:
 	/* return 0 (discard) on error */
@@ -0,0 +1,697 @@
+/*
+ * lttng-filter-jit.c
+ *
+ * LTTng UST filter bytecode JIT compiler.
+ *
+ * Compiles the integer subset of specialized filter bytecode to native
+ * code. Each stack entry is mapped to a register, which is possible
+ * because the stack depth at each instruction is known once the
+ * bytecode has been validated. Bytecode using other instructions is
+ * left to the interpreter.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "lttng-filter.h"
+#include "getenv.h"
+
+/* Upper bound of native code size emitted for one bytecode instruction. */
+#define JIT_MAX_INSN_LEN	24
+
+/* Set by LTTNG_UST_WITHOUT_FILTER_JIT. */
+static int jit_disabled;
+
+struct jit_fixup {
+	uint32_t native_offset;		/* jump instruction to patch */
+	uint16_t target;		/* jump target bytecode offset */
+};
+
+struct jit_state {
+	uint8_t *code;
+	size_t len;
+	struct jit_fixup *fixups;
+	unsigned int nr_fixups;
+};
+
+static
+void jit_add_fixup(struct jit_state *s, size_t native_offset,
+		uint16_t target)
+{
+	s->fixups[s->nr_fixups].native_offset = native_offset;
+	s->fixups[s->nr_fixups].target = target;
+	s->nr_fixups++;
+}
+
+#if defined(__x86_64__)
+
+/*
+ * System V calling convention: filter_stack_data is in %rsi, the stack
+ * entries are kept in caller-saved registers, so no stack frame is
+ * needed.
+ */
+#define JIT_NR_REGS	8
+
+enum {
+	X86_RAX = 0,
+	X86_RCX = 1,
+	X86_RDX = 2,
+	X86_RSI = 6,
+	X86_RDI = 7,
+	X86_R8 = 8,
+	X86_R9 = 9,
+	X86_R10 = 10,
+	X86_R11 = 11,
+};
+
+static const int jit_reg[JIT_NR_REGS] = {
+	X86_RAX, X86_RCX, X86_RDX, X86_RDI,
+	X86_R8, X86_R9, X86_R10, X86_R11,
+};
+
+static
+void emit8(struct jit_state *s, uint8_t v)
+{
+	s->code[s->len++] = v;
+}
+
+static
+void emit32(struct jit_state *s, uint32_t v)
+{
+	memcpy(&s->code[s->len], &v, sizeof(v));
+	s->len += sizeof(v);
+}
+
+static
+void emit64(struct jit_state *s, uint64_t v)
+{
+	memcpy(&s->code[s->len], &v, sizeof(v));
+	s->len += sizeof(v);
+}
+
+static
+uint8_t rex(int w, int reg, int rm)
+{
+	return 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+}
+
+static
+uint8_t modrm_reg(int reg, int rm)
+{
+	return 0xC0 | ((reg & 7) << 3) | (rm & 7);
+}
+
+/* setcc reg8; movzx reg, reg8 */
+static
+void emit_setcc(struct jit_state *s, uint8_t cc, int reg)
+{
+	emit8(s, rex(0, 0, reg));
+	emit8(s, 0x0F);
+	emit8(s, cc);
+	emit8(s, modrm_reg(0, reg));
+	emit8(s, rex(1, reg, reg));
+	emit8(s, 0x0F);
+	emit8(s, 0xB6);
+	emit8(s, modrm_reg(reg, reg));
+}
+
+/* test reg, reg */
+static
+void emit_test(struct jit_state *s, int reg)
+{
+	emit8(s, rex(1, reg, reg));
+	emit8(s, 0x85);
+	emit8(s, modrm_reg(reg, reg));
+}
+
+static
+void jit_emit_load_field(struct jit_state *s, int reg, uint16_t offset)
+{
+	/* mov reg, [rsi + disp32] */
+	emit8(s, rex(1, reg, X86_RSI));
+	emit8(s, 0x8B);
+	emit8(s, 0x80 | ((reg & 7) << 3) | X86_RSI);
+	emit32(s, offset);
+}
+
+static
+void jit_emit_load_imm(struct jit_state *s, int reg, int64_t v)
+{
+	if (v == (int32_t) v) {
+		/* mov reg, simm32 */
+		emit8(s, rex(1, 0, reg));
+		emit8(s, 0xC7);
+		emit8(s, modrm_reg(0, reg));
+		emit32(s, (uint32_t) v);
+	} else {
+		/* movabs reg, imm64 */
+		emit8(s, rex(1, 0, reg));
+		emit8(s, 0xB8 + (reg & 7));
+		emit64(s, (uint64_t) v);
+	}
+}
+
+static
+void jit_emit_cmp(struct jit_state *s, filter_opcode_t op, int bx, int ax)
+{
+	uint8_t cc;
+
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		cc = 0x94;	/* sete */
+		break;
+	case FILTER_OP_NE_S64:
+		cc = 0x95;	/* setne */
+		break;
+	case FILTER_OP_GT_S64:
+		cc = 0x9F;	/* setg */
+		break;
+	case FILTER_OP_LT_S64:
+		cc = 0x9C;	/* setl */
+		break;
+	case FILTER_OP_GE_S64:
+		cc = 0x9D;	/* setge */
+		break;
+	case FILTER_OP_LE_S64:
+	default:
+		cc = 0x9E;	/* setle */
+		break;
+	}
+	/* cmp bx, ax */
+	emit8(s, rex(1, ax, bx));
+	emit8(s, 0x39);
+	emit8(s, modrm_reg(ax, bx));
+	emit_setcc(s, cc, bx);
+}
+
+static
+void jit_emit_neg(struct jit_state *s, int reg)
+{
+	emit8(s, rex(1, 0, reg));
+	emit8(s, 0xF7);
+	emit8(s, modrm_reg(3, reg));
+}
+
+static
+void jit_emit_not(struct jit_state *s, int reg)
+{
+	emit_test(s, reg);
+	emit_setcc(s, 0x94, reg);	/* sete */
+}
+
+/* Jump to @target if reg is zero. */
+static
+void jit_emit_and(struct jit_state *s, int reg, uint16_t target)
+{
+	emit_test(s, reg);
+	emit8(s, 0x0F);
+	emit8(s, 0x84);			/* jz rel32 */
+	jit_add_fixup(s, s->len, target);
+	emit32(s, 0);
+}
+
+/* Set reg to 1 and jump to @target if reg is nonzero. */
+static
+void jit_emit_or(struct jit_state *s, int reg, uint16_t target)
+{
+	emit_test(s, reg);
+	emit8(s, 0x74);			/* jz rel8 */
+	emit8(s, (reg >> 3) + 5 + 5);
+	/* mov reg32, 1 */
+	if (reg >> 3)
+		emit8(s, rex(0, 0, reg));
+	emit8(s, 0xB8 + (reg & 7));
+	emit32(s, 1);
+	emit8(s, 0xE9);			/* jmp rel32 */
+	jit_add_fixup(s, s->len, target);
+	emit32(s, 0);
+}
+
+static
+void jit_emit_return(struct jit_state *s, int reg)
+{
+	emit_test(s, reg);
+	emit8(s, 0x0F);			/* setne al */
+	emit8(s, 0x95);
+	emit8(s, 0xC0);
+	emit8(s, 0x0F);			/* movzx eax, al */
+	emit8(s, 0xB6);
+	emit8(s, 0xC0);
+	emit8(s, 0xC3);			/* ret */
+}
+
+static
+void jit_emit_return_false(struct jit_state *s)
+{
+	emit8(s, 0x31);			/* xor eax, eax */
+	emit8(s, 0xC0);
+	emit8(s, 0xC3);			/* ret */
+}
+
+static
+int jit_patch(struct jit_state *s, const struct jit_fixup *fixup,
+		size_t target)
+{
+	int32_t rel = target - (fixup->native_offset + sizeof(int32_t));
+
+	memcpy(&s->code[fixup->native_offset], &rel, sizeof(rel));
+	return 0;
+}
+
+static
+void jit_flush_icache(void *code, size_t len)
+{
+}
+
+#elif defined(__aarch64__)
+
+/*
+ * AAPCS64: filter_stack_data is in x1, the stack entries are kept in
+ * the x2-x9 argument/result registers, x10 is used as scratch.
+ */
+#define JIT_NR_REGS	8
+
+#define A64_X0		0
+#define A64_X1		1
+#define A64_X10		10
+#define A64_XZR		31
+
+enum {
+	A64_COND_EQ = 0x0,
+	A64_COND_NE = 0x1,
+	A64_COND_GE = 0xA,
+	A64_COND_LT = 0xB,
+	A64_COND_GT = 0xC,
+	A64_COND_LE = 0xD,
+};
+
+static const int jit_reg[JIT_NR_REGS] = {
+	2, 3, 4, 5, 6, 7, 8, 9,
+};
+
+static
+void emit_insn(struct jit_state *s, uint32_t insn)
+{
+	memcpy(&s->code[s->len], &insn, sizeof(insn));
+	s->len += sizeof(insn);
+}
+
+/* cset reg, cond (csinc reg, xzr, xzr, !cond) */
+static
+void emit_cset(struct jit_state *s, int cond, int reg)
+{
+	emit_insn(s, 0x9A9F07E0 | ((cond ^ 1) << 12) | reg);
+}
+
+/* cmp reg, #0 */
+static
+void emit_cmp_zero(struct jit_state *s, int reg)
+{
+	emit_insn(s, 0xF100001F | (reg << 5));
+}
+
+static
+void jit_emit_load_field(struct jit_state *s, int reg, uint16_t offset)
+{
+	if (!(offset & 7) && (offset >> 3) < 4096) {
+		/* ldr reg, [x1, #offset] */
+		emit_insn(s, 0xF9400000 | ((offset >> 3) << 10)
+				| (A64_X1 << 5) | reg);
+	} else {
+		/* movz x10, #offset; ldr reg, [x1, x10] */
+		emit_insn(s, 0xD2800000 | (offset << 5) | A64_X10);
+		emit_insn(s, 0xF8606800 | (A64_X10 << 16)
+				| (A64_X1 << 5) | reg);
+	}
+}
+
+static
+void jit_emit_load_imm(struct jit_state *s, int reg, int64_t v)
+{
+	uint64_t u = (uint64_t) v;
+	int hw;
+
+	/* movz reg, #imm16; movk reg, #imm16, lsl #(hw * 16) */
+	emit_insn(s, 0xD2800000 | ((u & 0xFFFF) << 5) | reg);
+	for (hw = 1; hw < 4; hw++) {
+		uint32_t imm16 = (u >> (hw * 16)) & 0xFFFF;
+
+		if (!imm16)
+			continue;
+		emit_insn(s, 0xF2800000 | (hw << 21) | (imm16 << 5) | reg);
+	}
+}
+
+static
+void jit_emit_cmp(struct jit_state *s, filter_opcode_t op, int bx, int ax)
+{
+	int cond;
+
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		cond = A64_COND_EQ;
+		break;
+	case FILTER_OP_NE_S64:
+		cond = A64_COND_NE;
+		break;
+	case FILTER_OP_GT_S64:
+		cond = A64_COND_GT;
+		break;
+	case FILTER_OP_LT_S64:
+		cond = A64_COND_LT;
+		break;
+	case FILTER_OP_GE_S64:
+		cond = A64_COND_GE;
+		break;
+	case FILTER_OP_LE_S64:
+	default:
+		cond = A64_COND_LE;
+		break;
+	}
+	/* cmp bx, ax */
+	emit_insn(s, 0xEB000000 | (ax << 16) | (bx << 5) | A64_XZR);
+	emit_cset(s, cond, bx);
+}
+
+static
+void jit_emit_neg(struct jit_state *s, int reg)
+{
+	/* sub reg, xzr, reg */
+	emit_insn(s, 0xCB000000 | (reg << 16) | (A64_XZR << 5) | reg);
+}
+
+static
+void jit_emit_not(struct jit_state *s, int reg)
+{
+	emit_cmp_zero(s, reg);
+	emit_cset(s, A64_COND_EQ, reg);
+}
+
+/* Jump to @target if reg is zero. */
+static
+void jit_emit_and(struct jit_state *s, int reg, uint16_t target)
+{
+	jit_add_fixup(s, s->len, target);
+	emit_insn(s, 0xB4000000 | reg);		/* cbz reg, target */
+}
+
+/* Set reg to 1 and jump to @target if reg is nonzero. */
+static
+void jit_emit_or(struct jit_state *s, int reg, uint16_t target)
+{
+	emit_insn(s, 0xB4000000 | (3 << 5) | reg);	/* cbz reg, +12 */
+	emit_insn(s, 0xD2800020 | reg);			/* movz reg, #1 */
+	jit_add_fixup(s, s->len, target);
+	emit_insn(s, 0x14000000);			/* b target */
+}
+
+static
+void jit_emit_return(struct jit_state *s, int reg)
+{
+	emit_cmp_zero(s, reg);
+	emit_cset(s, A64_COND_NE, A64_X0);
+	emit_insn(s, 0xD65F03C0);		/* ret */
+}
+
+static
+void jit_emit_return_false(struct jit_state *s)
+{
+	emit_insn(s, 0xD2800000 | A64_X0);	/* movz x0, #0 */
+	emit_insn(s, 0xD65F03C0);		/* ret */
+}
+
+static
+int jit_patch(struct jit_state *s, const struct jit_fixup *fixup,
+		size_t target)
+{
+	int64_t rel = ((int64_t) target - fixup->native_offset) >> 2;
+	uint32_t insn;
+
+	memcpy(&insn, &s->code[fixup->native_offset], sizeof(insn));
+	if ((insn & 0xFC000000) == 0x14000000) {
+		/* b: imm26 */
+		insn |= rel & 0x3FFFFFF;
+	} else {
+		/* cbz: imm19 */
+		if (rel >= (1 << 18))
+			return -ERANGE;
+		insn |= (rel & 0x7FFFF) << 5;
+	}
+	memcpy(&s->code[fixup->native_offset], &insn, sizeof(insn));
+	return 0;
+}
+
+static
+void jit_flush_icache(void *code, size_t len)
+{
+	__builtin___clear_cache((char *) code, (char *) code + len);
+}
+
+#endif
+
+#ifdef JIT_NR_REGS
+
+/*
+ * Copy the generated code to its own mapping, made executable once
+ * written. Fails if the W^X policy in effect (e.g. SELinux execmem,
+ * PaX MPROTECT) forbids it.
+ */
+static
+int jit_install(struct bytecode_runtime *bytecode, struct jit_state *s)
+{
+	size_t page_size = sysconf(_SC_PAGE_SIZE);
+	size_t len = (s->len + page_size - 1) & ~(page_size - 1);
+	void *code;
+
+	code = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED)
+		return -errno;
+	memcpy(code, s->code, s->len);
+	if (mprotect(code, len, PROT_READ | PROT_EXEC)) {
+		int ret = -errno;
+
+		(void) munmap(code, len);
+		return ret;
+	}
+	jit_flush_icache(code, s->len);
+	bytecode->jit_code = code;
+	bytecode->jit_len = len;
+	return 0;
+}
+
+/*
+ * Return 0 and set bytecode->jit_code on success, a negative error
+ * value if the bytecode must be interpreted.
+ */
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode)
+{
+	struct jit_state s = { NULL, 0, NULL, 0 };
+	uint32_t *pc_map = NULL;
+	int *depth_at = NULL;
+	char *pc, *next_pc, *start_pc;
+	int depth = 0, ret;
+	unsigned int i;
+
+	if (jit_disabled)
+		return -ENOTSUP;
+
+	s.code = malloc((size_t) bytecode->len * JIT_MAX_INSN_LEN
+			+ JIT_MAX_INSN_LEN);
+	s.fixups = malloc((bytecode->len / sizeof(struct logical_op) + 1)
+			* sizeof(*s.fixups));
+	pc_map = malloc((bytecode->len + 1) * sizeof(*pc_map));
+	depth_at = malloc((bytecode->len + 1) * sizeof(*depth_at));
+	if (!s.code || !s.fixups || !pc_map || !depth_at) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	for (i = 0; i <= bytecode->len; i++)
+		depth_at[i] = -1;
+
+	start_pc = &bytecode->data[0];
+	for (pc = start_pc; pc - start_pc < bytecode->len; pc = next_pc) {
+		uint16_t offset = pc - start_pc;
+		filter_opcode_t op = *(filter_opcode_t *) pc;
+
+		pc_map[offset] = s.len;
+		/* Stack depth at merge points was checked by the validator. */
+		if (depth_at[offset] >= 0) {
+			if (depth < 0)
+				depth = depth_at[offset];
+			else if (depth != depth_at[offset]) {
+				ret = -EINVAL;
+				goto end;
+			}
+		}
+		if (depth < 0) {
+			/* Unreachable instruction. */
+			ret = -EINVAL;
+			goto end;
+		}
+
+		switch (op) {
+		case FILTER_OP_RETURN:
+			if (depth < 1) {
+				ret = -EINVAL;
+				goto end;
+			}
+			jit_emit_return(&s, jit_reg[depth - 1]);
+			depth = -1;
+			next_pc = pc + sizeof(struct return_op);
+			break;
+
+		case FILTER_OP_EQ_S64:
+		case FILTER_OP_NE_S64:
+		case FILTER_OP_GT_S64:
+		case FILTER_OP_LT_S64:
+		case FILTER_OP_GE_S64:
+		case FILTER_OP_LE_S64:
+			if (depth < 2) {
+				ret = -EINVAL;
+				goto end;
+			}
+			jit_emit_cmp(&s, op, jit_reg[depth - 2],
+				jit_reg[depth - 1]);
+			depth--;
+			next_pc = pc + sizeof(struct binary_op);
+			break;
+
+		case FILTER_OP_UNARY_PLUS_S64:
+		case FILTER_OP_UNARY_MINUS_S64:
+		case FILTER_OP_UNARY_NOT_S64:
+			if (depth < 1) {
+				ret = -EINVAL;
+				goto end;
+			}
+			if (op == FILTER_OP_UNARY_MINUS_S64)
+				jit_emit_neg(&s, jit_reg[depth - 1]);
+			else if (op == FILTER_OP_UNARY_NOT_S64)
+				jit_emit_not(&s, jit_reg[depth - 1]);
+			next_pc = pc + sizeof(struct unary_op);
+			break;
+
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+		{
+			struct logical_op *insn = (struct logical_op *) pc;
+			uint16_t target = insn->skip_offset;
+
+			if (depth < 1 || target <= offset
+					|| target > bytecode->len
+					|| (depth_at[target] >= 0
+						&& depth_at[target] != depth)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			/* The jump keeps AX, the fall-through pops it. */
+			depth_at[target] = depth;
+			if (op == FILTER_OP_AND)
+				jit_emit_and(&s, jit_reg[depth - 1], target);
+			else
+				jit_emit_or(&s, jit_reg[depth - 1], target);
+			depth--;
+			next_pc = pc + sizeof(struct logical_op);
+			break;
+		}
+
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_ref *ref = (struct field_ref *) insn->data;
+
+			if (depth >= JIT_NR_REGS) {
+				ret = -ENOTSUP;
+				goto end;
+			}
+			jit_emit_load_field(&s, jit_reg[depth], ref->offset);
+			depth++;
+			next_pc = pc + sizeof(struct load_op)
+					+ sizeof(struct field_ref);
+			break;
+		}
+
+		case FILTER_OP_LOAD_S64:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			if (depth >= JIT_NR_REGS) {
+				ret = -ENOTSUP;
+				goto end;
+			}
+			jit_emit_load_imm(&s, jit_reg[depth],
+				((struct literal_numeric *) insn->data)->v);
+			depth++;
+			next_pc = pc + sizeof(struct load_op)
+					+ sizeof(struct literal_numeric);
+			break;
+		}
+
+		case FILTER_OP_CAST_NOP:
+			next_pc = pc + sizeof(struct cast_op);
+			break;
+
+		default:
+			dbg_printf("JIT: unsupported op %s, interpreting.\n",
+				print_op((unsigned int) op));
+			ret = -ENOTSUP;
+			goto end;
+		}
+	}
+	/* Falling off the end of the bytecode discards the event. */
+	pc_map[bytecode->len] = s.len;
+	jit_emit_return_false(&s);
+
+	for (i = 0; i < s.nr_fixups; i++) {
+		ret = jit_patch(&s, &s.fixups[i], pc_map[s.fixups[i].target]);
+		if (ret)
+			goto end;
+	}
+	ret = jit_install(bytecode, &s);
+	if (!ret)
+		dbg_printf("JIT: %zu bytes of native code.\n", s.len);
+end:
+	free(depth_at);
+	free(pc_map);
+	free(s.fixups);
+	free(s.code);
+	return ret;
+}
+
+#else /* #ifdef JIT_NR_REGS */
+
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode)
+{
+	return -ENOTSUP;
+}
+
+#endif /* #else #ifdef JIT_NR_REGS */
+
+void lttng_filter_jit_init(void)
+{
+	if (lttng_secure_getenv("LTTNG_UST_WITHOUT_FILTER_JIT"))
+		jit_disabled = 1;
+}
+
+void lttng_filter_jit_free(struct bytecode_runtime *bytecode)
+{
+	if (!bytecode->jit_code)
+		return;
+	(void) munmap(bytecode->jit_code, bytecode->jit_len);
+	bytecode->jit_code = NULL;
+}
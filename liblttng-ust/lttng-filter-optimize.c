@@ -0,0 +1,457 @@
+/*
+ * lttng-filter-optimize.c
+ *
+ * LTTng UST filter code optimizer.
+ *
+ * Peephole pass over specialized bytecode, run before it is interpreted
+ * or compiled: folds operations on immediate operands, removes
+ * no-op casts and unary plus, removes logical operators with a
+ * constant outcome, and threads chains of identical logical operators
+ * into a single jump.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include "lttng-filter.h"
+
+/* Size of the instruction at @pc, or 0 if unknown. */
+static
+size_t insn_len(const char *pc)
+{
+	switch (*(filter_opcode_t *) pc) {
+	case FILTER_OP_RETURN:
+		return sizeof(struct return_op);
+
+	case FILTER_OP_MUL:
+	case FILTER_OP_DIV:
+	case FILTER_OP_MOD:
+	case FILTER_OP_PLUS:
+	case FILTER_OP_MINUS:
+	case FILTER_OP_RSHIFT:
+	case FILTER_OP_LSHIFT:
+	case FILTER_OP_BIN_AND:
+	case FILTER_OP_BIN_OR:
+	case FILTER_OP_BIN_XOR:
+	case FILTER_OP_EQ:
+	case FILTER_OP_NE:
+	case FILTER_OP_GT:
+	case FILTER_OP_LT:
+	case FILTER_OP_GE:
+	case FILTER_OP_LE:
+	case FILTER_OP_EQ_STRING:
+	case FILTER_OP_NE_STRING:
+	case FILTER_OP_GT_STRING:
+	case FILTER_OP_LT_STRING:
+	case FILTER_OP_GE_STRING:
+	case FILTER_OP_LE_STRING:
+	case FILTER_OP_EQ_STAR_GLOB_STRING:
+	case FILTER_OP_NE_STAR_GLOB_STRING:
+	case FILTER_OP_EQ_S64:
+	case FILTER_OP_NE_S64:
+	case FILTER_OP_GT_S64:
+	case FILTER_OP_LT_S64:
+	case FILTER_OP_GE_S64:
+	case FILTER_OP_LE_S64:
+	case FILTER_OP_EQ_DOUBLE:
+	case FILTER_OP_NE_DOUBLE:
+	case FILTER_OP_GT_DOUBLE:
+	case FILTER_OP_LT_DOUBLE:
+	case FILTER_OP_GE_DOUBLE:
+	case FILTER_OP_LE_DOUBLE:
+	case FILTER_OP_EQ_DOUBLE_S64:
+	case FILTER_OP_NE_DOUBLE_S64:
+	case FILTER_OP_GT_DOUBLE_S64:
+	case FILTER_OP_LT_DOUBLE_S64:
+	case FILTER_OP_GE_DOUBLE_S64:
+	case FILTER_OP_LE_DOUBLE_S64:
+	case FILTER_OP_EQ_S64_DOUBLE:
+	case FILTER_OP_NE_S64_DOUBLE:
+	case FILTER_OP_GT_S64_DOUBLE:
+	case FILTER_OP_LT_S64_DOUBLE:
+	case FILTER_OP_GE_S64_DOUBLE:
+	case FILTER_OP_LE_S64_DOUBLE:
+		return sizeof(struct binary_op);
+
+	case FILTER_OP_UNARY_PLUS:
+	case FILTER_OP_UNARY_MINUS:
+	case FILTER_OP_UNARY_NOT:
+	case FILTER_OP_UNARY_PLUS_S64:
+	case FILTER_OP_UNARY_MINUS_S64:
+	case FILTER_OP_UNARY_NOT_S64:
+	case FILTER_OP_UNARY_PLUS_DOUBLE:
+	case FILTER_OP_UNARY_MINUS_DOUBLE:
+	case FILTER_OP_UNARY_NOT_DOUBLE:
+		return sizeof(struct unary_op);
+
+	case FILTER_OP_AND:
+	case FILTER_OP_OR:
+		return sizeof(struct logical_op);
+
+	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_STRING:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+	case FILTER_OP_LOAD_FIELD_REF_S64:
+	case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF:
+	case FILTER_OP_GET_CONTEXT_REF_STRING:
+	case FILTER_OP_GET_CONTEXT_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF_VTID:
+	case FILTER_OP_GET_CONTEXT_REF_VPID:
+	case FILTER_OP_GET_CONTEXT_REF_CPU_ID:
+	case FILTER_OP_GET_CONTEXT_REF_PROCNAME:
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+	case FILTER_OP_LOAD_FIELD_REF_LEN_S64:
+		return sizeof(struct load_op) + sizeof(struct field_ref);
+
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+	case FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64:
+		return sizeof(struct load_op) + sizeof(struct field_elem_ref);
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
+	case FILTER_OP_LOAD_FIELD_REF_ANY_S64:
+	case FILTER_OP_LOAD_FIELD_REF_ALL_S64:
+		return sizeof(struct load_op) + sizeof(struct field_aggr_ref);
+
+	case FILTER_OP_LOAD_STRING:
+	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	case FILTER_OP_LOAD_STRING_PLAIN:
+		return sizeof(struct load_op)
+			+ strlen(((struct load_op *) pc)->data) + 1;
+	case FILTER_OP_LOAD_S64:
+		return sizeof(struct load_op) + sizeof(struct literal_numeric);
+	case FILTER_OP_LOAD_DOUBLE:
+		return sizeof(struct load_op) + sizeof(struct literal_double);
+
+	case FILTER_OP_CAST_TO_S64:
+	case FILTER_OP_CAST_DOUBLE_TO_S64:
+	case FILTER_OP_CAST_NOP:
+		return sizeof(struct cast_op);
+
+	case FILTER_OP_SAMPLE:
+		return sizeof(struct sample_op);
+	case FILTER_OP_RATE_LIMIT:
+		return sizeof(struct rate_limit_op);
+
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Immediate operand of a LOAD_S64 or LOAD_DOUBLE instruction. Returns
+ * 0 if @pc does not load an immediate.
+ */
+static
+int load_imm(const char *pc, struct estack_entry *v, int *is_double)
+{
+	const struct load_op *insn = (const struct load_op *) pc;
+
+	switch (insn->op) {
+	case FILTER_OP_LOAD_S64:
+		memcpy(&v->u.v, insn->data, sizeof(struct literal_numeric));
+		*is_double = 0;
+		return 1;
+	case FILTER_OP_LOAD_DOUBLE:
+		memcpy(&v->u.d, insn->data, sizeof(struct literal_double));
+		*is_double = 1;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static
+size_t emit_load_s64(char *out, int64_t v)
+{
+	struct load_op *insn = (struct load_op *) out;
+
+	insn->op = FILTER_OP_LOAD_S64;
+	memcpy(insn->data, &v, sizeof(struct literal_numeric));
+	return sizeof(struct load_op) + sizeof(struct literal_numeric);
+}
+
+static
+size_t emit_load_double(char *out, double d)
+{
+	struct load_op *insn = (struct load_op *) out;
+
+	insn->op = FILTER_OP_LOAD_DOUBLE;
+	memcpy(insn->data, &d, sizeof(struct literal_double));
+	return sizeof(struct load_op) + sizeof(struct literal_double);
+}
+
+/*
+ * Evaluate a typed comparator on immediates, with the same conversions
+ * as the interpreter. Returns 0 if @op is not a typed comparator.
+ */
+static
+int fold_cmp(filter_opcode_t op, const struct estack_entry *bx,
+		int bx_double, const struct estack_entry *ax, int ax_double,
+		int64_t *res)
+{
+	double a, b;
+
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		*res = bx->u.v == ax->u.v;
+		return 1;
+	case FILTER_OP_NE_S64:
+		*res = bx->u.v != ax->u.v;
+		return 1;
+	case FILTER_OP_GT_S64:
+		*res = bx->u.v > ax->u.v;
+		return 1;
+	case FILTER_OP_LT_S64:
+		*res = bx->u.v < ax->u.v;
+		return 1;
+	case FILTER_OP_GE_S64:
+		*res = bx->u.v >= ax->u.v;
+		return 1;
+	case FILTER_OP_LE_S64:
+		*res = bx->u.v <= ax->u.v;
+		return 1;
+	default:
+		break;
+	}
+
+	b = bx_double ? bx->u.d : (double) bx->u.v;
+	a = ax_double ? ax->u.d : (double) ax->u.v;
+	switch (op) {
+	case FILTER_OP_EQ_DOUBLE:
+	case FILTER_OP_EQ_DOUBLE_S64:
+	case FILTER_OP_EQ_S64_DOUBLE:
+		*res = b == a;
+		return 1;
+	case FILTER_OP_NE_DOUBLE:
+	case FILTER_OP_NE_DOUBLE_S64:
+	case FILTER_OP_NE_S64_DOUBLE:
+		*res = b != a;
+		return 1;
+	case FILTER_OP_GT_DOUBLE:
+	case FILTER_OP_GT_DOUBLE_S64:
+	case FILTER_OP_GT_S64_DOUBLE:
+		*res = b > a;
+		return 1;
+	case FILTER_OP_LT_DOUBLE:
+	case FILTER_OP_LT_DOUBLE_S64:
+	case FILTER_OP_LT_S64_DOUBLE:
+		*res = b < a;
+		return 1;
+	case FILTER_OP_GE_DOUBLE:
+	case FILTER_OP_GE_DOUBLE_S64:
+	case FILTER_OP_GE_S64_DOUBLE:
+		*res = b >= a;
+		return 1;
+	case FILTER_OP_LE_DOUBLE:
+	case FILTER_OP_LE_DOUBLE_S64:
+	case FILTER_OP_LE_S64_DOUBLE:
+		*res = b <= a;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Retarget AND (resp. OR) jumps landing on another AND (resp. OR): the
+ * value jumped with makes the second one jump as well.
+ */
+static
+void thread_jumps(struct bytecode_runtime *bytecode)
+{
+	char *pc, *start_pc = &bytecode->data[0];
+	size_t len;
+
+	for (pc = start_pc; pc - start_pc < bytecode->len; pc += len) {
+		struct logical_op *insn = (struct logical_op *) pc;
+
+		len = insn_len(pc);
+		if (insn->op != FILTER_OP_AND && insn->op != FILTER_OP_OR)
+			continue;
+		while (insn->skip_offset < bytecode->len) {
+			struct logical_op *target = (struct logical_op *)
+				(start_pc + insn->skip_offset);
+
+			if (target->op != insn->op)
+				break;
+			insn->skip_offset = target->skip_offset;
+		}
+	}
+}
+
+/*
+ * One peephole pass. Instructions are copied to @out, with @map
+ * receiving the new offset of each original instruction. Folding only
+ * spans instructions which are not jump targets, except for the first
+ * one. Returns the new bytecode length.
+ */
+static
+size_t optimize_pass(struct bytecode_runtime *bytecode, char *out,
+		uint16_t *map, const char *is_target)
+{
+	char *pc, *next_pc, *start_pc = &bytecode->data[0];
+	size_t out_len = 0;
+
+	for (pc = start_pc; pc - start_pc < bytecode->len; pc = next_pc) {
+		size_t offset = pc - start_pc, len = insn_len(pc);
+		struct estack_entry v1, v2;
+		int d1, d2;
+		char *pc2 = pc + len, *pc3;
+		size_t offset2 = offset + len, offset3, len2 = 0;
+
+		next_pc = pc2;
+		map[offset] = out_len;
+
+		switch (*(filter_opcode_t *) pc) {
+		case FILTER_OP_CAST_NOP:
+		case FILTER_OP_UNARY_PLUS_S64:
+		case FILTER_OP_UNARY_PLUS_DOUBLE:
+			/* Jumps to a no-op land on the next instruction. */
+			continue;
+		default:
+			break;
+		}
+
+		if (!load_imm(pc, &v1, &d1) || offset2 >= bytecode->len
+				|| is_target[offset2])
+			goto copy;
+		len2 = insn_len(pc2);
+		offset3 = offset2 + len2;
+		pc3 = pc2 + len2;
+
+		switch (*(filter_opcode_t *) pc2) {
+		case FILTER_OP_UNARY_MINUS_S64:
+			map[offset2] = out_len;
+			out_len += emit_load_s64(out + out_len, -v1.u.v);
+			next_pc = pc3;
+			continue;
+		case FILTER_OP_UNARY_NOT_S64:
+			map[offset2] = out_len;
+			out_len += emit_load_s64(out + out_len, !v1.u.v);
+			next_pc = pc3;
+			continue;
+		case FILTER_OP_UNARY_MINUS_DOUBLE:
+			map[offset2] = out_len;
+			out_len += emit_load_double(out + out_len, -v1.u.d);
+			next_pc = pc3;
+			continue;
+		case FILTER_OP_UNARY_NOT_DOUBLE:
+			map[offset2] = out_len;
+			out_len += emit_load_double(out + out_len, !v1.u.d);
+			next_pc = pc3;
+			continue;
+		case FILTER_OP_CAST_DOUBLE_TO_S64:
+			map[offset2] = out_len;
+			out_len += emit_load_s64(out + out_len,
+					(int64_t) v1.u.d);
+			next_pc = pc3;
+			continue;
+		case FILTER_OP_AND:
+		case FILTER_OP_OR:
+		{
+			int is_and = *(filter_opcode_t *) pc2 == FILTER_OP_AND;
+			int nonzero = d1 ? v1.u.d != 0 : v1.u.v != 0;
+
+			/* Never taken: the operator only pops the immediate. */
+			if (d1 || is_and != nonzero)
+				goto copy;
+			map[offset2] = out_len;
+			next_pc = pc3;
+			continue;
+		}
+		default:
+			break;
+		}
+
+		if (!load_imm(pc2, &v2, &d2) || offset3 >= bytecode->len
+				|| is_target[offset3])
+			goto copy;
+		{
+			int64_t res;
+
+			if (!fold_cmp(*(filter_opcode_t *) pc3, &v1, d1,
+					&v2, d2, &res))
+				goto copy;
+			map[offset2] = out_len;
+			map[offset3] = out_len;
+			out_len += emit_load_s64(out + out_len, res);
+			next_pc = pc3 + insn_len(pc3);
+			continue;
+		}
+	copy:
+		memcpy(out + out_len, pc, len);
+		out_len += len;
+	}
+	map[bytecode->len] = out_len;
+	return out_len;
+}
+
+int lttng_filter_optimize_bytecode(struct bytecode_runtime *bytecode)
+{
+	char *out = NULL, *is_target = NULL;
+	uint16_t *map = NULL;
+	int ret = 0;
+
+	out = malloc(bytecode->len);
+	map = malloc((bytecode->len + 1) * sizeof(*map));
+	is_target = malloc(bytecode->len + 1);
+	if (!out || !map || !is_target) {
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	for (;;) {
+		char *pc, *start_pc = &bytecode->data[0];
+		size_t len, out_len;
+
+		thread_jumps(bytecode);
+		memset(is_target, 0, bytecode->len + 1);
+		for (pc = start_pc; pc - start_pc < bytecode->len; pc += len) {
+			struct logical_op *insn = (struct logical_op *) pc;
+
+			len = insn_len(pc);
+			if (!len) {
+				ret = -EINVAL;
+				goto end;
+			}
+			if (insn->op == FILTER_OP_AND
+					|| insn->op == FILTER_OP_OR)
+				is_target[insn->skip_offset] = 1;
+		}
+
+		out_len = optimize_pass(bytecode, out, map, is_target);
+		if (out_len == bytecode->len)
+			break;
+		for (pc = out; pc - out < out_len; pc += insn_len(pc)) {
+			struct logical_op *insn = (struct logical_op *) pc;
+
+			if (insn->op == FILTER_OP_AND
+					|| insn->op == FILTER_OP_OR)
+				insn->skip_offset = map[insn->skip_offset];
+		}
+		dbg_printf("Optimized bytecode from %u to %zu bytes.\n",
+			(unsigned int) bytecode->len, out_len);
+		memcpy(bytecode->data, out, out_len);
+		bytecode->len = out_len;
+	}
+end:
+	free(is_target);
+	free(map);
+	free(out);
+	return ret;
+}
@@ -72,8 +72,14 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 				ret = -EINVAL;
 				goto end;
 
+			case REG_STAR_GLOB_STRING:
+				insn->op = FILTER_OP_EQ_STAR_GLOB_STRING;
+				break;
 			case REG_STRING:
-				insn->op = FILTER_OP_EQ_STRING;
+				if (vstack_bx(stack)->type == REG_STAR_GLOB_STRING)
+					insn->op = FILTER_OP_EQ_STAR_GLOB_STRING;
+				else
+					insn->op = FILTER_OP_EQ_STRING;
 				break;
 			case REG_S64:
 				if (vstack_bx(stack)->type == REG_S64)
@@ -108,8 +114,14 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 				ret = -EINVAL;
 				goto end;
 
+			case REG_STAR_GLOB_STRING:
+				insn->op = FILTER_OP_NE_STAR_GLOB_STRING;
+				break;
 			case REG_STRING:
-				insn->op = FILTER_OP_NE_STRING;
+				if (vstack_bx(stack)->type == REG_STAR_GLOB_STRING)
+					insn->op = FILTER_OP_NE_STAR_GLOB_STRING;
+				else
+					insn->op = FILTER_OP_NE_STRING;
 				break;
 			case REG_S64:
 				if (vstack_bx(stack)->type == REG_S64)
@@ -278,6 +290,8 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 		case FILTER_OP_LT_STRING:
 		case FILTER_OP_GE_STRING:
 		case FILTER_OP_LE_STRING:
+		case FILTER_OP_EQ_STAR_GLOB_STRING:
+		case FILTER_OP_NE_STAR_GLOB_STRING:
 		case FILTER_OP_EQ_S64:
 		case FILTER_OP_NE_S64:
 		case FILTER_OP_GT_S64:
@@ -408,6 +422,10 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 
 		/* load field ref */
 		case FILTER_OP_LOAD_FIELD_REF:
+		case FILTER_OP_LOAD_FIELD_REF_ELEM:
+		case FILTER_OP_LOAD_FIELD_REF_LEN:
+		case FILTER_OP_LOAD_FIELD_REF_ANY:
+		case FILTER_OP_LOAD_FIELD_REF_ALL:
 		{
 			ERR("Unknown field ref type\n");
 			ret = -EINVAL;
@@ -423,6 +441,7 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 		case FILTER_OP_LOAD_FIELD_REF_STRING:
 		case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
 		case FILTER_OP_GET_CONTEXT_REF_STRING:
+		case FILTER_OP_GET_CONTEXT_REF_PROCNAME:
 		{
 			if (vstack_push(stack)) {
 				ret = -EINVAL;
@@ -434,6 +453,9 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 		}
 		case FILTER_OP_LOAD_FIELD_REF_S64:
 		case FILTER_OP_GET_CONTEXT_REF_S64:
+		case FILTER_OP_GET_CONTEXT_REF_VTID:
+		case FILTER_OP_GET_CONTEXT_REF_VPID:
+		case FILTER_OP_GET_CONTEXT_REF_CPU_ID:
 		{
 			if (vstack_push(stack)) {
 				ret = -EINVAL;
@@ -454,12 +476,78 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			break;
 		}
+		case FILTER_OP_LOAD_FIELD_REF_LEN_S64:
+		{
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+		}
+		case FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64:
+		case FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64:
+		{
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct load_op) + sizeof(struct field_elem_ref);
+			break;
+		}
+		case FILTER_OP_LOAD_FIELD_REF_ANY_S64:
+		case FILTER_OP_LOAD_FIELD_REF_ALL_S64:
+		{
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct load_op) + sizeof(struct field_aggr_ref);
+			break;
+		}
+
+		/* sampling and rate limiting */
+		case FILTER_OP_SAMPLE:
+		{
+			struct sample_op *insn = (struct sample_op *) pc;
+
+			insn->slot = bytecode->nr_sample_slots++;
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct sample_op);
+			break;
+		}
+		case FILTER_OP_RATE_LIMIT:
+		{
+			struct rate_limit_op *insn = (struct rate_limit_op *) pc;
+
+			insn->slot = bytecode->nr_sample_slots++;
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct rate_limit_op);
+			break;
+		}
 
 		/* load from immediate operand */
 		case FILTER_OP_LOAD_STRING:
 		{
 			struct load_op *insn = (struct load_op *) pc;
 
+			/*
+			 * Literals without wildcard nor escape compare as
+			 * plain strings.
+			 */
+			if (!strpbrk(insn->data, "*\\"))
+				insn->op = FILTER_OP_LOAD_STRING_PLAIN;
 			if (vstack_push(stack)) {
 				ret = -EINVAL;
 				goto end;
@@ -469,6 +557,32 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 			break;
 		}
 
+		case FILTER_OP_LOAD_STRING_PLAIN:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_STRING;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			break;
+		}
+
+		case FILTER_OP_LOAD_STAR_GLOB_STRING:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_STAR_GLOB_STRING;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			break;
+		}
+
 		case FILTER_OP_LOAD_S64:
 		{
 			if (vstack_push(stack)) {
@@ -505,6 +619,7 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 				goto end;
 
 			case REG_STRING:
+			case REG_STAR_GLOB_STRING:
 				ERR("Cast op can only be applied to numeric or floating point registers\n");
 				ret = -EINVAL;
 				goto end;
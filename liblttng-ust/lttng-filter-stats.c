@@ -0,0 +1,234 @@
+/*
+ * lttng-filter-stats.c
+ *
+ * LTTng UST filter statistics.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <urcu/uatomic.h>
+#include <lttng/ust-events.h>
+#include <helper.h>
+#include "lttng-filter.h"
+#include "lttng-tracer-core.h"
+#include "clock.h"
+#include "../libringbuffer/getcpu.h"
+
+static const char *str_filter_stats;
+static int got_filter_stats_env;
+
+static inline
+uint64_t filter_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return trace_clock_read64_monotonic();
+#endif
+}
+
+static inline
+unsigned int filter_cycles_bucket(uint64_t cycles)
+{
+	unsigned int bucket;
+
+	if (!cycles)
+		return 0;
+	bucket = 64 - __builtin_clzll(cycles);
+	if (bucket >= LTTNG_UST_FILTER_STATS_NR_BUCKETS)
+		bucket = LTTNG_UST_FILTER_STATS_NR_BUCKETS - 1;
+	return bucket;
+}
+
+/*
+ * Allocate the per-cpu statistics of a filter if the application runs
+ * with LTTNG_UST_FILTER_STATS set. Filters without statistics are
+ * called directly by the probes, at no cost.
+ * Called with ust lock held.
+ */
+int lttng_filter_stats_alloc(struct bytecode_runtime *runtime)
+{
+	size_t len;
+	void *stats;
+
+	if (!got_filter_stats_env) {
+		str_filter_stats = getenv("LTTNG_UST_FILTER_STATS");
+		got_filter_stats_env = 1;
+	}
+	if (!str_filter_stats)
+		return 0;
+	len = (size_t) runtime->nr_cpus * sizeof(struct filter_stats_cpu);
+	/* Each cpu updates its own cache lines. */
+	if (posix_memalign(&stats, CAA_CACHE_LINE_SIZE, len))
+		return -ENOMEM;
+	memset(stats, 0, len);
+	runtime->stats = stats;
+	return 0;
+}
+
+/*
+ * Filter function installed in place of the native code or the
+ * interpreter of filters having statistics. Threads preempted while
+ * updating the statistics of a cpu may race with the next thread
+ * running on it, hence the atomic increments, which are uncontended.
+ */
+uint64_t lttng_filter_profile(void *filter_data,
+		const char *filter_stack_data)
+{
+	struct bytecode_runtime *runtime = filter_data;
+	struct filter_stats_cpu *stats;
+	uint64_t start, ret;
+	int cpu;
+
+	start = filter_cycles();
+	if (runtime->jit_code)
+		ret = ((filter_func_t) runtime->jit_code)(filter_data,
+				filter_stack_data);
+	else
+		ret = lttng_filter_interpret_bytecode(filter_data,
+				filter_stack_data);
+	cpu = lttng_ust_get_cpu();
+	if (caa_unlikely(cpu < 0 || cpu >= runtime->nr_cpus))
+		cpu = 0;
+	stats = &runtime->stats[cpu];
+	uatomic_inc(&stats->cycles[filter_cycles_bucket(filter_cycles() - start)]);
+	uatomic_inc(&stats->evaluations);
+	if (ret & LTTNG_FILTER_RECORD_FLAG)
+		uatomic_inc(&stats->accepts);
+	return ret;
+}
+
+static
+void filter_stats_add(struct lttng_ust_filter_stats_iter *iter,
+		const struct bytecode_runtime *runtime)
+{
+	int cpu;
+	unsigned int i;
+
+	for (cpu = 0; cpu < runtime->nr_cpus; cpu++) {
+		const struct filter_stats_cpu *stats = &runtime->stats[cpu];
+
+		iter->evaluations += CMM_LOAD_SHARED(stats->evaluations);
+		iter->accepts += CMM_LOAD_SHARED(stats->accepts);
+		for (i = 0; i < LTTNG_UST_FILTER_STATS_NR_BUCKETS; i++)
+			iter->cycles[i] += CMM_LOAD_SHARED(stats->cycles[i]);
+	}
+}
+
+void lttng_filter_prune_stats_list(struct lttng_ust_filter_stats_list *list)
+{
+	struct filter_stats_list_entry *list_entry, *tmp;
+
+	cds_list_for_each_entry_safe(list_entry, tmp, &list->head, head) {
+		cds_list_del(&list_entry->head);
+		free(list_entry);
+	}
+}
+
+/*
+ * List the statistics of the events having filters with sampling or
+ * rate limiting operators, profiled filters, or evaluating their static
+ * filter, in all sessions. Called with UST lock held.
+ */
+int lttng_filter_get_stats_list(struct lttng_ust_filter_stats_list *list)
+{
+	struct cds_list_head *sessions = _lttng_get_sessions();
+	struct lttng_session *session;
+
+	CDS_INIT_LIST_HEAD(&list->head);
+	cds_list_for_each_entry(session, sessions, node) {
+		struct lttng_event *event;
+
+		cds_list_for_each_entry(event, &session->events_head, node) {
+			struct filter_stats_list_entry *list_entry = NULL;
+			struct lttng_bytecode_runtime *p;
+			uint64_t seen, kept;
+
+			cds_list_for_each_entry(p, &event->bytecode_runtime_head,
+					node) {
+				struct bytecode_runtime *runtime =
+					caa_container_of(p, struct bytecode_runtime, p);
+
+				if (!runtime->stats && !runtime->nr_sample_slots)
+					continue;
+				if (!list_entry) {
+					list_entry = zmalloc(sizeof(*list_entry));
+					if (!list_entry)
+						goto err_nomem;
+					cds_list_add_tail(&list_entry->head,
+						&list->head);
+				}
+				if (runtime->stats)
+					filter_stats_add(&list_entry->stats, runtime);
+			}
+			if (!list_entry && event->static_filter) {
+				list_entry = zmalloc(sizeof(*list_entry));
+				if (!list_entry)
+					goto err_nomem;
+				cds_list_add_tail(&list_entry->head,
+					&list->head);
+			}
+			if (!list_entry)
+				continue;
+			if (event->static_filter) {
+				strncpy(list_entry->stats.static_filter,
+					*event->desc->u.ext.static_filter_expr,
+					LTTNG_UST_SYM_NAME_LEN);
+				list_entry->stats.static_filter[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+			}
+			strncpy(list_entry->stats.event_name, event->desc->name,
+				LTTNG_UST_SYM_NAME_LEN);
+			list_entry->stats.event_name[LTTNG_UST_SYM_NAME_LEN - 1] = '\0';
+			list_entry->stats.session_handle = session->objd;
+			list_entry->stats.channel_handle = event->chan->objd;
+			lttng_filter_event_sample_counts(event, &seen, &kept);
+			list_entry->stats.sample_seen = seen;
+			list_entry->stats.sample_kept = kept;
+		}
+	}
+	if (cds_list_empty(&list->head))
+		list->iter = NULL;
+	else
+		list->iter = cds_list_first_entry(&list->head,
+				struct filter_stats_list_entry, head);
+	return 0;
+
+err_nomem:
+	lttng_filter_prune_stats_list(list);
+	return -ENOMEM;
+}
+
+/*
+ * Return current iteration position, advance internal iterator to next.
+ * Return NULL if end of list.
+ */
+struct lttng_ust_filter_stats_iter *
+	lttng_ust_filter_stats_list_get_iter_next(struct lttng_ust_filter_stats_list *list)
+{
+	struct filter_stats_list_entry *entry;
+
+	if (!list->iter)
+		return NULL;
+	entry = list->iter;
+	if (entry->head.next == &list->head)
+		list->iter = NULL;
+	else
+		list->iter = cds_list_entry(entry->head.next,
+				struct filter_stats_list_entry, head);
+	return &entry->stats;
+}
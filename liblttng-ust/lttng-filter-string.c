@@ -0,0 +1,232 @@
+/*
+ * lttng-filter-string.c
+ *
+ * LTTng UST filter string comparison and globbing pattern matching.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include "lttng-filter.h"
+
+#define FILTER_PAGE_SIZE	4096
+
+/*
+ * Compare one character at index @i. Returns 1 and sets @ret when the
+ * comparison is decided, 0 to continue with the next character.
+ */
+static inline
+int strcmp_plain_char(const char *p, size_t p_len,
+		const char *q, size_t q_len, size_t i, int *ret)
+{
+	int p_end = i >= p_len || p[i] == '\0';
+	int q_end = i >= q_len || q[i] == '\0';
+
+	if (p_end) {
+		*ret = q_end ? 0 : -1;
+		return 1;
+	}
+	if (q_end) {
+		*ret = 1;
+		return 1;
+	}
+	*ret = p[i] - q[i];
+	return *ret != 0;
+}
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+/*
+ * Vector loads of @width bytes at index @i are allowed if they stay
+ * within both bounded strings and do not cross a page boundary, past
+ * which the terminating '\0' of a string may be unmapped.
+ */
+static inline
+int strcmp_vec_ok(const char *p, size_t p_len, const char *q, size_t q_len,
+		size_t i, size_t width)
+{
+	if (i + width > p_len || i + width > q_len)
+		return 0;
+	if (((uintptr_t) (p + i) & (FILTER_PAGE_SIZE - 1))
+			> FILTER_PAGE_SIZE - width)
+		return 0;
+	if (((uintptr_t) (q + i) & (FILTER_PAGE_SIZE - 1))
+			> FILTER_PAGE_SIZE - width)
+		return 0;
+	return 1;
+}
+
+/*
+ * Skip the vectors which are equal and free of '\0', the character
+ * deciding the comparison is then handled by strcmp_plain_char().
+ */
+static
+int strcmp_plain_sse2(const char *p, size_t p_len,
+		const char *q, size_t q_len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	int ret;
+
+	for (;;) {
+		if (strcmp_vec_ok(p, p_len, q, q_len, i, 16)) {
+			__m128i a, b;
+			unsigned int mask;
+
+			a = _mm_loadu_si128((const __m128i *) (p + i));
+			b = _mm_loadu_si128((const __m128i *) (q + i));
+			mask = _mm_movemask_epi8(_mm_cmpeq_epi8(a, b))
+				& ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, zero));
+			if (mask == 0xFFFFU) {
+				i += 16;
+				continue;
+			}
+			i += __builtin_ctz(~mask);
+		}
+		if (strcmp_plain_char(p, p_len, q, q_len, i, &ret))
+			return ret;
+		i++;
+	}
+}
+
+static __attribute__((target("avx2")))
+int strcmp_plain_avx2(const char *p, size_t p_len,
+		const char *q, size_t q_len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	int ret;
+
+	for (;;) {
+		if (strcmp_vec_ok(p, p_len, q, q_len, i, 32)) {
+			__m256i a, b;
+			unsigned int mask;
+
+			a = _mm256_loadu_si256((const __m256i *) (p + i));
+			b = _mm256_loadu_si256((const __m256i *) (q + i));
+			mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))
+				& ~_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, zero));
+			if (mask == 0xFFFFFFFFU) {
+				i += 32;
+				continue;
+			}
+			i += __builtin_ctz(~mask);
+		}
+		if (strcmp_plain_char(p, p_len, q, q_len, i, &ret))
+			return ret;
+		i++;
+	}
+}
+
+int (*lttng_filter_strcmp_plain)(const char *p, size_t p_len,
+		const char *q, size_t q_len) = strcmp_plain_sse2;
+
+void lttng_filter_string_init(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		lttng_filter_strcmp_plain = strcmp_plain_avx2;
+}
+
+#else
+
+static
+int strcmp_plain_generic(const char *p, size_t p_len,
+		const char *q, size_t q_len)
+{
+	size_t i;
+	int ret;
+
+	for (i = 0; !strcmp_plain_char(p, p_len, q, q_len, i, &ret); i++)
+		;
+	return ret;
+}
+
+int (*lttng_filter_strcmp_plain)(const char *p, size_t p_len,
+		const char *q, size_t q_len) = strcmp_plain_generic;
+
+void lttng_filter_string_init(void)
+{
+}
+
+#endif
+
+/*
+ * Pattern character at @p, with its length in the pattern. '\' escapes
+ * the next character.
+ */
+static inline
+char glob_char(const char *p, size_t *len)
+{
+	if (p[0] == '\\' && p[1] != '\0') {
+		*len = 2;
+		return p[1];
+	}
+	*len = 1;
+	return p[0];
+}
+
+/*
+ * Match @candidate, bounded by @candidate_len or '\0', against the
+ * star globbing @pattern: '*' matches any sequence of characters, and
+ * the match is anchored at both ends. Only the last star needs to be
+ * backtracked to, so matching is linear in the candidate length for
+ * each pattern segment. Returns 1 on match, 0 otherwise.
+ */
+int lttng_filter_star_glob_match(const char *pattern,
+		const char *candidate, size_t candidate_len)
+{
+	const char *p = pattern, *c = candidate;
+	const char *end = candidate + strnlen(candidate, candidate_len);
+	const char *star_p = NULL, *star_c = NULL;
+
+	while (c < end) {
+		size_t len;
+		char pc;
+
+		if (*p == '*') {
+			while (*p == '*')
+				p++;
+			/* Trailing star matches the rest of the candidate. */
+			if (*p == '\0')
+				return 1;
+			star_p = p;
+			star_c = c;
+			continue;
+		}
+		pc = glob_char(p, &len);
+		if (pc != '\0' && pc == *c) {
+			p += len;
+			c++;
+			continue;
+		}
+		if (!star_p)
+			return 0;
+		/* Retry the segment at the next occurrence of its head. */
+		p = star_p;
+		pc = glob_char(p, &len);
+		c = memchr(star_c + 1, pc, end - (star_c + 1));
+		if (!c)
+			return 0;
+		star_c = c;
+	}
+	while (*p == '*')
+		p++;
+	return *p == '\0';
+}
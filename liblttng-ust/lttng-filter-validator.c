@@ -120,7 +120,8 @@ int merge_point_add_check(struct cds_lfht *ht, unsigned long target_pc,
  * Binary comparators use top of stack and top of stack -1.
  */
 static
-int bin_op_compare_check(struct vstack *stack, const char *str)
+int bin_op_compare_check(struct vstack *stack, filter_opcode_t opcode,
+		const char *str)
 {
 	if (unlikely(!vstack_ax(stack) || !vstack_bx(stack)))
 		goto error_unknown;
@@ -136,6 +137,25 @@ int bin_op_compare_check(struct vstack *stack, const char *str)
 
 		case REG_STRING:
 			break;
+		case REG_STAR_GLOB_STRING:
+			if (opcode != FILTER_OP_EQ && opcode != FILTER_OP_NE)
+				goto error_mismatch;
+			break;
+		case REG_S64:
+		case REG_DOUBLE:
+			goto error_mismatch;
+		}
+		break;
+	case REG_STAR_GLOB_STRING:
+		switch (vstack_bx(stack)->type) {
+		default:
+			goto error_unknown;
+
+		case REG_STRING:
+			if (opcode != FILTER_OP_EQ && opcode != FILTER_OP_NE)
+				goto error_mismatch;
+			break;
+		case REG_STAR_GLOB_STRING:
 		case REG_S64:
 		case REG_DOUBLE:
 			goto error_mismatch;
@@ -148,6 +168,7 @@ int bin_op_compare_check(struct vstack *stack, const char *str)
 			goto error_unknown;
 
 		case REG_STRING:
+		case REG_STAR_GLOB_STRING:
 			goto error_mismatch;
 
 		case REG_S64:
@@ -249,6 +270,8 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 	case FILTER_OP_LT_S64_DOUBLE:
 	case FILTER_OP_GE_S64_DOUBLE:
 	case FILTER_OP_LE_S64_DOUBLE:
+	case FILTER_OP_EQ_STAR_GLOB_STRING:
+	case FILTER_OP_NE_STAR_GLOB_STRING:
 	{
 		if (unlikely(pc + sizeof(struct binary_op)
 				> start_pc + bytecode->len)) {
@@ -288,6 +311,10 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 
 	/* load field ref */
 	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
 	{
 		ERR("Unknown field ref type\n");
 		ret = -EINVAL;
@@ -307,6 +334,11 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 	case FILTER_OP_GET_CONTEXT_REF_STRING:
 	case FILTER_OP_GET_CONTEXT_REF_S64:
 	case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
+	case FILTER_OP_GET_CONTEXT_REF_VTID:
+	case FILTER_OP_GET_CONTEXT_REF_VPID:
+	case FILTER_OP_GET_CONTEXT_REF_CPU_ID:
+	case FILTER_OP_GET_CONTEXT_REF_PROCNAME:
+	case FILTER_OP_LOAD_FIELD_REF_LEN_S64:
 	{
 		if (unlikely(pc + sizeof(struct load_op) + sizeof(struct field_ref)
 				> start_pc + bytecode->len)) {
@@ -314,9 +346,46 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 		}
 		break;
 	}
+	case FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64:
+	{
+		if (unlikely(pc + sizeof(struct load_op) + sizeof(struct field_elem_ref)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_ANY_S64:
+	case FILTER_OP_LOAD_FIELD_REF_ALL_S64:
+	{
+		if (unlikely(pc + sizeof(struct load_op) + sizeof(struct field_aggr_ref)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
+
+	/* sampling and rate limiting */
+	case FILTER_OP_SAMPLE:
+	{
+		if (unlikely(pc + sizeof(struct sample_op)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
+	case FILTER_OP_RATE_LIMIT:
+	{
+		if (unlikely(pc + sizeof(struct rate_limit_op)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
 
 	/* load from immediate operand */
 	case FILTER_OP_LOAD_STRING:
+	case FILTER_OP_LOAD_STAR_GLOB_STRING:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 		uint32_t str_len, maxlen;
@@ -389,6 +458,26 @@ unsigned long delete_all_nodes(struct cds_lfht *ht)
 	return nr_nodes;
 }
 
+/*
+ * Element loads read elem_size bytes at index * elem_size of the array
+ * or sequence, within its bounds.
+ */
+static
+int validate_elem_ref(const struct field_elem_ref *ref)
+{
+	switch (ref->elem_size) {
+	case 1:
+	case 2:
+	case 4:
+	case 8:
+		return 0;
+	default:
+		ERR("Invalid array element size %u\n",
+			(unsigned int) ref->elem_size);
+		return -EINVAL;
+	}
+}
+
 /*
  * Return value:
  * 0: success
@@ -437,42 +526,42 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 
 	case FILTER_OP_EQ:
 	{
-		ret = bin_op_compare_check(stack, "==");
+		ret = bin_op_compare_check(stack, FILTER_OP_EQ, "==");
 		if (ret)
 			goto end;
 		break;
 	}
 	case FILTER_OP_NE:
 	{
-		ret = bin_op_compare_check(stack, "!=");
+		ret = bin_op_compare_check(stack, FILTER_OP_NE, "!=");
 		if (ret)
 			goto end;
 		break;
 	}
 	case FILTER_OP_GT:
 	{
-		ret = bin_op_compare_check(stack, ">");
+		ret = bin_op_compare_check(stack, FILTER_OP_GT, ">");
 		if (ret)
 			goto end;
 		break;
 	}
 	case FILTER_OP_LT:
 	{
-		ret = bin_op_compare_check(stack, "<");
+		ret = bin_op_compare_check(stack, FILTER_OP_LT, "<");
 		if (ret)
 			goto end;
 		break;
 	}
 	case FILTER_OP_GE:
 	{
-		ret = bin_op_compare_check(stack, ">=");
+		ret = bin_op_compare_check(stack, FILTER_OP_GE, ">=");
 		if (ret)
 			goto end;
 		break;
 	}
 	case FILTER_OP_LE:
 	{
-		ret = bin_op_compare_check(stack, "<=");
+		ret = bin_op_compare_check(stack, FILTER_OP_LE, "<=");
 		if (ret)
 			goto end;
 		break;
@@ -499,6 +588,25 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	case FILTER_OP_EQ_STAR_GLOB_STRING:
+	case FILTER_OP_NE_STAR_GLOB_STRING:
+	{
+		if (!vstack_ax(stack) || !vstack_bx(stack)) {
+			ERR("Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		if ((vstack_ax(stack)->type != REG_STAR_GLOB_STRING
+				|| vstack_bx(stack)->type != REG_STRING)
+			&& (vstack_ax(stack)->type != REG_STRING
+				|| vstack_bx(stack)->type != REG_STAR_GLOB_STRING)) {
+			ERR("Unexpected register type for globbing pattern comparator\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+
 	case FILTER_OP_EQ_S64:
 	case FILTER_OP_NE_S64:
 	case FILTER_OP_GT_S64:
@@ -597,6 +705,7 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 			goto end;
 
 		case REG_STRING:
+		case REG_STAR_GLOB_STRING:
 			ERR("Unary op can only be applied to numeric or floating point registers\n");
 			ret = -EINVAL;
 			goto end;
@@ -704,9 +813,98 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 			ref->offset);
 		break;
 	}
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
+	{
+		ERR("Unknown field ref type\n");
+		ret = -EINVAL;
+		goto end;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_LEN_S64:
+	{
+		struct load_op *insn = (struct load_op *) pc;
+		struct field_ref *ref = (struct field_ref *) insn->data;
+
+		dbg_printf("Validate load field ref offset %u type length\n",
+			ref->offset);
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64:
+	{
+		struct load_op *insn = (struct load_op *) pc;
+		struct field_elem_ref *ref = (struct field_elem_ref *) insn->data;
+
+		dbg_printf("Validate load field ref offset %u element %u\n",
+			ref->offset, ref->index);
+		ret = validate_elem_ref(ref);
+		if (ret)
+			goto end;
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_ANY_S64:
+	case FILTER_OP_LOAD_FIELD_REF_ALL_S64:
+	{
+		struct load_op *insn = (struct load_op *) pc;
+		struct field_aggr_ref *ref = (struct field_aggr_ref *) insn->data;
+
+		dbg_printf("Validate load field ref offset %u aggregate of %u elements\n",
+			ref->elem.offset, ref->elem.index);
+		ret = validate_elem_ref(&ref->elem);
+		if (ret)
+			goto end;
+		if (ref->elem.index > FILTER_AGGR_MAX_LEN) {
+			ERR("Aggregate over more than %u elements\n",
+				FILTER_AGGR_MAX_LEN);
+			ret = -EINVAL;
+			goto end;
+		}
+		switch (ref->cmp) {
+		case FILTER_OP_EQ:
+		case FILTER_OP_NE:
+		case FILTER_OP_GT:
+		case FILTER_OP_LT:
+		case FILTER_OP_GE:
+		case FILTER_OP_LE:
+			break;
+		default:
+			ERR("Unknown aggregate comparator %u\n",
+				(unsigned int) ref->cmp);
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+
+	/* sampling and rate limiting */
+	case FILTER_OP_SAMPLE:
+	{
+		struct sample_op *insn = (struct sample_op *) pc;
+
+		if (!insn->period) {
+			ERR("Sampling period is zero\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+	case FILTER_OP_RATE_LIMIT:
+	{
+		struct rate_limit_op *insn = (struct rate_limit_op *) pc;
+
+		if (!insn->rate || !insn->burst) {
+			ERR("Rate limit or burst is zero\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
 
 	/* load from immediate operand */
 	case FILTER_OP_LOAD_STRING:
+	case FILTER_OP_LOAD_STAR_GLOB_STRING:
 	{
 		break;
 	}
@@ -738,6 +936,7 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 			goto end;
 
 		case REG_STRING:
+		case REG_STAR_GLOB_STRING:
 			ERR("Cast op can only be applied to numeric or floating point registers\n");
 			ret = -EINVAL;
 			goto end;
@@ -768,6 +967,7 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 		goto end;
 	}
 	case FILTER_OP_GET_CONTEXT_REF_STRING:
+	case FILTER_OP_GET_CONTEXT_REF_PROCNAME:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 		struct field_ref *ref = (struct field_ref *) insn->data;
@@ -777,6 +977,9 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 		break;
 	}
 	case FILTER_OP_GET_CONTEXT_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_VTID:
+	case FILTER_OP_GET_CONTEXT_REF_VPID:
+	case FILTER_OP_GET_CONTEXT_REF_CPU_ID:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 		struct field_ref *ref = (struct field_ref *) insn->data;
@@ -940,6 +1143,8 @@ int exec_insn(struct bytecode_runtime *bytecode,
 	case FILTER_OP_LT_S64_DOUBLE:
 	case FILTER_OP_GE_S64_DOUBLE:
 	case FILTER_OP_LE_S64_DOUBLE:
+	case FILTER_OP_EQ_STAR_GLOB_STRING:
+	case FILTER_OP_NE_STAR_GLOB_STRING:
 	{
 		/* Pop 2, push 1 */
 		if (vstack_pop(stack)) {
@@ -1016,6 +1221,10 @@ int exec_insn(struct bytecode_runtime *bytecode,
 
 	/* load field ref */
 	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
 	{
 		ERR("Unknown field ref type\n");
 		ret = -EINVAL;
@@ -1028,9 +1237,64 @@ int exec_insn(struct bytecode_runtime *bytecode,
 		ret = -EINVAL;
 		goto end;
 	}
+	case FILTER_OP_LOAD_FIELD_REF_LEN_S64:
+	{
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64:
+	{
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct load_op) + sizeof(struct field_elem_ref);
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_ANY_S64:
+	case FILTER_OP_LOAD_FIELD_REF_ALL_S64:
+	{
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct load_op) + sizeof(struct field_aggr_ref);
+		break;
+	}
+
+	/* sampling and rate limiting */
+	case FILTER_OP_SAMPLE:
+	{
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct sample_op);
+		break;
+	}
+	case FILTER_OP_RATE_LIMIT:
+	{
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct rate_limit_op);
+		break;
+	}
 	case FILTER_OP_LOAD_FIELD_REF_STRING:
 	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
 	case FILTER_OP_GET_CONTEXT_REF_STRING:
+	case FILTER_OP_GET_CONTEXT_REF_PROCNAME:
 	{
 		if (vstack_push(stack)) {
 			ret = -EINVAL;
@@ -1042,6 +1306,9 @@ int exec_insn(struct bytecode_runtime *bytecode,
 	}
 	case FILTER_OP_LOAD_FIELD_REF_S64:
 	case FILTER_OP_GET_CONTEXT_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_VTID:
+	case FILTER_OP_GET_CONTEXT_REF_VPID:
+	case FILTER_OP_GET_CONTEXT_REF_CPU_ID:
 	{
 		if (vstack_push(stack)) {
 			ret = -EINVAL;
@@ -1077,6 +1344,19 @@ int exec_insn(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	{
+		struct load_op *insn = (struct load_op *) pc;
+
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_STAR_GLOB_STRING;
+		next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+		break;
+	}
+
 	case FILTER_OP_LOAD_S64:
 	{
 		if (vstack_push(stack)) {
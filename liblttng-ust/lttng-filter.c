@@ -22,6 +22,7 @@
 
 #include <urcu/rculist.h>
 #include "lttng-filter.h"
+#include "../libringbuffer/smp.h"
 
 static const char *opnames[] = {
 	[ FILTER_OP_UNKNOWN ] = "UNKNOWN",
@@ -124,16 +125,143 @@ static const char *opnames[] = {
 	[ FILTER_OP_GET_CONTEXT_REF_STRING ] = "GET_CONTEXT_REF_STRING",
 	[ FILTER_OP_GET_CONTEXT_REF_S64 ] = "GET_CONTEXT_REF_S64",
 	[ FILTER_OP_GET_CONTEXT_REF_DOUBLE ] = "GET_CONTEXT_REF_DOUBLE",
+
+	/* load userspace field ref */
+	[ FILTER_OP_LOAD_FIELD_REF_USER_STRING ] = "LOAD_FIELD_REF_USER_STRING",
+	[ FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE ] = "LOAD_FIELD_REF_USER_SEQUENCE",
+
+	[ FILTER_OP_LOAD_STAR_GLOB_STRING ] = "LOAD_STAR_GLOB_STRING",
+
+	/* star globbing pattern binary comparators */
+	[ FILTER_OP_EQ_STAR_GLOB_STRING ] = "EQ_STAR_GLOB_STRING",
+	[ FILTER_OP_NE_STAR_GLOB_STRING ] = "NE_STAR_GLOB_STRING",
+
+	[ FILTER_OP_LOAD_STRING_PLAIN ] = "LOAD_STRING_PLAIN",
+
+	/* get built-in context ref */
+	[ FILTER_OP_GET_CONTEXT_REF_VTID ] = "GET_CONTEXT_REF_VTID",
+	[ FILTER_OP_GET_CONTEXT_REF_VPID ] = "GET_CONTEXT_REF_VPID",
+	[ FILTER_OP_GET_CONTEXT_REF_CPU_ID ] = "GET_CONTEXT_REF_CPU_ID",
+	[ FILTER_OP_GET_CONTEXT_REF_PROCNAME ] = "GET_CONTEXT_REF_PROCNAME",
+
+	/* load array or sequence element, length or aggregate */
+	[ FILTER_OP_LOAD_FIELD_REF_ELEM ] = "LOAD_FIELD_REF_ELEM",
+	[ FILTER_OP_LOAD_FIELD_REF_LEN ] = "LOAD_FIELD_REF_LEN",
+	[ FILTER_OP_LOAD_FIELD_REF_ANY ] = "LOAD_FIELD_REF_ANY",
+	[ FILTER_OP_LOAD_FIELD_REF_ALL ] = "LOAD_FIELD_REF_ALL",
+	[ FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64 ] = "LOAD_FIELD_REF_ARRAY_ELEM_S64",
+	[ FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64 ] = "LOAD_FIELD_REF_SEQUENCE_ELEM_S64",
+	[ FILTER_OP_LOAD_FIELD_REF_LEN_S64 ] = "LOAD_FIELD_REF_LEN_S64",
+	[ FILTER_OP_LOAD_FIELD_REF_ANY_S64 ] = "LOAD_FIELD_REF_ANY_S64",
+	[ FILTER_OP_LOAD_FIELD_REF_ALL_S64 ] = "LOAD_FIELD_REF_ALL_S64",
+
+	/* sampling and rate limiting */
+	[ FILTER_OP_SAMPLE ] = "SAMPLE",
+	[ FILTER_OP_RATE_LIMIT ] = "RATE_LIMIT",
 };
 
 const char *print_op(enum filter_op op)
 {
-	if (op >= NR_FILTER_OPS)
+	if (op >= NR_FILTER_INTERNAL_OPS)
 		return "UNKNOWN";
 	else
 		return opnames[op];
 }
 
+/*
+ * Link an element, length or aggregate load of the integer array or
+ * sequence @field, found at @field_offset in the filter stack data.
+ */
+static
+int apply_elem_reloc(struct bytecode_runtime *runtime,
+		uint32_t runtime_len,
+		uint32_t reloc_offset,
+		const struct lttng_event_field *field,
+		uint32_t field_offset)
+{
+	const struct lttng_basic_type *elem_type;
+	const struct lttng_integer_type *integer;
+	struct field_elem_ref *elem_ref;
+	struct load_op *op;
+	size_t insn_len;
+
+	op = (struct load_op *) &runtime->data[reloc_offset];
+	switch (op->op) {
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+		insn_len = sizeof(struct load_op) + sizeof(struct field_ref);
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+		insn_len = sizeof(struct load_op) + sizeof(struct field_elem_ref);
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
+		insn_len = sizeof(struct load_op) + sizeof(struct field_aggr_ref);
+		break;
+	default:
+		return -EINVAL;
+	}
+	if (runtime_len - reloc_offset < insn_len)
+		return -EINVAL;
+
+	switch (field->type.atype) {
+	case atype_array:
+		elem_type = &field->type.u.array.elem_type;
+		break;
+	case atype_sequence:
+		elem_type = &field->type.u.sequence.elem_type;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (op->op == FILTER_OP_LOAD_FIELD_REF_LEN) {
+		struct field_ref *field_ref = (struct field_ref *) op->data;
+
+		op->op = FILTER_OP_LOAD_FIELD_REF_LEN_S64;
+		field_ref->offset = (uint16_t) field_offset;
+		return 0;
+	}
+
+	if (elem_type->atype != atype_integer)
+		return -EINVAL;
+	integer = &elem_type->u.basic.integer;
+	if (integer->reverse_byte_order)
+		return -EINVAL;
+	switch (integer->size) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return -EINVAL;
+	}
+	elem_ref = (struct field_elem_ref *) op->data;
+	elem_ref->offset = (uint16_t) field_offset;
+	elem_ref->elem_size = integer->size / CHAR_BIT;
+	elem_ref->elem_signed = integer->signedness;
+
+	switch (op->op) {
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+		if (field->type.atype == atype_array) {
+			/* Array length is fixed: prove the index here. */
+			if (elem_ref->index >= field->type.u.array.length)
+				return -EINVAL;
+			op->op = FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64;
+		} else {
+			op->op = FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64;
+		}
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+		op->op = FILTER_OP_LOAD_FIELD_REF_ANY_S64;
+		break;
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
+		op->op = FILTER_OP_LOAD_FIELD_REF_ALL_S64;
+		break;
+	}
+	return 0;
+}
+
 static
 int apply_field_reloc(struct lttng_event *event,
 		struct bytecode_runtime *runtime,
@@ -186,6 +314,7 @@ int apply_field_reloc(struct lttng_event *event,
 	}
 	if (!field)
 		return -EINVAL;
+	runtime->p.field_mask |= LTTNG_UST_FILTER_FIELD_BIT(i);
 
 	/* Check if field offset is too large for 16-bit offset */
 	if (field_offset > FILTER_BYTECODE_MAX_LEN - 1)
@@ -193,6 +322,9 @@ int apply_field_reloc(struct lttng_event *event,
 
 	/* set type */
 	op = (struct load_op *) &runtime->data[reloc_offset];
+	if (op->op != FILTER_OP_LOAD_FIELD_REF)
+		return apply_elem_reloc(runtime, runtime_len, reloc_offset,
+			field, field_offset);
 	field_ref = (struct field_ref *) op->data;
 	switch (field->type.atype) {
 	case atype_integer:
@@ -261,6 +393,15 @@ int apply_context_reloc(struct lttng_event *event,
 	default:
 		return -EINVAL;
 	}
+	/* Built-in contexts are read without calling get_value(). */
+	if (!strcmp(context_name, "vtid"))
+		op->op = FILTER_OP_GET_CONTEXT_REF_VTID;
+	else if (!strcmp(context_name, "vpid"))
+		op->op = FILTER_OP_GET_CONTEXT_REF_VPID;
+	else if (!strcmp(context_name, "cpu_id"))
+		op->op = FILTER_OP_GET_CONTEXT_REF_CPU_ID;
+	else if (!strcmp(context_name, "procname"))
+		op->op = FILTER_OP_GET_CONTEXT_REF_PROCNAME;
 	/* set offset to context index within channel contexts */
 	field_ref->offset = (uint16_t) idx;
 	return 0;
@@ -284,6 +425,10 @@ int apply_reloc(struct lttng_event *event,
 	op = (struct load_op *) &runtime->data[reloc_offset];
 	switch (op->op) {
 	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_ELEM:
+	case FILTER_OP_LOAD_FIELD_REF_LEN:
+	case FILTER_OP_LOAD_FIELD_REF_ANY:
+	case FILTER_OP_LOAD_FIELD_REF_ALL:
 		return apply_field_reloc(event, runtime, runtime_len,
 			reloc_offset, name);
 	case FILTER_OP_GET_CONTEXT_REF:
@@ -310,6 +455,38 @@ int bytecode_is_linked(struct lttng_ust_filter_bytecode_node *filter_bytecode,
 	return 0;
 }
 
+/*
+ * Allocate the per-cpu state of the sampling and rate limiting
+ * operators, which slots are assigned by the specializer.
+ */
+static
+int lttng_filter_sample_alloc(struct bytecode_runtime *runtime)
+{
+	size_t len;
+	void *state;
+
+	if (!runtime->nr_sample_slots)
+		return 0;
+	len = (size_t) runtime->nr_sample_slots * runtime->nr_cpus
+		* sizeof(struct filter_sample_state);
+	/* Each cpu updates its own cache line. */
+	if (posix_memalign(&state, CAA_CACHE_LINE_SIZE, len))
+		return -ENOMEM;
+	memset(state, 0, len);
+	runtime->sample_state = state;
+	return 0;
+}
+
+static
+filter_func_t lttng_filter_runtime_func(struct bytecode_runtime *runtime)
+{
+	if (runtime->stats)
+		return lttng_filter_profile;
+	if (runtime->jit_code)
+		return (filter_func_t) runtime->jit_code;
+	return lttng_filter_interpret_bytecode;
+}
+
 /*
  * Take a bytecode with reloc table and link it to an event to create a
  * bytecode runtime.
@@ -340,6 +517,9 @@ int _lttng_filter_event_link_bytecode(struct lttng_event *event,
 	}
 	runtime->p.bc = filter_bytecode;
 	runtime->len = filter_bytecode->bc.reloc_offset;
+	runtime->nr_cpus = num_possible_cpus();
+	if (runtime->nr_cpus <= 0)
+		runtime->nr_cpus = 1;
 	/* copy original bytecode */
 	memcpy(runtime->data, filter_bytecode->bc.data, runtime->len);
 	/*
@@ -370,7 +550,24 @@ int _lttng_filter_event_link_bytecode(struct lttng_event *event,
 	if (ret) {
 		goto link_error;
 	}
-	runtime->p.filter = lttng_filter_interpret_bytecode;
+	ret = lttng_filter_sample_alloc(runtime);
+	if (ret) {
+		goto link_error;
+	}
+	ret = lttng_filter_stats_alloc(runtime);
+	if (ret) {
+		goto link_error;
+	}
+	/* Optimize specialized bytecode */
+	ret = lttng_filter_optimize_bytecode(runtime);
+	if (ret) {
+		goto link_error;
+	}
+	/* Compile to native code, keep interpreting if not possible */
+	ret = lttng_filter_jit_compile(runtime);
+	if (ret)
+		dbg_printf("Filter not compiled (%d), interpreting.\n", ret);
+	runtime->p.filter = lttng_filter_runtime_func(runtime);
 	runtime->p.link_failed = 0;
 	cds_list_add_rcu(&runtime->p.node, insert_loc);
 	dbg_printf("Linking successful.\n");
@@ -385,14 +582,102 @@ alloc_error:
 	return ret;
 }
 
-void lttng_filter_sync_state(struct lttng_bytecode_runtime *runtime)
+static
+int lttng_filter_runtime_active(struct lttng_bytecode_runtime *runtime)
 {
-	struct lttng_ust_filter_bytecode_node *bc = runtime->bc;
+	return runtime->bc->enabler->enabled && !runtime->link_failed;
+}
 
-	if (!bc->enabler->enabled || runtime->link_failed)
-		runtime->filter = lttng_filter_false;
-	else
-		runtime->filter = lttng_filter_interpret_bytecode;
+/*
+ * Bytecode linked to the same event and identical once linked evaluates
+ * to the same result for any event payload.
+ */
+static
+int bytecode_runtime_equal(struct lttng_bytecode_runtime *a,
+		struct lttng_bytecode_runtime *b)
+{
+	struct bytecode_runtime *ra =
+		caa_container_of(a, struct bytecode_runtime, p);
+	struct bytecode_runtime *rb =
+		caa_container_of(b, struct bytecode_runtime, p);
+
+	/* Sampling decisions are independent for each filter. */
+	if (ra->nr_sample_slots || rb->nr_sample_slots)
+		return 0;
+	return ra->len == rb->len && !memcmp(ra->data, rb->data, ra->len);
+}
+
+/*
+ * An event is recorded if any of its filters records it, so only the
+ * first of the active runtimes having identical bytecode is evaluated.
+ */
+static
+filter_func_t lttng_filter_event_runtime_func(struct lttng_event *event,
+		struct lttng_bytecode_runtime *runtime)
+{
+	struct lttng_bytecode_runtime *iter;
+
+	if (!lttng_filter_runtime_active(runtime))
+		return lttng_filter_false;
+	cds_list_for_each_entry(iter, &event->bytecode_runtime_head, node) {
+		if (iter == runtime)
+			break;
+		if (lttng_filter_runtime_active(iter)
+				&& bytecode_runtime_equal(iter, runtime)) {
+			dbg_printf("Filter identical to an earlier filter of the event, not evaluated.\n");
+			return lttng_filter_false;
+		}
+	}
+	return lttng_filter_runtime_func(
+		caa_container_of(runtime, struct bytecode_runtime, p));
+}
+
+/*
+ * Sync the state of all filters of an event. Filters which get
+ * evaluated are installed before the others are turned off, so an
+ * event is never left without the evaluation of an active filter while
+ * a duplicate takes over.
+ */
+void lttng_filter_event_sync_state(struct lttng_event *event)
+{
+	struct lttng_bytecode_runtime *runtime;
+	filter_func_t func;
+
+	cds_list_for_each_entry(runtime, &event->bytecode_runtime_head, node) {
+		func = lttng_filter_event_runtime_func(event, runtime);
+		if (func != lttng_filter_false)
+			runtime->filter = func;
+	}
+	cds_list_for_each_entry(runtime, &event->bytecode_runtime_head, node) {
+		func = lttng_filter_event_runtime_func(event, runtime);
+		if (func == lttng_filter_false)
+			runtime->filter = func;
+	}
+}
+
+/*
+ * Sum the evaluations of the sampling and rate limiting operators of
+ * the event filters, and the ones which kept the event: the rate of
+ * the event before sampling is the recorded rate times seen / kept.
+ */
+void lttng_filter_event_sample_counts(struct lttng_event *event,
+		uint64_t *seen, uint64_t *kept)
+{
+	struct bytecode_runtime *runtime;
+	unsigned int i;
+
+	*seen = 0;
+	*kept = 0;
+	cds_list_for_each_entry(runtime, &event->bytecode_runtime_head,
+			p.node) {
+		/* Linking may have failed before the state was allocated. */
+		if (!runtime->sample_state)
+			continue;
+		for (i = 0; i < runtime->nr_sample_slots * runtime->nr_cpus; i++) {
+			*seen += CMM_LOAD_SHARED(runtime->sample_state[i].seen);
+			*kept += CMM_LOAD_SHARED(runtime->sample_state[i].kept);
+		}
+	}
 }
 
 /*
@@ -473,6 +758,9 @@ void lttng_free_event_filter_runtime(struct lttng_event *event)
 
 	cds_list_for_each_entry_safe(runtime, tmp,
 			&event->bytecode_runtime_head, p.node) {
+		lttng_filter_jit_free(runtime);
+		free(runtime->sample_state);
+		free(runtime->stats);
 		free(runtime);
 	}
 }
@@ -33,6 +33,7 @@
 #include <string.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <urcu/arch.h>
 #include <usterr-signal-safe.h>
 #include "filter-bytecode.h"
 
@@ -40,6 +41,9 @@
 #define FILTER_STACK_LEN	10	/* includes 2 dummy */
 #define FILTER_STACK_EMPTY	1
 
+/* Maximum number of elements compared by ANY/ALL */
+#define FILTER_AGGR_MAX_LEN	256
+
 #ifndef min_t
 #define min_t(type, a, b)	\
 		((type) (a) < (type) (b) ? (type) (a) : (type) (b))
@@ -67,9 +71,37 @@ do {								\
 } while (0)
 #endif
 
+/*
+ * Per-cpu state of a sampling or rate limiting operator. seen and kept
+ * count its evaluations, and the ones which kept the event.
+ */
+struct filter_sample_state {
+	unsigned long seen;
+	unsigned long kept;
+	uint64_t tat;		/* rate limit: theoretical arrival time (ns) */
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
+/*
+ * Per-cpu evaluation statistics of a filter, see
+ * struct lttng_ust_filter_stats_iter.
+ */
+struct filter_stats_cpu {
+	unsigned long evaluations;
+	unsigned long accepts;
+	unsigned long cycles[LTTNG_UST_FILTER_STATS_NR_BUCKETS];
+} __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
+
 /* Linked bytecode. Child of struct lttng_bytecode_runtime. */
 struct bytecode_runtime {
 	struct lttng_bytecode_runtime p;
+	void *jit_code;		/* native code, NULL if interpreted */
+	size_t jit_len;
+	/* sampling state, indexed by slot * nr_cpus + cpu */
+	struct filter_sample_state *sample_state;
+	/* evaluation statistics, indexed by cpu, NULL if not profiled */
+	struct filter_stats_cpu *stats;
+	int nr_cpus;
+	uint16_t nr_sample_slots;
 	uint16_t len;
 	char data[0];
 };
@@ -78,6 +110,7 @@ enum entry_type {
 	REG_S64,
 	REG_DOUBLE,
 	REG_STRING,
+	REG_STAR_GLOB_STRING,
 	REG_TYPE_UNKNOWN,
 };
 
@@ -145,6 +178,7 @@ struct estack_entry {
 			const char *str;
 			size_t seq_len;
 			int literal;		/* is string literal ? */
+			int star_glob;		/* is star globbing pattern ? */
 		} s;
 	} u;
 };
@@ -189,10 +223,30 @@ const char *print_op(enum filter_op op);
 
 int lttng_filter_validate_bytecode(struct bytecode_runtime *bytecode);
 int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode);
+int lttng_filter_optimize_bytecode(struct bytecode_runtime *bytecode);
+void lttng_filter_jit_init(void);
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode);
+void lttng_filter_jit_free(struct bytecode_runtime *bytecode);
 
-uint64_t lttng_filter_false(void *filter_data,
+typedef uint64_t (*filter_func_t)(void *filter_data,
 		const char *filter_stack_data);
+
+/*
+ * Compare strings bounded by their length or '\0', without wildcard
+ * nor escape. Selected by lttng_filter_string_init() according to the
+ * cpu features.
+ */
+extern int (*lttng_filter_strcmp_plain)(const char *p, size_t p_len,
+		const char *q, size_t q_len);
+void lttng_filter_string_init(void);
+int lttng_filter_star_glob_match(const char *pattern,
+		const char *candidate, size_t candidate_len);
+
 uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		const char *filter_stack_data);
 
+int lttng_filter_stats_alloc(struct bytecode_runtime *runtime);
+uint64_t lttng_filter_profile(void *filter_data,
+		const char *filter_stack_data);
+
 #endif /* _LTTNG_FILTER_H */
@@ -21,6 +21,7 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <urcu/list.h>
 #include <urcu/hlist.h>
@@ -52,6 +53,15 @@ static CDS_LIST_HEAD(lazy_probe_init);
  */
 static int lazy_nesting;
 
+/*
+ * Event descriptors of the registered probes sorted by name, so the
+ * events matching an enabler are found by binary search. Rebuilt on
+ * first use after the probe list changes. Protected by the ust mutex.
+ */
+static const struct lttng_event_desc **desc_index;
+static size_t desc_index_len;
+static int desc_index_valid;
+
 /*
  * Called under ust lock.
  */
@@ -111,6 +121,7 @@ void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
 	/* We should be added at the head of the list */
 	cds_list_add(&desc->head, probe_list);
 desc_added:
+	desc_index_valid = 0;
 	DBG("just registered probe %s containing %u events",
 		desc->provider, desc->nr_events);
 }
@@ -146,6 +157,106 @@ struct cds_list_head *lttng_get_probe_list_head(void)
 	return &_probe_list;
 }
 
+static
+int desc_name_cmp(const void *a, const void *b)
+{
+	const struct lttng_event_desc *da = *(const struct lttng_event_desc **) a;
+	const struct lttng_event_desc *db = *(const struct lttng_event_desc **) b;
+
+	return strcmp(da->name, db->name);
+}
+
+/*
+ * Called under ust lock.
+ */
+static
+int desc_index_update(void)
+{
+	struct lttng_probe_desc *probe_desc;
+	struct cds_list_head *probe_list;
+	const struct lttng_event_desc **index;
+	size_t len = 0;
+	int i;
+
+	probe_list = lttng_get_probe_list_head();
+	if (desc_index_valid)
+		return 0;
+	cds_list_for_each_entry(probe_desc, probe_list, head)
+		len += probe_desc->nr_events;
+	/* Allocate at least one entry: malloc(0) may return NULL. */
+	index = malloc((len ? len : 1) * sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+	len = 0;
+	cds_list_for_each_entry(probe_desc, probe_list, head) {
+		for (i = 0; i < probe_desc->nr_events; i++)
+			index[len++] = probe_desc->event_desc[i];
+	}
+	qsort(index, len, sizeof(*index), desc_name_cmp);
+	free(desc_index);
+	desc_index = index;
+	desc_index_len = len;
+	desc_index_valid = 1;
+	return 0;
+}
+
+/*
+ * Compare the name of @desc with @name, or with its first @len
+ * characters for prefix matches. Consistent with the index order.
+ */
+static
+int desc_name_match_cmp(const struct lttng_event_desc *desc,
+		const char *name, size_t len, int prefix)
+{
+	if (prefix)
+		return strncmp(desc->name, name, len);
+	return strcmp(desc->name, name);
+}
+
+/*
+ * Lookup the event descriptors named @name, or beginning with the first
+ * @len characters of @name if @prefix is set. On success, *descs points
+ * to the *nr matching descriptors, sorted by name, which stay valid
+ * until the probe list changes.
+ *
+ * Called under ust lock.
+ */
+int lttng_probes_match_desc(const char *name, size_t len, int prefix,
+		const struct lttng_event_desc ***descs, size_t *nr)
+{
+	size_t low, high, first;
+	int ret;
+
+	ret = desc_index_update();
+	if (ret)
+		return ret;
+	/* First descriptor not before the name. */
+	low = 0;
+	high = desc_index_len;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (desc_name_match_cmp(desc_index[mid], name, len, prefix) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	first = low;
+	/* First descriptor after the name. */
+	high = desc_index_len;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (desc_name_match_cmp(desc_index[mid], name, len, prefix) <= 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*descs = &desc_index[first];
+	*nr = low - first;
+	return 0;
+}
+
 static
 const struct lttng_probe_desc *find_provider(const char *provider)
 {
@@ -238,10 +349,12 @@ void lttng_probe_unregister(struct lttng_probe_desc *desc)
 		return;
 
 	ust_lock_nocheck();
-	if (!desc->lazy)
+	if (!desc->lazy) {
 		cds_list_del(&desc->head);
-	else
+		desc_index_valid = 0;
+	} else {
 		cds_list_del(&desc->lazy_init_head);
+	}
 	DBG("just unregistered probe %s", desc->provider);
 	ust_unlock();
 }
@@ -0,0 +1,36 @@
+/*
+ * lttng-ring-buffer-client-discard-pt.c
+ *
+ * LTTng lib ring buffer client (discard mode, per-thread buffers).
+ *
+ * Copyright (C) 2010-2012 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include "lttng-tracer.h"
+
+#define RING_BUFFER_MODE_TEMPLATE		RING_BUFFER_DISCARD
+#define RING_BUFFER_MODE_TEMPLATE_STRING	"discard-pt"
+#define RING_BUFFER_MODE_TEMPLATE_INIT	\
+	lttng_ring_buffer_client_discard_pt_init
+#define RING_BUFFER_MODE_TEMPLATE_EXIT	\
+	lttng_ring_buffer_client_discard_pt_exit
+#define LTTNG_CLIENT_TYPE			LTTNG_CLIENT_DISCARD_PT
+#define LTTNG_CLIENT_CALLBACKS			lttng_client_callbacks_discard_pt
+#define LTTNG_CLIENT_WAKEUP			RING_BUFFER_WAKEUP_BY_WRITER
+#define LTTNG_CLIENT_ALLOC			RING_BUFFER_ALLOC_PER_THREAD
+#include "lttng-ring-buffer-client.h"
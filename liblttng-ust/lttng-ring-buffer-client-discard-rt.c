@@ -32,4 +32,5 @@
 #define LTTNG_CLIENT_TYPE			LTTNG_CLIENT_DISCARD_RT
 #define LTTNG_CLIENT_CALLBACKS			lttng_client_callbacks_discard_rt
 #define LTTNG_CLIENT_WAKEUP			RING_BUFFER_WAKEUP_BY_TIMER
+#define LTTNG_CLIENT_ALLOC			RING_BUFFER_ALLOC_PER_CPU
 #include "lttng-ring-buffer-client.h"
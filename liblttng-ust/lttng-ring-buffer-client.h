@@ -97,26 +97,20 @@ void ctx_record(struct lttng_ust_lib_ring_buffer_ctx *bufctx,
 }
 
 /*
- * record_header_size - Calculate the header size and padding necessary.
- * @config: ring buffer instance configuration
- * @chan: channel
+ * event_header_size - Calculate the header size and padding of one event.
+ * @lttng_chan: channel
  * @offset: offset in the write buffer
  * @pre_header_padding: padding to add before the header (output)
- * @ctx: reservation context
+ * @rflags: reservation flags
+ * @event: event
  *
  * Returns the event header size (including padding).
- *
- * The payload must itself determine its own alignment from the biggest type it
- * contains.
  */
 static __inline__
-unsigned char record_header_size(const struct lttng_ust_lib_ring_buffer_config *config,
-				 struct channel *chan, size_t offset,
-				 size_t *pre_header_padding,
-				 struct lttng_ust_lib_ring_buffer_ctx *ctx)
+size_t event_header_size(struct lttng_channel *lttng_chan, size_t offset,
+			 size_t *pre_header_padding, unsigned int rflags,
+			 struct lttng_event *event)
 {
-	struct lttng_channel *lttng_chan = channel_get_private(chan);
-	struct lttng_event *event = ctx->priv;
 	size_t orig_offset = offset;
 	size_t padding;
 
@@ -124,7 +118,7 @@ unsigned char record_header_size(const struct lttng_ust_lib_ring_buffer_config *
 	case 1:	/* compact */
 		padding = lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
 		offset += padding;
-		if (!(ctx->rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED))) {
+		if (!(rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED))) {
 			offset += sizeof(uint32_t);	/* id and timestamp */
 		} else {
 			/* Minimum space taken by LTTNG_COMPACT_EVENT_BITS id */
@@ -140,7 +134,7 @@ unsigned char record_header_size(const struct lttng_ust_lib_ring_buffer_config *
 		padding = lib_ring_buffer_align(offset, lttng_alignof(uint16_t));
 		offset += padding;
 		offset += sizeof(uint16_t);
-		if (!(ctx->rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED))) {
+		if (!(rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED))) {
 			offset += lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
 			offset += sizeof(uint32_t);	/* timestamp */
 		} else {
@@ -162,6 +156,76 @@ unsigned char record_header_size(const struct lttng_ust_lib_ring_buffer_config *
 	return offset - orig_offset;
 }
 
+/*
+ * batch_header_size - Calculate the size of a batch of records.
+ *
+ * Covers all the records of the batch written to this channel, except
+ * the payload of the last one, which the ring buffer frontend adds from
+ * ctx->data_size and ctx->largest_align. Only the first record may need
+ * a full timestamp: the following ones share its timestamp.
+ */
+static
+size_t batch_header_size(struct lttng_channel *lttng_chan, size_t offset,
+			 size_t *pre_header_padding,
+			 struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	struct lttng_ust_batch *batch = ctx->priv;
+	struct lttng_ust_batch_record *prev = NULL;
+	size_t orig_offset = offset;
+	size_t padding;
+	unsigned int i;
+
+	for (i = batch->first; i < batch->nr_records; i++) {
+		struct lttng_ust_batch_record *rec = &batch->records[i];
+
+		if (rec->chan != lttng_chan)
+			continue;
+		if (!prev) {
+			offset += event_header_size(lttng_chan, offset,
+					pre_header_padding,
+					(ctx->rflags & RING_BUFFER_RFLAG_FULL_TSC)
+						| rec->rflags,
+					rec->event);
+		} else {
+			offset += lib_ring_buffer_align(offset,
+					prev->largest_align);
+			offset += prev->data_size;
+			offset += event_header_size(lttng_chan, offset,
+					&padding, rec->rflags, rec->event);
+		}
+		prev = rec;
+	}
+	return offset - orig_offset;
+}
+
+/*
+ * record_header_size - Calculate the header size and padding necessary.
+ * @config: ring buffer instance configuration
+ * @chan: channel
+ * @offset: offset in the write buffer
+ * @pre_header_padding: padding to add before the header (output)
+ * @ctx: reservation context
+ *
+ * Returns the event header size (including padding).
+ *
+ * The payload must itself determine its own alignment from the biggest type it
+ * contains.
+ */
+static __inline__
+size_t record_header_size(const struct lttng_ust_lib_ring_buffer_config *config,
+				 struct channel *chan, size_t offset,
+				 size_t *pre_header_padding,
+				 struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(chan);
+
+	if (caa_unlikely(ctx->rflags & LTTNG_RFLAG_BATCH))
+		return batch_header_size(lttng_chan, offset,
+				pre_header_padding, ctx);
+	return event_header_size(lttng_chan, offset, pre_header_padding,
+			ctx->rflags, ctx->priv);
+}
+
 #include "../libringbuffer/api.h"
 #include "lttng-rb-clients.h"
 
@@ -538,7 +602,7 @@ static const struct lttng_ust_lib_ring_buffer_config client_config = {
 	.cb.packet_size_field = client_packet_size_field,
 
 	.tsc_bits = LTTNG_COMPACT_TSC_BITS,
-	.alloc = RING_BUFFER_ALLOC_PER_CPU,
+	.alloc = LTTNG_CLIENT_ALLOC,
 	.sync = RING_BUFFER_SYNC_GLOBAL,
 	.mode = RING_BUFFER_MODE_TEMPLATE,
 	.backend = RING_BUFFER_PAGE,
@@ -561,7 +625,8 @@ struct lttng_channel *_channel_create(const char *name,
 				unsigned int read_timer_interval,
 				unsigned char *uuid,
 				uint32_t chan_id,
-				const int *stream_fds, int nr_stream_fds)
+				const int *stream_fds, int nr_stream_fds,
+				const struct lttng_ust_shm_attr *shm_attr)
 {
 	struct lttng_channel chan_priv_init;
 	struct lttng_ust_shm_handle *handle;
@@ -577,7 +642,7 @@ struct lttng_channel *_channel_create(const char *name,
 			&chan_priv_init,
 			buf_addr, subbuf_size, num_subbuf,
 			switch_timer_interval, read_timer_interval,
-			stream_fds, nr_stream_fds);
+			stream_fds, nr_stream_fds, shm_attr);
 	if (!handle)
 		return NULL;
 	lttng_chan = priv;
@@ -599,11 +664,6 @@ int lttng_event_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
 	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
 	int ret, cpu;
 
-	cpu = lib_ring_buffer_get_cpu(&client_config);
-	if (cpu < 0)
-		return -EPERM;
-	ctx->cpu = cpu;
-
 	switch (lttng_chan->header_type) {
 	case 1:	/* compact */
 		if (event_id > 30)
@@ -617,6 +677,15 @@ int lttng_event_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
 		WARN_ON_ONCE(1);
 	}
 
+	if (caa_unlikely(lttng_ust_batch_active())
+			&& !lttng_ust_batch_reserve(ctx, event_id))
+		return 0;
+
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (cpu < 0)
+		return -EPERM;
+	ctx->cpu = cpu;
+
 	ret = lib_ring_buffer_reserve(&client_config, ctx);
 	if (ret)
 		goto put;
@@ -630,6 +699,10 @@ put:
 static
 void lttng_event_commit(struct lttng_ust_lib_ring_buffer_ctx *ctx)
 {
+	if (caa_unlikely(ctx->rflags & LTTNG_RFLAG_STAGED)) {
+		lttng_ust_batch_commit(ctx);
+		return;
+	}
 	lib_ring_buffer_commit(&client_config, ctx);
 	lib_ring_buffer_put_cpu(&client_config);
 }
@@ -638,6 +711,10 @@ static
 void lttng_event_write(struct lttng_ust_lib_ring_buffer_ctx *ctx, const void *src,
 		     size_t len)
 {
+	if (caa_unlikely(ctx->rflags & LTTNG_RFLAG_STAGED)) {
+		lttng_ust_batch_write(ctx, src, len);
+		return;
+	}
 	lib_ring_buffer_write(&client_config, ctx, src, len);
 }
 
@@ -645,9 +722,88 @@ static
 void lttng_event_strcpy(struct lttng_ust_lib_ring_buffer_ctx *ctx, const char *src,
 		     size_t len)
 {
+	if (caa_unlikely(ctx->rflags & LTTNG_RFLAG_STAGED)) {
+		lttng_ust_batch_strcpy(ctx, src, len, '#');
+		return;
+	}
 	lib_ring_buffer_strcpy(&client_config, ctx, src, len, '#');
 }
 
+/*
+ * Reserve space for all the records of @batch written to this channel,
+ * and write them. They share the timestamp of the reservation.
+ */
+static
+int lttng_event_reserve_batch(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_ust_batch *batch)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
+	struct lttng_ust_batch_record *rec;
+	unsigned int i, rflags;
+	size_t padding;
+	int ret, cpu;
+
+	/* The frontend accounts for the payload of the last record. */
+	for (i = batch->first; i < batch->nr_records; i++) {
+		rec = &batch->records[i];
+		if (rec->chan != lttng_chan)
+			continue;
+		ctx->data_size = rec->data_size;
+		ctx->largest_align = rec->largest_align;
+	}
+
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (cpu < 0)
+		return -EPERM;
+	ctx->cpu = cpu;
+	ctx->priv = batch;
+	ctx->rflags |= LTTNG_RFLAG_BATCH;
+
+	ret = lib_ring_buffer_reserve(&client_config, ctx);
+	if (ret)
+		goto put;
+	rflags = ctx->rflags & RING_BUFFER_RFLAG_FULL_TSC;
+	for (i = batch->first; i < batch->nr_records; i++) {
+		rec = &batch->records[i];
+		if (rec->chan != lttng_chan)
+			continue;
+		/* The frontend aligns the first header. */
+		if (i != batch->first) {
+			event_header_size(lttng_chan, ctx->buf_offset,
+					&padding, rec->rflags, rec->event);
+			ctx->buf_offset += padding;
+		}
+		ctx->priv = rec->event;
+		ctx->ip = rec->ip;
+		ctx->largest_align = rec->largest_align;
+		ctx->rflags = rflags | rec->rflags;
+		lttng_write_event_header(&client_config, ctx, rec->event_id);
+		lib_ring_buffer_write(&client_config, ctx,
+				batch->buf + rec->offset, rec->data_size);
+		rflags = 0;
+	}
+	return 0;
+put:
+	lib_ring_buffer_put_cpu(&client_config);
+	return ret;
+}
+
+static
+void lttng_event_commit_batch(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		struct lttng_ust_batch *batch)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
+	unsigned long nr_records = 0;
+	unsigned int i;
+
+	for (i = batch->first; i < batch->nr_records; i++) {
+		if (batch->records[i].chan == lttng_chan)
+			nr_records++;
+	}
+	lib_ring_buffer_commit_batch(&client_config, ctx, nr_records);
+	lib_ring_buffer_put_cpu(&client_config);
+}
+
 #if 0
 static
 wait_queue_head_t *lttng_get_reader_wait_queue(struct channel *chan)
@@ -680,7 +836,7 @@ int lttng_flush_buffer(struct channel *chan, struct lttng_ust_shm_handle *handle
 	struct lttng_ust_lib_ring_buffer *buf;
 	int cpu;
 
-	for_each_channel_cpu(cpu, chan) {
+	for_each_channel_stream(cpu, chan) {
 		int shm_fd, wait_fd, wakeup_fd;
 		uint64_t memory_map_size;
 
@@ -699,6 +855,8 @@ static struct lttng_transport lttng_relay_transport = {
 		.channel_create = _channel_create,
 		.channel_destroy = lttng_channel_destroy,
 		.u.has_strcpy = 1,
+		.u.has_filter_field_mask = 1,
+		.u.has_static_filter = 1,
 		.event_reserve = lttng_event_reserve,
 		.event_commit = lttng_event_commit,
 		.event_write = lttng_event_write,
@@ -709,6 +867,8 @@ static struct lttng_transport lttng_relay_transport = {
 		.is_disabled = lttng_is_disabled,
 		.flush_buffer = lttng_flush_buffer,
 		.event_strcpy = lttng_event_strcpy,
+		.event_reserve_batch = lttng_event_reserve_batch,
+		.event_commit_batch = lttng_event_commit_batch,
 	},
 	.client_config = &client_config,
 };
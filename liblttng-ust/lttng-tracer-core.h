@@ -23,12 +23,16 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/types.h>
 #include <urcu/arch.h>
+#include <urcu/compiler.h>
 #include <urcu/list.h>
+#include <urcu/tls-compat.h>
 #include <lttng/ust-tracer.h>
 #include <lttng/bug.h>
 #include <lttng/ringbuffer-config.h>
 #include <usterr-signal-safe.h>
+#include "compat.h"
 
 struct lttng_session;
 struct lttng_channel;
@@ -41,6 +45,7 @@ void ust_unlock(void);
 void lttng_fixup_event_tls(void);
 void lttng_fixup_vtid_tls(void);
 void lttng_fixup_procname_tls(void);
+void lttng_fixup_batch_tls(void);
 
 const char *lttng_ust_obj_get_name(int id);
 
@@ -52,4 +57,93 @@ void lttng_ust_malloc_wrapper_init(void);
 
 ssize_t lttng_ust_read(int fd, void *buf, size_t len);
 
+/*
+ * Per-thread caches of the vtid and procname contexts, also read
+ * directly by the filter interpreter.
+ */
+typedef char lttng_procname_array[LTTNG_UST_PROCNAME_LEN];
+
+extern DECLARE_URCU_TLS(pid_t, lttng_cached_vtid);
+extern DECLARE_URCU_TLS(lttng_procname_array, lttng_cached_procname);
+
+pid_t lttng_context_vtid_fill(void);
+void lttng_context_procname_fill(void);
+pid_t lttng_context_vpid_get(void);
+
+static inline
+pid_t lttng_context_vtid_get(void)
+{
+	pid_t vtid = URCU_TLS(lttng_cached_vtid);
+
+	if (caa_unlikely(!vtid))
+		vtid = lttng_context_vtid_fill();
+	return vtid;
+}
+
+static inline
+char *lttng_context_procname_get(void)
+{
+	if (caa_unlikely(!URCU_TLS(lttng_cached_procname)[0]))
+		lttng_context_procname_fill();
+	return URCU_TLS(lttng_cached_procname);
+}
+
+/*
+ * Records emitted by a thread within tracepoint_batch() are staged in a
+ * per-thread area, and written with one ring buffer reservation per
+ * channel when the batch ends or when the staging area is full.
+ */
+#define LTTNG_UST_BATCH_MAX_RECORDS	32
+#define LTTNG_UST_BATCH_BUF_SIZE	2048
+
+struct lttng_ust_batch_record {
+	struct lttng_event *event;
+	struct lttng_channel *chan;	/* NULL once written */
+	void *ip;			/* caller ip address */
+	uint32_t event_id;
+	unsigned int rflags;		/* client reservation flags */
+	uint32_t offset;		/* payload offset in staging area */
+	uint32_t data_size;		/* payload size */
+	int largest_align;		/* largest payload alignment */
+};
+
+struct lttng_ust_batch {
+	unsigned int nesting;		/* tracepoint_batch() nesting */
+	int busy;			/* record being staged, or flush */
+	unsigned int nr_records;	/* staged records */
+	unsigned int first;		/* first record of the channel flushed */
+	size_t buf_offset;		/* staging area write offset */
+	struct lttng_ust_batch_record records[LTTNG_UST_BATCH_MAX_RECORDS];
+	char buf[LTTNG_UST_BATCH_BUF_SIZE];
+};
+
+extern DECLARE_URCU_TLS(struct lttng_ust_batch, lttng_ust_batch);
+
+static inline
+int lttng_ust_batch_active(void)
+{
+	return URCU_TLS(lttng_ust_batch).nesting;
+}
+
+int lttng_ust_batch_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		uint32_t event_id);
+void lttng_ust_batch_commit(struct lttng_ust_lib_ring_buffer_ctx *ctx);
+void lttng_ust_batch_write(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const void *src, size_t len);
+void lttng_ust_batch_strcpy(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const char *src, size_t len, int pad);
+void lttng_ust_batch_init(void);
+void lttng_ust_batch_exit(void);
+
+/*
+ * With LTTNG_UST_EARLY_BUFFER_SIZE set, the constructor does not wait
+ * for the session daemons: the events hit until registration completes
+ * are recorded in a process-local buffer, and written into the sessions
+ * enabled meanwhile.
+ */
+int lttng_ust_early_init(void);
+void lttng_ust_early_replay(struct lttng_session *session);
+void lttng_ust_early_exit(void);
+int lttng_ust_is_early_session(struct lttng_session *session);
+
 #endif /* _LTTNG_TRACER_CORE_H */
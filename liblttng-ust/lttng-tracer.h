@@ -44,6 +44,8 @@
 #define LTTNG_METADATA_TIMEOUT_MSEC	10000
 
 #define LTTNG_RFLAG_EXTENDED		RING_BUFFER_RFLAG_END
-#define LTTNG_RFLAG_END			(LTTNG_RFLAG_EXTENDED << 1)
+#define LTTNG_RFLAG_BATCH		(LTTNG_RFLAG_EXTENDED << 1)	/* priv is a batch */
+#define LTTNG_RFLAG_STAGED		(LTTNG_RFLAG_EXTENDED << 2)	/* record staged in batch */
+#define LTTNG_RFLAG_END			(LTTNG_RFLAG_EXTENDED << 3)
 
 #endif /* _LTTNG_TRACER_H */
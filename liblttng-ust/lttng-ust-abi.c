@@ -59,6 +59,8 @@ static
 int lttng_abi_tracepoint_list(void *owner);
 static
 int lttng_abi_tracepoint_field_list(void *owner);
+static
+int lttng_abi_filter_stats_list(void *owner);
 
 /*
  * Object descriptor table. Should be protected from concurrent access
@@ -277,6 +279,7 @@ static const struct lttng_ust_objd_ops lttng_channel_ops;
 static const struct lttng_ust_objd_ops lttng_enabler_ops;
 static const struct lttng_ust_objd_ops lttng_tracepoint_list_ops;
 static const struct lttng_ust_objd_ops lttng_tracepoint_field_list_ops;
+static const struct lttng_ust_objd_ops lttng_filter_stats_list_ops;
 
 int lttng_abi_create_root_handle(void)
 {
@@ -358,6 +361,8 @@ long lttng_abi_add_context(int objd,
  *		Returns a file descriptor listing available tracepoints
  *	LTTNG_UST_TRACEPOINT_FIELD_LIST
  *		Returns a file descriptor listing available tracepoint fields
+ *	LTTNG_UST_FILTER_STATS_LIST
+ *		Returns a file descriptor listing the filter statistics of events
  *	LTTNG_UST_WAIT_QUIESCENT
  *		Returns after all previously running probes have completed
  *
@@ -377,6 +382,8 @@ long lttng_cmd(int objd, unsigned int cmd, unsigned long arg,
 		return lttng_abi_tracepoint_list(owner);
 	case LTTNG_UST_TRACEPOINT_FIELD_LIST:
 		return lttng_abi_tracepoint_field_list(owner);
+	case LTTNG_UST_FILTER_STATS_LIST:
+		return lttng_abi_filter_stats_list(owner);
 	case LTTNG_UST_WAIT_QUIESCENT:
 		synchronize_trace();
 		return 0;
@@ -416,6 +423,7 @@ int lttng_abi_map_channel(int session_objd,
 
 	switch (type) {
 	case LTTNG_UST_CHAN_PER_CPU:
+	case LTTNG_UST_CHAN_PER_THREAD:
 		break;
 	default:
 		ret = -EINVAL;
@@ -466,6 +474,18 @@ int lttng_abi_map_channel(int session_objd,
 		}
 		chan_name = "channel";
 		break;
+	case LTTNG_UST_CHAN_PER_THREAD:
+		if (config->output != RING_BUFFER_MMAP
+				|| config->alloc != RING_BUFFER_ALLOC_PER_THREAD) {
+			ret = -EINVAL;
+			goto notransport;
+		}
+		if (config->mode == RING_BUFFER_OVERWRITE)
+			transport_name = "relay-overwrite-pt-mmap";
+		else
+			transport_name = "relay-discard-pt-mmap";
+		chan_name = "channel";
+		break;
 	default:
 		ret = -EINVAL;
 		goto notransport;
@@ -763,6 +783,87 @@ static const struct lttng_ust_objd_ops lttng_tracepoint_field_list_ops = {
 	.cmd = lttng_tracepoint_field_list_cmd,
 };
 
+static
+long lttng_filter_stats_list_cmd(int objd, unsigned int cmd,
+	unsigned long arg, union ust_args *uargs, void *owner)
+{
+	struct lttng_ust_filter_stats_list *list = objd_private(objd);
+	struct lttng_ust_filter_stats_iter *stats =
+		&uargs->filter_stats_list.entry;
+	struct lttng_ust_filter_stats_iter *iter;
+
+	switch (cmd) {
+	case LTTNG_UST_FILTER_STATS_LIST_GET:
+	{
+		iter = lttng_ust_filter_stats_list_get_iter_next(list);
+		if (!iter)
+			return -LTTNG_UST_ERR_NOENT;
+		memcpy(stats, iter, sizeof(*stats));
+		return 0;
+	}
+	default:
+		return -EINVAL;
+	}
+}
+
+static
+int lttng_abi_filter_stats_list(void *owner)
+{
+	int list_objd, ret;
+	struct lttng_ust_filter_stats_list *list;
+
+	list_objd = objd_alloc(NULL, &lttng_filter_stats_list_ops, owner,
+			"filter_stats_list");
+	if (list_objd < 0) {
+		ret = list_objd;
+		goto objd_error;
+	}
+	list = zmalloc(sizeof(*list));
+	if (!list) {
+		ret = -ENOMEM;
+		goto alloc_error;
+	}
+	objd_set_private(list_objd, list);
+
+	/* snapshot the statistics of all events. */
+	ret = lttng_filter_get_stats_list(list);
+	if (ret) {
+		goto list_error;
+	}
+	return list_objd;
+
+list_error:
+	free(list);
+alloc_error:
+	{
+		int err;
+
+		err = lttng_ust_objd_unref(list_objd, 1);
+		assert(!err);
+	}
+objd_error:
+	return ret;
+}
+
+static
+int lttng_release_filter_stats_list(int objd)
+{
+	struct lttng_ust_filter_stats_list *list = objd_private(objd);
+
+	if (list) {
+		lttng_filter_prune_stats_list(list);
+		free(list);
+		return 0;
+	} else {
+		return -EINVAL;
+	}
+}
+
+static const struct lttng_ust_objd_ops lttng_filter_stats_list_ops = {
+	.release = lttng_release_filter_stats_list,
+	.cmd = lttng_filter_stats_list_cmd,
+};
+
 static
 int lttng_abi_map_stream(int channel_objd, struct lttng_ust_stream *info,
 		union ust_args *uargs, void *owner)
@@ -934,6 +1035,11 @@ static const struct lttng_ust_objd_ops lttng_channel_ops = {
  *		Attach a filter to an enabler.
  *	LTTNG_UST_EXCLUSION
  *		Attach exclusions to an enabler.
+ *	LTTNG_UST_STATIC_FILTER
+ *		Evaluate the static filters of the events of an enabler.
+ *	LTTNG_UST_CLEAR_STATIC_FILTER
+ *		Stop evaluating the static filters of the events of an
+ *		enabler.
  */
 static
 long lttng_enabler_cmd(int objd, unsigned int cmd, unsigned long arg,
@@ -964,6 +1070,10 @@ long lttng_enabler_cmd(int objd, unsigned int cmd, unsigned long arg,
 		return lttng_enabler_attach_exclusion(enabler,
 				(struct lttng_ust_excluder_node *) arg);
 	}
+	case LTTNG_UST_STATIC_FILTER:
+		return lttng_enabler_attach_static_filter(enabler);
+	case LTTNG_UST_CLEAR_STATIC_FILTER:
+		return lttng_enabler_clear_static_filter(enabler);
 	default:
 		return -EINVAL;
 	}
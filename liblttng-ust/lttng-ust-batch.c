@@ -0,0 +1,228 @@
+/*
+ * lttng-ust-batch.c
+ *
+ * LTTng UST batched event records, staged per thread within
+ * tracepoint_batch() and written with one reservation per channel.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <urcu/compiler.h>
+#include <urcu/tls-compat.h>
+#include <lttng/ust-events.h>
+#include <lttng/ringbuffer-config.h>
+
+#include "lttng-tracer.h"
+#include "tracepoint-internal.h"
+
+DEFINE_URCU_TLS(struct lttng_ust_batch, lttng_ust_batch);
+
+/*
+ * Force a read (imply TLS fixup for dlopen) of TLS variables.
+ */
+void lttng_fixup_batch_tls(void)
+{
+	asm volatile ("" : : "m" (URCU_TLS(lttng_ust_batch)));
+}
+
+/*
+ * Fallback used when the batch reservation fails: emit each record with
+ * its own reservation, so lost records are accounted for one by one.
+ */
+static
+void lttng_ust_batch_write_records(struct lttng_channel *chan,
+		struct lttng_ust_batch *batch)
+{
+	unsigned int i;
+
+	for (i = batch->first; i < batch->nr_records; i++) {
+		struct lttng_ust_batch_record *rec = &batch->records[i];
+		struct lttng_ust_lib_ring_buffer_ctx ctx;
+
+		if (rec->chan != chan)
+			continue;
+		lib_ring_buffer_ctx_init(&ctx, chan->chan, rec->event,
+				rec->data_size, rec->largest_align, -1,
+				chan->handle);
+		ctx.ip = rec->ip;
+		if (chan->ops->event_reserve(&ctx, rec->event_id))
+			continue;
+		chan->ops->event_write(&ctx, batch->buf + rec->offset,
+				rec->data_size);
+		chan->ops->event_commit(&ctx);
+	}
+}
+
+/*
+ * Write the staged records, with one reservation per channel. Called
+ * within the RCU read-side critical section taken by tp_batch_begin(),
+ * which keeps the staged events and their channels alive.
+ */
+static
+void lttng_ust_batch_flush(struct lttng_ust_batch *batch)
+{
+	unsigned int i, j;
+
+	batch->busy = 1;
+	cmm_barrier();
+	for (i = 0; i < batch->nr_records; i++) {
+		struct lttng_channel *chan = batch->records[i].chan;
+		struct lttng_ust_lib_ring_buffer_ctx ctx;
+
+		if (!chan)
+			continue;
+		batch->first = i;
+		lib_ring_buffer_ctx_init(&ctx, chan->chan, batch, 0, 1, -1,
+				chan->handle);
+		if (!chan->ops->event_reserve_batch(&ctx, batch))
+			chan->ops->event_commit_batch(&ctx, batch);
+		else
+			lttng_ust_batch_write_records(chan, batch);
+		for (j = i; j < batch->nr_records; j++) {
+			if (batch->records[j].chan == chan)
+				batch->records[j].chan = NULL;
+		}
+	}
+	batch->nr_records = 0;
+	batch->buf_offset = 0;
+	cmm_barrier();
+	batch->busy = 0;
+}
+
+/*
+ * Stage the record described by @ctx instead of reserving ring buffer
+ * space for it. Returns 0 on success, a negative error value if the
+ * record must be written directly.
+ */
+int lttng_ust_batch_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		uint32_t event_id)
+{
+	struct lttng_ust_batch *batch = &URCU_TLS(lttng_ust_batch);
+	struct lttng_event *event = ctx->priv;
+	struct lttng_ust_batch_record *rec;
+	size_t offset;
+
+	/* Nested in a signal handler while staging or flushing. */
+	if (batch->busy)
+		return -EBUSY;
+	if (ctx->data_size > LTTNG_UST_BATCH_BUF_SIZE)
+		return -ENOSPC;
+	offset = batch->buf_offset;
+	offset += lib_ring_buffer_align(offset, ctx->largest_align);
+	if (batch->nr_records == LTTNG_UST_BATCH_MAX_RECORDS
+			|| offset + ctx->data_size > LTTNG_UST_BATCH_BUF_SIZE) {
+		lttng_ust_batch_flush(batch);
+		offset = 0;
+	}
+	batch->busy = 1;
+	cmm_barrier();
+	rec = &batch->records[batch->nr_records];
+	rec->event = event;
+	rec->chan = event->chan;
+	rec->ip = ctx->ip;
+	rec->event_id = event_id;
+	rec->rflags = ctx->rflags;
+	rec->offset = offset;
+	rec->data_size = ctx->data_size;
+	rec->largest_align = ctx->largest_align;
+	ctx->buf_offset = offset;
+	ctx->rflags |= LTTNG_RFLAG_STAGED;
+	return 0;
+}
+
+void lttng_ust_batch_commit(struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	struct lttng_ust_batch *batch = &URCU_TLS(lttng_ust_batch);
+	struct lttng_ust_batch_record *rec = &batch->records[batch->nr_records];
+
+	/* The probe writes exactly the payload size it reserved. */
+	if (caa_likely(ctx->buf_offset == rec->offset + rec->data_size)) {
+		batch->buf_offset = ctx->buf_offset;
+		batch->nr_records++;
+	} else {
+		WARN_ON_ONCE(1);
+	}
+	cmm_barrier();
+	batch->busy = 0;
+}
+
+void lttng_ust_batch_write(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const void *src, size_t len)
+{
+	struct lttng_ust_batch *batch = &URCU_TLS(lttng_ust_batch);
+
+	if (caa_likely(ctx->buf_offset + len <= LTTNG_UST_BATCH_BUF_SIZE))
+		memcpy(batch->buf + ctx->buf_offset, src, len);
+	ctx->buf_offset += len;
+}
+
+/*
+ * Same layout as lib_ring_buffer_strcpy(): @len - 1 bytes of string,
+ * padded with @pad if shorter, followed by a terminating '\0'.
+ */
+void lttng_ust_batch_strcpy(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const char *src, size_t len, int pad)
+{
+	struct lttng_ust_batch *batch = &URCU_TLS(lttng_ust_batch);
+	size_t count;
+	char *dest;
+
+	if (caa_unlikely(!len))
+		return;
+	if (caa_unlikely(ctx->buf_offset + len > LTTNG_UST_BATCH_BUF_SIZE)) {
+		ctx->buf_offset += len;
+		return;
+	}
+	dest = batch->buf + ctx->buf_offset;
+	for (count = 0; count < len - 1 && src[count] != '\0'; count++)
+		dest[count] = src[count];
+	memset(dest + count, pad, len - 1 - count);
+	dest[len - 1] = '\0';
+	ctx->buf_offset += len;
+}
+
+static
+void lttng_ust_batch_begin(void)
+{
+	URCU_TLS(lttng_ust_batch).nesting++;
+}
+
+static
+void lttng_ust_batch_end(void)
+{
+	struct lttng_ust_batch *batch = &URCU_TLS(lttng_ust_batch);
+
+	/* Callbacks installed while the batch was in progress. */
+	if (!batch->nesting)
+		return;
+	if (--batch->nesting)
+		return;
+	if (batch->nr_records && !batch->busy)
+		lttng_ust_batch_flush(batch);
+}
+
+void lttng_ust_batch_init(void)
+{
+	tracepoint_set_batch_cb(lttng_ust_batch_begin, lttng_ust_batch_end);
+}
+
+void lttng_ust_batch_exit(void)
+{
+	tracepoint_set_batch_cb(NULL, NULL);
+}
@@ -33,7 +33,9 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <time.h>
+#include <inttypes.h>
 #include <assert.h>
+#include <limits.h>
 #include <signal.h>
 #include <urcu/uatomic.h>
 #include <urcu/futex.h>
@@ -55,6 +57,7 @@
 #include "lttng-ust-statedump.h"
 #include "clock.h"
 #include "../libringbuffer/getcpu.h"
+#include "../libringbuffer/memcpy_nt.h"
 #include "getenv.h"
 
 /*
@@ -288,6 +291,7 @@ static const char *cmd_name_mapping[] = {
 	[ LTTNG_UST_WAIT_QUIESCENT ] = "Wait for Quiescent State",
 	[ LTTNG_UST_REGISTER_DONE ] = "Registration Done",
 	[ LTTNG_UST_TRACEPOINT_FIELD_LIST ] = "Create Tracepoint Field List",
+	[ LTTNG_UST_FILTER_STATS_LIST ] = "Create Filter Statistics List",
 
 	/* Session FD commands */
 	[ LTTNG_UST_CHANNEL ] = "Create Channel",
@@ -309,10 +313,13 @@ static const char *cmd_name_mapping[] = {
 	/* Tracepoint list commands */
 	[ LTTNG_UST_TRACEPOINT_LIST_GET ] = "List Next Tracepoint",
 	[ LTTNG_UST_TRACEPOINT_FIELD_LIST_GET ] = "List Next Tracepoint Field",
+	[ LTTNG_UST_FILTER_STATS_LIST_GET ] = "List Next Filter Statistics",
 
 	/* Event FD commands */
 	[ LTTNG_UST_FILTER ] = "Create Filter",
 	[ LTTNG_UST_EXCLUSION ] = "Add exclusions to event",
+	[ LTTNG_UST_STATIC_FILTER ] = "Enable static filter",
+	[ LTTNG_UST_CLEAR_STATIC_FILTER ] = "Disable static filter",
 };
 
 static const char *str_timeout;
@@ -322,12 +329,18 @@ extern void lttng_ring_buffer_client_overwrite_init(void);
 extern void lttng_ring_buffer_client_overwrite_rt_init(void);
 extern void lttng_ring_buffer_client_discard_init(void);
 extern void lttng_ring_buffer_client_discard_rt_init(void);
+extern void lttng_ring_buffer_client_discard_pt_init(void);
+extern void lttng_ring_buffer_client_overwrite_pt_init(void);
 extern void lttng_ring_buffer_metadata_client_init(void);
 extern void lttng_ring_buffer_client_overwrite_exit(void);
 extern void lttng_ring_buffer_client_overwrite_rt_exit(void);
 extern void lttng_ring_buffer_client_discard_exit(void);
 extern void lttng_ring_buffer_client_discard_rt_exit(void);
+extern void lttng_ring_buffer_client_discard_pt_exit(void);
+extern void lttng_ring_buffer_client_overwrite_pt_exit(void);
 extern void lttng_ring_buffer_metadata_client_exit(void);
+extern void lttng_filter_string_init(void);
+extern void lttng_filter_jit_init(void);
 
 ssize_t lttng_ust_read(int fd, void *buf, size_t len)
 {
@@ -464,6 +477,84 @@ long get_notify_sock_timeout(void)
 	return get_timeout();
 }
 
+/*
+ * Phases of lttng_ust_init(), timed for the startup benchmark of
+ * tests/benchmark.
+ */
+enum lttng_ust_init_phase {
+	LTTNG_UST_INIT_PHASE_TLS_FIXUP,
+	LTTNG_UST_INIT_PHASE_CORE,
+	LTTNG_UST_INIT_PHASE_CLIENTS,
+	LTTNG_UST_INIT_PHASE_LISTENERS,
+	LTTNG_UST_INIT_PHASE_REGISTER_WAIT,
+	LTTNG_UST_INIT_NR_PHASES,
+};
+
+static const char *init_phase_names[LTTNG_UST_INIT_NR_PHASES] = {
+	[ LTTNG_UST_INIT_PHASE_TLS_FIXUP ] = "tls_fixup",
+	[ LTTNG_UST_INIT_PHASE_CORE ] = "core_init",
+	[ LTTNG_UST_INIT_PHASE_CLIENTS ] = "client_init",
+	[ LTTNG_UST_INIT_PHASE_LISTENERS ] = "listener_start",
+	[ LTTNG_UST_INIT_PHASE_REGISTER_WAIT ] = "register_wait",
+};
+static uint64_t init_phase_ns[LTTNG_UST_INIT_NR_PHASES];
+
+static
+uint64_t init_clock_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Account the time since @start to @phase, and start the next phase.
+ */
+static
+void init_phase_done(enum lttng_ust_init_phase phase, uint64_t *start)
+{
+	uint64_t now = init_clock_ns();
+
+	init_phase_ns[phase] = now - *start;
+	*start = now;
+}
+
+/*
+ * Write the duration of each phase, as a "name ns" line, to the file
+ * descriptor set in LTTNG_UST_INIT_PHASES_FD, if any. The variable is
+ * unset, so that neither the children nor this process after fork
+ * write to a file descriptor they did not open.
+ */
+static
+void init_phases_dump(void)
+{
+	const char *str;
+	char line[64], *endptr;
+	int i, len;
+	long fd;
+
+	str = lttng_secure_getenv("LTTNG_UST_INIT_PHASES_FD");
+	if (!str)
+		return;
+	errno = 0;
+	fd = strtol(str, &endptr, 10);
+	if (errno || endptr == str || *endptr != '\0' || fd < 0
+			|| fd > INT_MAX || fcntl(fd, F_GETFD) < 0) {
+		WARN("Invalid LTTNG_UST_INIT_PHASES_FD value \"%s\"", str);
+		goto end;
+	}
+	for (i = 0; i < LTTNG_UST_INIT_NR_PHASES; i++) {
+		len = snprintf(line, sizeof(line), "%s %" PRIu64 "\n",
+			init_phase_names[i], init_phase_ns[i]);
+		if (len > 0)
+			(void) patient_write(fd, line, len);
+	}
+end:
+	(void) unsetenv("LTTNG_UST_INIT_PHASES_FD");
+}
+
 /*
  * Return values: -1: wait forever. 0: don't wait. 1: timeout wait.
  */
@@ -552,6 +643,8 @@ int handle_register_done(struct sock_info *sock_info)
 	if (ret == 0) {
 		ret = sem_post(&constructor_wait);
 		assert(!ret);
+		/* The sessions enabled so far have their early events. */
+		lttng_ust_early_exit();
 	}
 	return 0;
 }
@@ -873,8 +966,9 @@ int handle_message(struct sock_info *sock_info,
 	}
 
 	/*
-	 * LTTNG_UST_TRACEPOINT_FIELD_LIST_GET needs to send the field
-	 * after the reply.
+	 * LTTNG_UST_TRACEPOINT_FIELD_LIST_GET and
+	 * LTTNG_UST_FILTER_STATS_LIST_GET need to send the entry after
+	 * the reply.
 	 */
 	if (lur.ret_code == LTTNG_UST_OK) {
 		switch (lum->cmd) {
@@ -890,6 +984,20 @@ int handle_message(struct sock_info *sock_info,
 				ret = -EINVAL;
 				goto error;
 			}
+			break;
+		case LTTNG_UST_FILTER_STATS_LIST_GET:
+			len = ustcomm_send_unix_sock(sock,
+				&args.filter_stats_list.entry,
+				sizeof(args.filter_stats_list.entry));
+			if (len < 0) {
+				ret = len;
+				goto error;
+			}
+			if (len != sizeof(args.filter_stats_list.entry)) {
+				ret = -EINVAL;
+				goto error;
+			}
+			break;
 		}
 	}
 
@@ -1485,11 +1593,13 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	struct timespec constructor_timeout;
 	sigset_t sig_all_blocked, orig_parent_mask;
 	pthread_attr_t thread_attr;
+	uint64_t phase_start;
 	int timeout_mode;
 	int ret;
 
 	if (uatomic_xchg(&initialized, 1) == 1)
 		return;
+	phase_start = init_clock_ns();
 
 	/*
 	 * Fixup interdependency between TLS fixup mutex (which happens
@@ -1502,6 +1612,8 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	lttng_fixup_nest_count_tls();
 	lttng_fixup_procname_tls();
 	lttng_fixup_ust_mutex_nest_tls();
+	lttng_fixup_batch_tls();
+	init_phase_done(LTTNG_UST_INIT_PHASE_TLS_FIXUP, &phase_start);
 
 	/*
 	 * We want precise control over the order in which we construct
@@ -1513,20 +1625,35 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	init_tracepoint();
 	lttng_ust_clock_init();
 	lttng_ust_getcpu_init();
+	lib_ring_buffer_nt_init();
+	lttng_filter_string_init();
+	lttng_filter_jit_init();
 	lttng_ust_statedump_init();
+	init_phase_done(LTTNG_UST_INIT_PHASE_CORE, &phase_start);
 	lttng_ring_buffer_metadata_client_init();
 	lttng_ring_buffer_client_overwrite_init();
 	lttng_ring_buffer_client_overwrite_rt_init();
 	lttng_ring_buffer_client_discard_init();
 	lttng_ring_buffer_client_discard_rt_init();
+	lttng_ring_buffer_client_discard_pt_init();
+	lttng_ring_buffer_client_overwrite_pt_init();
 	lttng_perf_counter_init();
 	lttng_context_init();
+	lttng_ust_batch_init();
 	/*
 	 * Invoke ust malloc wrapper init before starting other threads.
 	 */
 	lttng_ust_malloc_wrapper_init();
+	init_phase_done(LTTNG_UST_INIT_PHASE_CLIENTS, &phase_start);
 
 	timeout_mode = get_constructor_timeout(&constructor_timeout);
+	ust_lock_nocheck();
+	ret = lttng_ust_early_init();
+	ust_unlock();
+	if (ret) {
+		/* Early events are kept until registration completes. */
+		timeout_mode = 0;
+	}
 
 	ret = sem_init(&constructor_wait, 0, 0);
 	assert(!ret);
@@ -1575,7 +1702,9 @@ void __attribute__((constructor)) lttng_ust_init(void)
 		local_apps.thread_active = 1;
 		pthread_mutex_unlock(&ust_exit_mutex);
 	} else {
+		ust_lock_nocheck();
 		handle_register_done(&local_apps);
+		ust_unlock();
 	}
 	ret = pthread_attr_destroy(&thread_attr);
 	if (ret) {
@@ -1587,6 +1716,7 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	if (ret) {
 		ERR("pthread_sigmask: %s", strerror(ret));
 	}
+	init_phase_done(LTTNG_UST_INIT_PHASE_LISTENERS, &phase_start);
 
 	switch (timeout_mode) {
 	case 1:	/* timeout wait */
@@ -1609,6 +1739,8 @@ void __attribute__((constructor)) lttng_ust_init(void)
 	case 0:	/* no timeout */
 		break;
 	}
+	init_phase_done(LTTNG_UST_INIT_PHASE_REGISTER_WAIT, &phase_start);
+	init_phases_dump();
 }
 
 static
@@ -1623,10 +1755,14 @@ void lttng_ust_cleanup(int exiting)
 	 * that none of these threads are accessing this data at this
 	 * point.
 	 */
+	lttng_ust_batch_exit();
 	lttng_ust_abi_exit();
+	lttng_ust_early_exit();
 	lttng_ust_events_exit();
 	lttng_context_exit();
 	lttng_perf_counter_exit();
+	lttng_ring_buffer_client_overwrite_pt_exit();
+	lttng_ring_buffer_client_discard_pt_exit();
 	lttng_ring_buffer_client_discard_rt_exit();
 	lttng_ring_buffer_client_discard_exit();
 	lttng_ring_buffer_client_overwrite_rt_exit();
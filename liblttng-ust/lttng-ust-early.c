@@ -0,0 +1,368 @@
+/*
+ * lttng-ust-early.c
+ *
+ * LTTng UST early event records, captured in a process-local buffer
+ * until the application is registered to all the session daemons, and
+ * replayed into the sessions enabled meanwhile.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <urcu/compiler.h>
+#include <urcu/system.h>
+#include <urcu/uatomic.h>
+#include <lttng/ust-events.h>
+#include <lttng/ringbuffer-config.h>
+#include <usterr-signal-safe.h>
+#include <helper.h>
+
+#include "lttng-tracer.h"
+
+/*
+ * Records are appended to the buffer, each as a header followed by the
+ * payload aligned on its largest field alignment, like in the ring
+ * buffer, so the payload is copied as is when replayed.
+ */
+struct early_record {
+	const struct lttng_event_desc *desc;
+	void *ip;
+	uint32_t data_size;
+	uint16_t largest_align;
+	uint16_t committed;
+};
+
+#define EARLY_BUF_ALIGN		64
+
+static struct lttng_session *early_session;
+static struct lttng_channel *early_chan;
+static char *early_buf;
+static size_t early_buf_size;
+static unsigned long early_offset;	/* Next free byte of early_buf */
+static unsigned long early_lost;
+
+static
+size_t early_payload_offset(size_t header_offset, size_t largest_align)
+{
+	size_t offset = header_offset + sizeof(struct early_record);
+
+	return offset + lib_ring_buffer_align(offset, largest_align);
+}
+
+static
+int early_event_reserve(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		uint32_t event_id)
+{
+	struct lttng_event *event = ctx->priv;
+	struct early_record *rec;
+	unsigned long old, header, payload, end;
+
+	do {
+		old = uatomic_read(&early_offset);
+		header = old + lib_ring_buffer_align(old,
+				lttng_alignof(struct early_record));
+		payload = early_payload_offset(header, ctx->largest_align);
+		end = payload + ctx->data_size;
+		if (end > early_buf_size) {
+			uatomic_inc(&early_lost);
+			return -ENOBUFS;
+		}
+	} while (uatomic_cmpxchg(&early_offset, old, end) != old);
+	rec = (struct early_record *) (early_buf + header);
+	rec->desc = event->desc;
+	rec->ip = ctx->ip;
+	rec->data_size = ctx->data_size;
+	rec->largest_align = ctx->largest_align;
+	rec->committed = 0;
+	ctx->pre_offset = header;
+	ctx->buf_offset = payload;
+	return 0;
+}
+
+static
+void early_event_commit(struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	struct early_record *rec;
+
+	rec = (struct early_record *) (early_buf + ctx->pre_offset);
+	/* Publish the payload before the record is replayed. */
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(rec->committed, 1);
+}
+
+static
+void early_event_write(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const void *src, size_t len)
+{
+	if (caa_likely(ctx->buf_offset + len <= early_buf_size))
+		memcpy(early_buf + ctx->buf_offset, src, len);
+	ctx->buf_offset += len;
+}
+
+/*
+ * Same layout as lib_ring_buffer_strcpy(): @len - 1 bytes of string,
+ * padded with '#' if shorter, followed by a terminating '\0'.
+ */
+static
+void early_event_strcpy(struct lttng_ust_lib_ring_buffer_ctx *ctx,
+		const char *src, size_t len)
+{
+	size_t count;
+	char *dest;
+
+	if (caa_unlikely(!len))
+		return;
+	if (caa_unlikely(ctx->buf_offset + len > early_buf_size)) {
+		ctx->buf_offset += len;
+		return;
+	}
+	dest = early_buf + ctx->buf_offset;
+	for (count = 0; count < len - 1 && src[count] != '\0'; count++)
+		dest[count] = src[count];
+	memset(dest + count, '#', len - 1 - count);
+	dest[len - 1] = '\0';
+	ctx->buf_offset += len;
+}
+
+static const struct lttng_channel_ops early_ops = {
+	.u.has_strcpy = 1,
+	.u.has_filter_field_mask = 1,
+	.u.has_static_filter = 1,
+	.event_reserve = early_event_reserve,
+	.event_commit = early_event_commit,
+	.event_write = early_event_write,
+	.event_strcpy = early_event_strcpy,
+};
+
+int lttng_ust_is_early_session(struct lttng_session *session)
+{
+	return session && session == early_session;
+}
+
+/*
+ * Size of the early buffer, 0 if early records are not captured.
+ */
+static
+size_t early_buffer_size(void)
+{
+	const char *str;
+	char *endptr;
+	unsigned long size;
+
+	str = getenv("LTTNG_UST_EARLY_BUFFER_SIZE");
+	if (!str)
+		return 0;
+	errno = 0;
+	size = strtoul(str, &endptr, 0);
+	if (errno || endptr == str || *endptr != '\0') {
+		WARN("Invalid LTTNG_UST_EARLY_BUFFER_SIZE value \"%s\"", str);
+		return 0;
+	}
+	return size;
+}
+
+/*
+ * Create the early session: a process-local session with one channel
+ * writing into the early buffer, and an enabler for all events. The
+ * probes registered later are connected to it by the usual enabler
+ * sync. Returns 1 if early records are captured, in which case the
+ * constructor does not wait for the session daemons.
+ * Called with ust lock held.
+ */
+int lttng_ust_early_init(void)
+{
+	struct lttng_ust_event event_param;
+	struct lttng_enabler *enabler;
+	size_t size;
+
+	size = early_buffer_size();
+	if (!size)
+		return 0;
+	if (posix_memalign((void **) &early_buf, EARLY_BUF_ALIGN, size)) {
+		early_buf = NULL;
+		goto error;
+	}
+	early_buf_size = size;
+	early_offset = 0;
+	early_lost = 0;
+
+	early_session = lttng_session_create();
+	if (!early_session)
+		goto error;
+	early_chan = zmalloc(sizeof(*early_chan));
+	if (!early_chan)
+		goto error;
+	early_chan->session = early_session;
+	early_chan->ops = &early_ops;
+	early_chan->enabled = 1;
+	early_chan->tstate = 1;
+	early_chan->objd = -1;
+	cds_list_add(&early_chan->node, &early_session->chan_head);
+
+	memset(&event_param, 0, sizeof(event_param));
+	event_param.instrumentation = LTTNG_UST_TRACEPOINT;
+	strcpy(event_param.name, "*");
+	event_param.loglevel_type = LTTNG_UST_LOGLEVEL_ALL;
+	event_param.loglevel = -1;
+	early_session->objd = -1;
+	early_session->tstate = 1;
+	/* Active first, so enabling the enabler creates the events. */
+	CMM_ACCESS_ONCE(early_session->active) = 1;
+	enabler = lttng_enabler_create(LTTNG_ENABLER_WILDCARD, &event_param,
+			early_chan);
+	if (!enabler)
+		goto error;
+	lttng_enabler_enable(enabler);
+	DBG("Capturing early events in a %zu bytes buffer", size);
+	return 1;
+
+error:
+	ERR("Unable to set up the early events buffer");
+	lttng_ust_early_exit();
+	return 0;
+}
+
+static
+int event_desc_cmp(const void *a, const void *b)
+{
+	const struct lttng_event *x = *(struct lttng_event * const *) a;
+	const struct lttng_event *y = *(struct lttng_event * const *) b;
+
+	if (x->desc == y->desc)
+		return 0;
+	return (uintptr_t) x->desc < (uintptr_t) y->desc ? -1 : 1;
+}
+
+static
+void early_record_write(struct lttng_event *event,
+		const struct early_record *rec, const char *payload)
+{
+	struct lttng_channel *chan = event->chan;
+	struct lttng_ust_lib_ring_buffer_ctx ctx;
+
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, event, rec->data_size,
+			rec->largest_align, -1, chan->handle);
+	ctx.ip = rec->ip;
+	if (chan->ops->event_reserve(&ctx, event->id))
+		return;
+	chan->ops->event_write(&ctx, payload, rec->data_size);
+	chan->ops->event_commit(&ctx);
+}
+
+/*
+ * Write the early records into @session, which is about to be enabled.
+ * The records are only written to the events which record all their
+ * hits: the filters cannot be evaluated on early records. Their
+ * timestamps and contexts are the ones of the replay. A session which
+ * has been active before got them when it was first enabled.
+ *
+ * Early records are still captured for the sessions of the session
+ * daemons not registered yet. Only the records taken before @session is
+ * enabled are replayed into it, since it records the following hits
+ * itself.
+ * Called with ust lock held.
+ */
+void lttng_ust_early_replay(struct lttng_session *session)
+{
+	struct lttng_event *event, **events;
+	size_t nr_events = 0;
+	unsigned long offset, end;
+
+	if (!early_session || session == early_session
+			|| session->been_active)
+		return;
+
+	/* Wait for the records reserved before the cutoff to commit. */
+	end = uatomic_read(&early_offset);
+	synchronize_trace();
+
+	cds_list_for_each_entry(event, &session->events_head, node)
+		nr_events++;
+	if (!nr_events)
+		return;
+	events = zmalloc(nr_events * sizeof(*events));
+	if (!events) {
+		ERR("Unable to replay early events");
+		return;
+	}
+	nr_events = 0;
+	cds_list_for_each_entry(event, &session->events_head, node) {
+		if (!event->enabled || !event->chan->enabled
+				|| !event->has_enablers_without_bytecode
+				|| event->static_filter)
+			continue;
+		events[nr_events++] = event;
+	}
+	qsort(events, nr_events, sizeof(*events), event_desc_cmp);
+
+	for (offset = 0; offset < end; ) {
+		struct early_record *rec;
+		struct lttng_event key_event, *key = &key_event, **match;
+		size_t payload;
+
+		offset += lib_ring_buffer_align(offset,
+				lttng_alignof(struct early_record));
+		rec = (struct early_record *) (early_buf + offset);
+		payload = early_payload_offset(offset, rec->largest_align);
+		offset = payload + rec->data_size;
+		if (!rec->committed)
+			continue;
+		key_event.desc = rec->desc;
+		match = bsearch(&key, events, nr_events, sizeof(*events),
+				event_desc_cmp);
+		if (!match)
+			continue;
+		/* Rewind to the first event of the descriptor. */
+		while (match > events && (*(match - 1))->desc == rec->desc)
+			match--;
+		for (; match < events + nr_events
+				&& (*match)->desc == rec->desc; match++)
+			early_record_write(*match, rec, early_buf + payload);
+	}
+	free(events);
+}
+
+/*
+ * Discard the early records, once the application is registered to the
+ * session daemons, or at exit.
+ * Called with ust lock held, or from the destructor.
+ */
+void lttng_ust_early_exit(void)
+{
+	if (early_session) {
+		unsigned long lost;
+
+		/* The early channel has no ring buffer to unmap. */
+		if (early_chan)
+			cds_list_del(&early_chan->node);
+		lttng_session_destroy(early_session);
+		lost = uatomic_read(&early_lost);
+		if (lost)
+			WARN("%lu early event records lost, LTTNG_UST_EARLY_BUFFER_SIZE of %zu bytes is too small",
+				lost, early_buf_size);
+		DBG("Discarding early events buffer: %lu bytes used",
+			uatomic_read(&early_offset));
+	}
+	early_session = NULL;
+	free(early_chan);
+	early_chan = NULL;
+	free(early_buf);
+	early_buf = NULL;
+	early_buf_size = 0;
+}
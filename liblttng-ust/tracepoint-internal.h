@@ -38,6 +38,8 @@ extern int tracepoint_probe_register_noupdate(const char *name,
 extern int tracepoint_probe_unregister_noupdate(const char *name,
 		void (*callback)(void), void *priv);
 extern void tracepoint_probe_update_all(void);
+extern void tracepoint_set_batch_cb(void (*begin)(void), void (*end)(void));
+extern void tracepoint_wire_pending_libs(void);
 
 /*
  * call after disconnection of last probe implemented within a
@@ -20,14 +20,16 @@
  */
 
 #define _LGPL_SOURCE
+#include <assert.h>
 #include <errno.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <urcu/arch.h>
 #include <urcu-bp.h>
-#include <urcu/hlist.h>
+#include <urcu/rculfhash.h>
 #include <urcu/uatomic.h>
 #include <urcu/compiler.h>
 #include <urcu/system.h>
@@ -47,6 +49,8 @@
 static const int tracepoint_debug;
 static int initialized;
 static void (*new_tracepoint_cb)(struct lttng_ust_tracepoint *);
+static void (*batch_begin_cb)(void);
+static void (*batch_end_cb)(void);
 
 /*
  * tracepoint_mutex nests inside UST mutex.
@@ -67,6 +71,18 @@ static pthread_mutex_t tracepoint_mutex = PTHREAD_MUTEX_INITIALIZER;
  */
 static CDS_LIST_HEAD(libs);
 
+/*
+ * With LTTNG_UST_DEFER_TRACEPOINT_REGISTRATION set, libraries are only
+ * recorded in this list when they register, and their callsites are
+ * wired the first time a session is created or a probe is connected.
+ * Protected by tracepoint mutex.
+ */
+static int defer_registration;
+static int libs_wired;
+static CDS_LIST_HEAD(pending_libs);
+
+static void wire_pending_libs(void);
+
 /*
  * The tracepoint mutex protects the library tracepoints, the hash table, and
  * the library list.
@@ -75,13 +91,27 @@ static CDS_LIST_HEAD(libs);
  * tracepoint_unregister_lib, which take the tracepoint mutex themselves.
  */
 
+/*
+ * Initial and maximal number of buckets of the tracepoint and callsite
+ * hash tables. They grow with the number of entries, so applications
+ * registering tens of thousands of callsites keep short chains.
+ *
+ * The tables are resized by the thread adding the entries, with the
+ * tracepoint mutex held, rather than by the call_rcu worker thread of
+ * CDS_LFHT_AUTO_RESIZE: applications which do not load liblttng-ust
+ * have no fork handler pausing it. Since all the table accesses are
+ * serialized by the tracepoint mutex, the removed nodes are freed
+ * without waiting for a grace period.
+ */
+#define TRACEPOINT_HT_MIN_BUCKETS	(1UL << 8)
+#define TRACEPOINT_HT_MAX_BUCKETS	(1UL << 20)
+
 /*
  * Tracepoint hash table, containing the active tracepoints.
- * Protected by tracepoint mutex.
+ * Updates are protected by tracepoint mutex.
  */
-#define TRACEPOINT_HASH_BITS 12
-#define TRACEPOINT_TABLE_SIZE (1 << TRACEPOINT_HASH_BITS)
-static struct cds_hlist_head tracepoint_table[TRACEPOINT_TABLE_SIZE];
+static struct cds_lfht *tracepoint_table;
+static unsigned long tracepoint_table_size, nr_tracepoint_entries;
 
 static CDS_LIST_HEAD(old_probes);
 static int need_update;
@@ -93,7 +123,8 @@ static int need_update;
  * Tracepoint entries modifications are protected by the tracepoint mutex.
  */
 struct tracepoint_entry {
-	struct cds_hlist_node hlist;
+	struct cds_lfht_node node;	/* hash table node */
+	unsigned long hash;
 	struct lttng_ust_tracepoint_probe *probes;
 	int refcount;	/* Number of times armed. 0 if disarmed. */
 	int callsite_refcount;	/* how many libs use this tracepoint */
@@ -111,15 +142,15 @@ struct tp_probes {
 };
 
 /*
- * Callsite hash table, containing the tracepoint call sites.
- * Protected by tracepoint mutex.
+ * Callsite hash table, containing the tracepoint call sites. Several
+ * call sites share the same name. Updates are protected by tracepoint
+ * mutex.
  */
-#define CALLSITE_HASH_BITS 12
-#define CALLSITE_TABLE_SIZE (1 << CALLSITE_HASH_BITS)
-static struct cds_hlist_head callsite_table[CALLSITE_TABLE_SIZE];
+static struct cds_lfht *callsite_table;
+static unsigned long callsite_table_size, nr_callsite_entries;
 
 struct callsite_entry {
-	struct cds_hlist_node hlist;	/* hash table node */
+	struct cds_lfht_node ht_node;	/* hash table node */
 	struct cds_list_head node;	/* lib list of callsites node */
 	struct lttng_ust_tracepoint *tp;
 };
@@ -238,29 +269,101 @@ tracepoint_entry_remove_probe(struct tracepoint_entry *entry,
 }
 
 /*
- * Get tracepoint if the tracepoint is present in the tracepoint hash table.
- * Must be called with tracepoint mutex held.
- * Returns NULL if not present.
+ * Hash of a tracepoint name, truncated to the size limits.
  */
-static struct tracepoint_entry *get_tracepoint(const char *name)
+static unsigned long tracepoint_name_hash(const char *name)
 {
-	struct cds_hlist_head *head;
-	struct cds_hlist_node *node;
-	struct tracepoint_entry *e;
 	size_t name_len = strlen(name);
-	uint32_t hash;
 
 	if (name_len > LTTNG_UST_SYM_NAME_LEN - 1) {
 		WARN("Truncating tracepoint name %s which exceeds size limits of %u chars", name, LTTNG_UST_SYM_NAME_LEN - 1);
 		name_len = LTTNG_UST_SYM_NAME_LEN - 1;
 	}
-	hash = jhash(name, name_len, 0);
-	head = &tracepoint_table[hash & (TRACEPOINT_TABLE_SIZE - 1)];
-	cds_hlist_for_each_entry(e, node, head, hlist) {
-		if (!strncmp(name, e->name, LTTNG_UST_SYM_NAME_LEN - 1))
-			return e;
+	return jhash(name, name_len, 0);
+}
+
+/*
+ * Create the hash tables on first use. Must be called with tracepoint
+ * mutex held.
+ */
+static int init_tracepoint_tables(void)
+{
+	if (!tracepoint_table) {
+		tracepoint_table = cds_lfht_new(TRACEPOINT_HT_MIN_BUCKETS,
+				TRACEPOINT_HT_MIN_BUCKETS,
+				TRACEPOINT_HT_MAX_BUCKETS, 0, NULL);
+		if (!tracepoint_table)
+			return -ENOMEM;
+		tracepoint_table_size = TRACEPOINT_HT_MIN_BUCKETS;
+	}
+	if (!callsite_table) {
+		callsite_table = cds_lfht_new(TRACEPOINT_HT_MIN_BUCKETS,
+				TRACEPOINT_HT_MIN_BUCKETS,
+				TRACEPOINT_HT_MAX_BUCKETS, 0, NULL);
+		if (!callsite_table)
+			return -ENOMEM;
+		callsite_table_size = TRACEPOINT_HT_MIN_BUCKETS;
 	}
-	return NULL;
+	return 0;
+}
+
+/*
+ * Double the number of buckets of @ht once it has more entries than
+ * buckets. Must be called with tracepoint mutex held, outside of RCU
+ * read-side critical section.
+ */
+static void grow_table(struct cds_lfht *ht, unsigned long *size,
+		unsigned long nr_entries)
+{
+	if (nr_entries <= *size || *size >= TRACEPOINT_HT_MAX_BUCKETS)
+		return;
+	*size <<= 1;
+	cds_lfht_resize(ht, *size);
+}
+
+static int tracepoint_entry_match(struct cds_lfht_node *node, const void *key)
+{
+	struct tracepoint_entry *e =
+		caa_container_of(node, struct tracepoint_entry, node);
+
+	return !strncmp(key, e->name, LTTNG_UST_SYM_NAME_LEN - 1);
+}
+
+static int callsite_entry_match(struct cds_lfht_node *node, const void *key)
+{
+	struct callsite_entry *e =
+		caa_container_of(node, struct callsite_entry, ht_node);
+
+	return !strncmp(key, e->tp->name, LTTNG_UST_SYM_NAME_LEN - 1);
+}
+
+/*
+ * Get tracepoint if the tracepoint is present in the tracepoint hash table.
+ * Must be called with tracepoint mutex held.
+ * Returns NULL if not present.
+ */
+static struct tracepoint_entry *get_tracepoint_hash(const char *name,
+		unsigned long hash)
+{
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *node;
+
+	if (!tracepoint_table)
+		return NULL;
+	rcu_read_lock();
+	cds_lfht_lookup(tracepoint_table, hash, tracepoint_entry_match,
+			name, &iter);
+	node = cds_lfht_iter_get_node(&iter);
+	rcu_read_unlock();
+	if (!node)
+		return NULL;
+	/* Entries are only freed with tracepoint mutex held. */
+	return caa_container_of(node, struct tracepoint_entry, node);
+}
+
+static struct tracepoint_entry *get_tracepoint(const char *name)
+{
+	return get_tracepoint_hash(name, tracepoint_name_hash(name));
 }
 
 /*
@@ -270,24 +373,16 @@ static struct tracepoint_entry *get_tracepoint(const char *name)
 static struct tracepoint_entry *add_tracepoint(const char *name,
 		const char *signature)
 {
-	struct cds_hlist_head *head;
-	struct cds_hlist_node *node;
 	struct tracepoint_entry *e;
+	struct cds_lfht_node *node;
 	size_t name_len = strlen(name);
-	uint32_t hash;
+	int ret;
 
-	if (name_len > LTTNG_UST_SYM_NAME_LEN - 1) {
-		WARN("Truncating tracepoint name %s which exceeds size limits of %u chars", name, LTTNG_UST_SYM_NAME_LEN - 1);
+	ret = init_tracepoint_tables();
+	if (ret)
+		return ERR_PTR(ret);
+	if (name_len > LTTNG_UST_SYM_NAME_LEN - 1)
 		name_len = LTTNG_UST_SYM_NAME_LEN - 1;
-	}
-	hash = jhash(name, name_len, 0);
-	head = &tracepoint_table[hash & (TRACEPOINT_TABLE_SIZE - 1)];
-	cds_hlist_for_each_entry(e, node, head, hlist) {
-		if (!strncmp(name, e->name, LTTNG_UST_SYM_NAME_LEN - 1)) {
-			DBG("tracepoint %s busy", name);
-			return ERR_PTR(-EEXIST);	/* Already there */
-		}
-	}
 	/*
 	 * Using zmalloc here to allocate a variable length element. Could
 	 * cause some memory fragmentation if overused.
@@ -295,23 +390,41 @@ static struct tracepoint_entry *add_tracepoint(const char *name,
 	e = zmalloc(sizeof(struct tracepoint_entry) + name_len + 1);
 	if (!e)
 		return ERR_PTR(-ENOMEM);
-	memcpy(&e->name[0], name, name_len + 1);
+	memcpy(&e->name[0], name, name_len);
 	e->name[name_len] = '\0';
+	e->hash = tracepoint_name_hash(name);
 	e->probes = NULL;
 	e->refcount = 0;
 	e->callsite_refcount = 0;
 	e->signature = signature;
-	cds_hlist_add_head(&e->hlist, head);
+	cds_lfht_node_init(&e->node);
+	rcu_read_lock();
+	node = cds_lfht_add_unique(tracepoint_table, e->hash,
+			tracepoint_entry_match, e->name, &e->node);
+	rcu_read_unlock();
+	if (node != &e->node) {
+		DBG("tracepoint %s busy", name);
+		free(e);
+		return ERR_PTR(-EEXIST);	/* Already there */
+	}
+	grow_table(tracepoint_table, &tracepoint_table_size,
+			++nr_tracepoint_entries);
 	return e;
 }
 
 /*
  * Remove the tracepoint from the tracepoint hash table. Must be called with
- * tracepoint mutex held.
+ * tracepoint mutex held, outside of RCU read-side critical section.
  */
 static void remove_tracepoint(struct tracepoint_entry *e)
 {
-	cds_hlist_del(&e->hlist);
+	int ret;
+
+	rcu_read_lock();
+	ret = cds_lfht_del(tracepoint_table, &e->node);
+	rcu_read_unlock();
+	assert(!ret);
+	nr_tracepoint_entries--;
 	free(e);
 }
 
@@ -365,33 +478,35 @@ static void disable_tracepoint(struct lttng_ust_tracepoint *elem)
 
 /*
  * Add the callsite to the callsite hash table. Must be called with
- * tracepoint mutex held.
+ * tracepoint mutex held. The hash of the name is computed once here and
+ * cached in the tracepoint.
  */
 static void add_callsite(struct tracepoint_lib * lib, struct lttng_ust_tracepoint *tp)
 {
-	struct cds_hlist_head *head;
 	struct callsite_entry *e;
 	const char *name = tp->name;
-	size_t name_len = strlen(name);
-	uint32_t hash;
 	struct tracepoint_entry *tp_entry;
 
-	if (name_len > LTTNG_UST_SYM_NAME_LEN - 1) {
-		WARN("Truncating tracepoint name %s which exceeds size limits of %u chars", name, LTTNG_UST_SYM_NAME_LEN - 1);
-		name_len = LTTNG_UST_SYM_NAME_LEN - 1;
+	tp->name_hash = tracepoint_name_hash(name);
+	if (init_tracepoint_tables()) {
+		PERROR("Unable to add callsite for tracepoint \"%s\"", name);
+		return;
 	}
-	hash = jhash(name, name_len, 0);
-	head = &callsite_table[hash & (CALLSITE_TABLE_SIZE - 1)];
 	e = zmalloc(sizeof(struct callsite_entry));
 	if (!e) {
 		PERROR("Unable to add callsite for tracepoint \"%s\"", name);
 		return;
 	}
-	cds_hlist_add_head(&e->hlist, head);
 	e->tp = tp;
+	cds_lfht_node_init(&e->ht_node);
+	rcu_read_lock();
+	cds_lfht_add(callsite_table, tp->name_hash, &e->ht_node);
+	rcu_read_unlock();
 	cds_list_add(&e->node, &lib->callsites);
+	grow_table(callsite_table, &callsite_table_size,
+			++nr_callsite_entries);
 
-	tp_entry = get_tracepoint(name);
+	tp_entry = get_tracepoint_hash(name, tp->name_hash);
 	if (!tp_entry)
 		return;
 	tp_entry->callsite_refcount++;
@@ -404,14 +519,19 @@ static void add_callsite(struct tracepoint_lib * lib, struct lttng_ust_tracepoin
 static void remove_callsite(struct callsite_entry *e)
 {
 	struct tracepoint_entry *tp_entry;
+	int ret;
 
-	tp_entry = get_tracepoint(e->tp->name);
+	tp_entry = get_tracepoint_hash(e->tp->name, e->tp->name_hash);
 	if (tp_entry) {
 		tp_entry->callsite_refcount--;
 		if (tp_entry->callsite_refcount == 0)
 			disable_tracepoint(e->tp);
 	}
-	cds_hlist_del(&e->hlist);
+	rcu_read_lock();
+	ret = cds_lfht_del(callsite_table, &e->ht_node);
+	rcu_read_unlock();
+	assert(!ret);
+	nr_callsite_entries--;
 	cds_list_del(&e->node);
 	free(e);
 }
@@ -423,25 +543,20 @@ static void remove_callsite(struct callsite_entry *e)
  */
 static void tracepoint_sync_callsites(const char *name)
 {
-	struct cds_hlist_head *head;
-	struct cds_hlist_node *node;
+	struct cds_lfht_iter iter;
 	struct callsite_entry *e;
-	size_t name_len = strlen(name);
-	uint32_t hash;
+	unsigned long hash;
 	struct tracepoint_entry *tp_entry;
 
-	tp_entry = get_tracepoint(name);
-	if (name_len > LTTNG_UST_SYM_NAME_LEN - 1) {
-		WARN("Truncating tracepoint name %s which exceeds size limits of %u chars", name, LTTNG_UST_SYM_NAME_LEN - 1);
-		name_len = LTTNG_UST_SYM_NAME_LEN - 1;
-	}
-	hash = jhash(name, name_len, 0);
-	head = &callsite_table[hash & (CALLSITE_TABLE_SIZE - 1)];
-	cds_hlist_for_each_entry(e, node, head, hlist) {
+	if (!callsite_table)
+		return;
+	hash = tracepoint_name_hash(name);
+	tp_entry = get_tracepoint_hash(name, hash);
+	rcu_read_lock();
+	cds_lfht_for_each_entry_duplicate(callsite_table, hash,
+			callsite_entry_match, name, &iter, e, ht_node) {
 		struct lttng_ust_tracepoint *tp = e->tp;
 
-		if (strncmp(name, tp->name, LTTNG_UST_SYM_NAME_LEN - 1))
-			continue;
 		if (tp_entry) {
 			set_tracepoint(&tp_entry, tp,
 					!!tp_entry->refcount);
@@ -449,6 +564,7 @@ static void tracepoint_sync_callsites(const char *name)
 			disable_tracepoint(tp);
 		}
 	}
+	rcu_read_unlock();
 }
 
 /**
@@ -472,7 +588,8 @@ void tracepoint_update_probe_range(struct lttng_ust_tracepoint * const *begin,
 			disable_tracepoint(*iter);
 			continue;
 		}
-		mark_entry = get_tracepoint((*iter)->name);
+		mark_entry = get_tracepoint_hash((*iter)->name,
+				(*iter)->name_hash);
 		if (mark_entry) {
 			set_tracepoint(&mark_entry, *iter,
 					!!mark_entry->refcount);
@@ -534,6 +651,7 @@ tracepoint_add_probe(const char *name, void (*probe)(void), void *data,
 	struct tracepoint_entry *entry;
 	struct lttng_ust_tracepoint_probe *old;
 
+	wire_pending_libs();
 	entry = get_tracepoint(name);
 	if (!entry) {
 		entry = add_tracepoint(name, signature);
@@ -715,6 +833,16 @@ void tracepoint_set_new_tracepoint_cb(void (*cb)(struct lttng_ust_tracepoint *))
 	new_tracepoint_cb = cb;
 }
 
+/*
+ * The batch callbacks are installed by the tracer. Call sites using
+ * tracepoint_batch() still work, one record at a time, when they are not.
+ */
+void tracepoint_set_batch_cb(void (*begin)(void), void (*end)(void))
+{
+	CMM_STORE_SHARED(batch_begin_cb, begin);
+	CMM_STORE_SHARED(batch_end_cb, end);
+}
+
 static void new_tracepoints(struct lttng_ust_tracepoint * const *start,
 			    struct lttng_ust_tracepoint * const *end)
 {
@@ -728,23 +856,14 @@ static void new_tracepoints(struct lttng_ust_tracepoint * const *start,
 	}
 }
 
-int tracepoint_register_lib(struct lttng_ust_tracepoint * const *tracepoints_start,
-			    int tracepoints_count)
+/*
+ * Add the library to the list of libraries, and hash and update its
+ * callsites. Must be called with tracepoint mutex held.
+ */
+static void wire_lib(struct tracepoint_lib *pl)
 {
-	struct tracepoint_lib *pl, *iter;
-
-	init_tracepoint();
+	struct tracepoint_lib *iter;
 
-	pl = (struct tracepoint_lib *) zmalloc(sizeof(struct tracepoint_lib));
-	if (!pl) {
-		PERROR("Unable to register tracepoint lib");
-		return -1;
-	}
-	pl->tracepoints_start = tracepoints_start;
-	pl->tracepoints_count = tracepoints_count;
-	CDS_INIT_LIST_HEAD(&pl->callsites);
-
-	pthread_mutex_lock(&tracepoint_mutex);
 	/*
 	 * We sort the libs by struct lib pointer address.
 	 */
@@ -759,9 +878,62 @@ int tracepoint_register_lib(struct lttng_ust_tracepoint * const *tracepoints_sta
 	/* We should be added at the head of the list */
 	cds_list_add(&pl->list, &libs);
 lib_added:
-	new_tracepoints(tracepoints_start, tracepoints_start + tracepoints_count);
+	new_tracepoints(pl->tracepoints_start,
+			pl->tracepoints_start + pl->tracepoints_count);
 	lib_register_callsites(pl);
 	lib_update_tracepoints(pl);
+}
+
+/*
+ * Wire the libraries whose registration was deferred. Libraries
+ * registering afterwards are wired immediately. Must be called with
+ * tracepoint mutex held.
+ */
+static void wire_pending_libs(void)
+{
+	struct tracepoint_lib *pl, *tmp;
+
+	if (libs_wired)
+		return;
+	libs_wired = 1;
+	cds_list_for_each_entry_safe(pl, tmp, &pending_libs, list) {
+		cds_list_del(&pl->list);
+		wire_lib(pl);
+	}
+}
+
+void tracepoint_wire_pending_libs(void)
+{
+	pthread_mutex_lock(&tracepoint_mutex);
+	wire_pending_libs();
+	pthread_mutex_unlock(&tracepoint_mutex);
+}
+
+int tracepoint_register_lib(struct lttng_ust_tracepoint * const *tracepoints_start,
+			    int tracepoints_count)
+{
+	struct tracepoint_lib *pl;
+
+	init_tracepoint();
+
+	pl = (struct tracepoint_lib *) zmalloc(sizeof(struct tracepoint_lib));
+	if (!pl) {
+		PERROR("Unable to register tracepoint lib");
+		return -1;
+	}
+	pl->tracepoints_start = tracepoints_start;
+	pl->tracepoints_count = tracepoints_count;
+	CDS_INIT_LIST_HEAD(&pl->callsites);
+
+	pthread_mutex_lock(&tracepoint_mutex);
+	if (defer_registration && !libs_wired) {
+		cds_list_add_tail(&pl->list, &pending_libs);
+		pthread_mutex_unlock(&tracepoint_mutex);
+		DBG("deferred registration of a tracepoints section from %p and having %d tracepoints",
+			tracepoints_start, tracepoints_count);
+		return 0;
+	}
+	wire_lib(pl);
 	pthread_mutex_unlock(&tracepoint_mutex);
 
 	DBG("just registered a tracepoints section from %p and having %d tracepoints",
@@ -782,6 +954,15 @@ int tracepoint_unregister_lib(struct lttng_ust_tracepoint * const *tracepoints_s
 	struct tracepoint_lib *lib;
 
 	pthread_mutex_lock(&tracepoint_mutex);
+	cds_list_for_each_entry(lib, &pending_libs, list) {
+		if (lib->tracepoints_start != tracepoints_start)
+			continue;
+
+		/* Not wired yet, no callsite to unregister. */
+		cds_list_del(&lib->list);
+		free(lib);
+		goto end;
+	}
 	cds_list_for_each_entry(lib, &libs, list) {
 		if (lib->tracepoints_start != tracepoints_start)
 			continue;
@@ -799,6 +980,7 @@ int tracepoint_unregister_lib(struct lttng_ust_tracepoint * const *tracepoints_s
 		free(lib);
 		break;
 	}
+end:
 	pthread_mutex_unlock(&tracepoint_mutex);
 	return 0;
 }
@@ -808,8 +990,14 @@ void init_tracepoint(void)
 	if (uatomic_xchg(&initialized, 1) == 1)
 		return;
 	init_usterr();
+	if (getenv("LTTNG_UST_DEFER_TRACEPOINT_REGISTRATION"))
+		defer_registration = 1;
 }
 
+/*
+ * The hash tables are kept, libraries can unregister their tracepoints
+ * from destructors running after this.
+ */
 void exit_tracepoint(void)
 {
 	initialized = 0;
@@ -836,3 +1024,27 @@ void *tp_rcu_dereference_sym_bp(void *p)
 {
 	return rcu_dereference_bp(p);
 }
+
+/*
+ * The RCU read-side critical section spans the whole batch, so the
+ * events staged by the probes stay valid until they are written.
+ */
+void tp_batch_begin(void)
+{
+	void (*cb)(void);
+
+	rcu_read_lock_bp();
+	cb = CMM_LOAD_SHARED(batch_begin_cb);
+	if (cb)
+		cb();
+}
+
+void tp_batch_end(void)
+{
+	void (*cb)(void);
+
+	cb = CMM_LOAD_SHARED(batch_end_cb);
+	if (cb)
+		cb();
+	rcu_read_unlock_bp();
+}
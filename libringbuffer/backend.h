@@ -31,6 +31,7 @@
 /* Internal helpers */
 #include "backend_internal.h"
 #include "frontend_internal.h"
+#include "memcpy_nt.h"
 
 /* Ring buffer backend API */
 
@@ -83,6 +84,7 @@ void lib_ring_buffer_write(const struct lttng_ust_lib_ring_buffer_config *config
 	size_t offset = ctx->buf_offset;
 	struct lttng_ust_lib_ring_buffer_backend_pages_shmp *rpages;
 	unsigned long sb_bindex, id;
+	void *dest;
 
 	if (caa_unlikely(!len))
 		return;
@@ -99,9 +101,13 @@ void lib_ring_buffer_write(const struct lttng_ust_lib_ring_buffer_config *config
 	 * subbuffers.
 	 */
 	CHAN_WARN_ON(chanb, offset >= chanb->buf_size);
-	lib_ring_buffer_do_copy(config,
-				shmp_index(handle, shmp(handle, rpages->shmp)->p, offset & (chanb->subbuf_size - 1)),
-				src, len);
+	dest = shmp_index(handle, shmp(handle, rpages->shmp)->p,
+			offset & (chanb->subbuf_size - 1));
+	if (!__builtin_constant_p(len)
+			&& caa_unlikely(len >= LIB_RING_BUFFER_NT_COPY_THRESHOLD))
+		lib_ring_buffer_memcpy_nt(dest, src, len);
+	else
+		lib_ring_buffer_do_copy(config, dest, src, len);
 	ctx->buf_offset += len;
 }
 
@@ -47,6 +47,8 @@ int channel_backend_init(struct channel_backend *chanb,
 			 size_t subbuf_size,
 			 size_t num_subbuf, struct lttng_ust_shm_handle *handle,
 			 const int *stream_fds);
+void channel_backend_lazy_range(struct channel_backend *chanb,
+		size_t *offset, size_t *len);
 void channel_backend_free(struct channel_backend *chanb,
 			  struct lttng_ust_shm_handle *handle);
 
@@ -197,14 +199,15 @@ int subbuffer_id_check_index(const struct lttng_ust_lib_ring_buffer_config *conf
 }
 
 static inline
-void subbuffer_count_record(const struct lttng_ust_lib_ring_buffer_config *config,
+void subbuffer_count_records(const struct lttng_ust_lib_ring_buffer_config *config,
 			    struct lttng_ust_lib_ring_buffer_backend *bufb,
-			    unsigned long idx, struct lttng_ust_shm_handle *handle)
+			    unsigned long idx, unsigned long nr_records,
+			    struct lttng_ust_shm_handle *handle)
 {
 	unsigned long sb_bindex;
 
 	sb_bindex = subbuffer_id_get_index(config, shmp_index(handle, bufb->buf_wsb, idx)->id);
-	v_inc(config, &shmp(handle, shmp_index(handle, bufb->array, sb_bindex)->shmp)->records_commit);
+	v_add(config, nr_records, &shmp(handle, shmp_index(handle, bufb->array, sb_bindex)->shmp)->records_commit);
 }
 
 /*
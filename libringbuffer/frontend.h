@@ -65,7 +65,8 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 				size_t subbuf_size, size_t num_subbuf,
 				unsigned int switch_timer_interval,
 				unsigned int read_timer_interval,
-				const int *stream_fds, int nr_stream_fds);
+				const int *stream_fds, int nr_stream_fds,
+				const struct lttng_ust_shm_attr *shm_attr);
 
 /*
  * channel_destroy finalizes all channel's buffers, waits for readers to
@@ -87,6 +88,14 @@ void channel_destroy(struct channel *chan, struct lttng_ust_shm_handle *handle,
 #define for_each_channel_cpu(cpu, chan)					\
 	for_each_possible_cpu(cpu)
 
+/*
+ * Iterate on all streams of a channel: one per possible cpu for
+ * RING_BUFFER_ALLOC_PER_CPU, the whole stream pool for
+ * RING_BUFFER_ALLOC_PER_THREAD.
+ */
+#define for_each_channel_stream(stream, chan)				\
+	for ((stream) = 0; (stream) < (chan)->nr_streams; (stream)++)
+
 extern struct lttng_ust_lib_ring_buffer *channel_get_ring_buffer(
 				const struct lttng_ust_lib_ring_buffer_config *config,
 				struct channel *chan, int cpu,
@@ -54,7 +54,11 @@ int lib_ring_buffer_get_cpu(const struct lttng_ust_lib_ring_buffer_config *confi
 	int cpu, nesting;
 
 	rcu_read_lock();
-	cpu = lttng_ust_get_cpu();
+	/* Per-thread channels select their stream at reserve time. */
+	if (config->alloc == RING_BUFFER_ALLOC_PER_THREAD)
+		cpu = 0;
+	else
+		cpu = lttng_ust_get_cpu();
 	nesting = ++URCU_TLS(lib_ring_buffer_nesting);
 	cmm_barrier();
 
@@ -78,6 +82,35 @@ void lib_ring_buffer_put_cpu(const struct lttng_ust_lib_ring_buffer_config *conf
 	rcu_read_unlock();
 }
 
+/**
+ * lib_ring_buffer_get_thread_stream - Get the stream of the current thread.
+ *
+ * For RING_BUFFER_ALLOC_PER_THREAD channels. The fast path looks up the
+ * stream in a per-thread cache and checks that the current thread
+ * still owns it. Returns the stream index, or a negative error value.
+ */
+static inline
+int lib_ring_buffer_get_thread_stream(const struct lttng_ust_lib_ring_buffer_config *config,
+				      struct channel *chan,
+				      struct lttng_ust_shm_handle *handle)
+{
+	struct lib_ring_buffer_thread_stream *entry;
+	struct lttng_ust_lib_ring_buffer *buf;
+
+	entry = &URCU_TLS(lib_ring_buffer_thread_cache).entries[
+			lib_ring_buffer_thread_cache_hash(chan)];
+	if (caa_likely(entry->chan == chan
+			&& entry->stream < chan->nr_streams)) {
+		if (entry->shared)
+			return entry->stream;
+		buf = shmp(handle, chan->backend.buf[entry->stream].shmp);
+		if (caa_likely(buf && CMM_LOAD_SHARED(buf->owner_tid)
+				== URCU_TLS(lib_ring_buffer_thread_cache).tid))
+			return entry->stream;
+	}
+	return lib_ring_buffer_claim_thread_stream(chan, handle);
+}
+
 /*
  * lib_ring_buffer_try_reserve is called by lib_ring_buffer_reserve(). It is not
  * part of the API per se.
@@ -166,12 +199,28 @@ int lib_ring_buffer_reserve(const struct lttng_ust_lib_ring_buffer_config *confi
 	if (uatomic_read(&chan->record_disabled))
 		return -EAGAIN;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	if (config->alloc == RING_BUFFER_ALLOC_PER_THREAD) {
+		int stream;
+
+		stream = lib_ring_buffer_get_thread_stream(config, chan,
+				handle);
+		if (caa_unlikely(stream < 0))
+			return stream;
+		ctx->cpu = stream;
+	}
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL)
 		buf = shmp(handle, chan->backend.buf[ctx->cpu].shmp);
 	else
 		buf = shmp(handle, chan->backend.buf[0].shmp);
 	if (uatomic_read(&buf->record_disabled))
 		return -EAGAIN;
+	if (caa_unlikely(CMM_LOAD_SHARED(buf->backing_pending))) {
+		int ret;
+
+		ret = lib_ring_buffer_commit_backing(buf, chan, handle);
+		if (ret)
+			return ret;
+	}
 	ctx->buf = buf;
 
 	/*
@@ -236,16 +285,22 @@ void lib_ring_buffer_switch(const struct lttng_ust_lib_ring_buffer_config *confi
 /* See ring_buffer_frontend_api.h for lib_ring_buffer_reserve(). */
 
 /**
- * lib_ring_buffer_commit - Commit an record.
+ * lib_ring_buffer_commit_batch - Commit a slot holding several records.
  * @config: ring buffer instance configuration.
  * @ctx: ring buffer context. (input arguments only)
+ * @nr_records: number of records written in the slot.
  *
  * Atomic unordered slot commit. Increments the commit count in the
  * specified sub-buffer, and delivers it if necessary.
+ *
+ * A single lib_ring_buffer_reserve() can cover a batch of records if the
+ * client record_header_size() callback accounts for all of them. The
+ * slot is then committed once, and all its records are counted.
  */
 static inline
-void lib_ring_buffer_commit(const struct lttng_ust_lib_ring_buffer_config *config,
-			    const struct lttng_ust_lib_ring_buffer_ctx *ctx)
+void lib_ring_buffer_commit_batch(const struct lttng_ust_lib_ring_buffer_config *config,
+			    const struct lttng_ust_lib_ring_buffer_ctx *ctx,
+			    unsigned long nr_records)
 {
 	struct channel *chan = ctx->chan;
 	struct lttng_ust_shm_handle *handle = ctx->handle;
@@ -257,7 +312,7 @@ void lib_ring_buffer_commit(const struct lttng_ust_lib_ring_buffer_config *confi
 	/*
 	 * Must count record before incrementing the commit count.
 	 */
-	subbuffer_count_record(config, &buf->backend, endidx, handle);
+	subbuffer_count_records(config, &buf->backend, endidx, nr_records, handle);
 
 	/*
 	 * Order all writes to buffer before the commit count update that will
@@ -297,6 +352,21 @@ void lib_ring_buffer_commit(const struct lttng_ust_lib_ring_buffer_config *confi
 			offset_end, commit_count, handle);
 }
 
+/**
+ * lib_ring_buffer_commit - Commit an record.
+ * @config: ring buffer instance configuration.
+ * @ctx: ring buffer context. (input arguments only)
+ *
+ * Atomic unordered slot commit. Increments the commit count in the
+ * specified sub-buffer, and delivers it if necessary.
+ */
+static inline
+void lib_ring_buffer_commit(const struct lttng_ust_lib_ring_buffer_config *config,
+			    const struct lttng_ust_lib_ring_buffer_ctx *ctx)
+{
+	lib_ring_buffer_commit_batch(config, ctx, 1);
+}
+
 /**
  * lib_ring_buffer_try_discard_reserve - Try discarding a record.
  * @config: ring buffer instance configuration.
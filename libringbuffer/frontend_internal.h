@@ -165,6 +165,11 @@ void lib_ring_buffer_switch_slow(struct lttng_ust_lib_ring_buffer *buf,
 				 enum switch_mode mode,
 				 struct lttng_ust_shm_handle *handle);
 
+extern
+int lib_ring_buffer_commit_backing(struct lttng_ust_lib_ring_buffer *buf,
+				   struct channel *chan,
+				   struct lttng_ust_shm_handle *handle);
+
 /* Buffer write helpers */
 
 static inline
@@ -311,6 +316,21 @@ void lib_ring_buffer_wakeup(struct lttng_ust_lib_ring_buffer *buf,
 	if (wakeup_fd < 0)
 		return;
 
+	/*
+	 * Writing to an eventfd cannot raise SIGPIPE, so it needs no
+	 * signal mask dance. The write can only fail with EAGAIN if the
+	 * counter is saturated, in which case the reader is already
+	 * awakened.
+	 */
+	if (shm_get_wakeup_type(handle, &buf->self._ref) == SHM_WAKEUP_EVENTFD) {
+		uint64_t count = 1;
+
+		do {
+			ret = write(wakeup_fd, &count, sizeof(count));
+		} while (ret == -1L && errno == EINTR);
+		return;
+	}
+
 	/*
 	 * Wake-up the other end by writing a null byte in the pipe
 	 * (non-blocking).  Important note: Because writing into the
@@ -531,4 +551,38 @@ extern void lib_ring_buffer_free(struct lttng_ust_lib_ring_buffer *buf,
 /* Keep track of trap nesting inside ring buffer code */
 extern DECLARE_URCU_TLS(unsigned int, lib_ring_buffer_nesting);
 
+/*
+ * Per-thread cache of the streams claimed by the current thread within
+ * RING_BUFFER_ALLOC_PER_THREAD channels. Direct-mapped on the channel
+ * address. Entries are validated against the stream owner on use, so
+ * stale entries left by destroyed channels are harmless.
+ */
+#define LIB_RING_BUFFER_THREAD_CACHE_BITS	3
+#define LIB_RING_BUFFER_THREAD_CACHE_SIZE	(1U << LIB_RING_BUFFER_THREAD_CACHE_BITS)
+
+struct lib_ring_buffer_thread_stream {
+	struct channel *chan;
+	unsigned int stream;
+	unsigned int shared:1;		/* Pool exhausted, stream is shared */
+};
+
+struct lib_ring_buffer_thread_cache {
+	int32_t tid;
+	struct lib_ring_buffer_thread_stream entries[LIB_RING_BUFFER_THREAD_CACHE_SIZE];
+};
+
+extern DECLARE_URCU_TLS(struct lib_ring_buffer_thread_cache,
+	lib_ring_buffer_thread_cache);
+
+static inline
+unsigned int lib_ring_buffer_thread_cache_hash(struct channel *chan)
+{
+	/* struct channel is cache-line aligned. */
+	return ((unsigned long) chan / CAA_CACHE_LINE_SIZE)
+		& (LIB_RING_BUFFER_THREAD_CACHE_SIZE - 1);
+}
+
+extern int lib_ring_buffer_claim_thread_stream(struct channel *chan,
+		struct lttng_ust_shm_handle *handle);
+
 #endif /* _LTTNG_RING_BUFFER_FRONTEND_INTERNAL_H */
@@ -48,7 +48,7 @@
 enum switch_mode { SWITCH_ACTIVE, SWITCH_FLUSH };
 
 /* channel: collection of per-cpu ring buffers. */
-#define RB_CHANNEL_PADDING		32
+#define RB_CHANNEL_PADDING		28
 struct channel {
 	int record_disabled;
 	unsigned long commit_count_mask;	/*
@@ -70,6 +70,7 @@ struct channel {
 	size_t priv_data_offset;
 	unsigned int nr_streams;		/* Number of streams */
 	struct lttng_ust_shm_handle *handle;
+	int shm_page_type;			/* enum shm_page_type */
 	char padding[RB_CHANNEL_PADDING];
 	/*
 	 * Associated backend contains a variable-length array. Needs to
@@ -95,7 +96,7 @@ struct commit_counters_cold {
 
 /* ring buffer state */
 #define RB_CRASH_DUMP_ABI_LEN		256
-#define RB_RING_BUFFER_PADDING		60
+#define RB_RING_BUFFER_PADDING		48
 
 #define RB_CRASH_DUMP_ABI_MAGIC_LEN	16
 
@@ -214,6 +215,17 @@ struct lttng_ust_lib_ring_buffer {
 	unsigned int get_subbuf:1;	/* Sub-buffer being held by reader */
 	/* shmp pointer to self */
 	DECLARE_SHMP(struct lttng_ust_lib_ring_buffer, self);
+	int32_t owner_tid;		/*
+					 * Thread owning the stream
+					 * (RING_BUFFER_ALLOC_PER_THREAD),
+					 * 0 if unclaimed, -1 while being
+					 * claimed.
+					 */
+	int32_t owner_pid;		/* Process of the owner thread */
+	int32_t backing_pending;	/*
+					 * Sub-buffer memory not committed
+					 * yet (lazy allocation).
+					 */
 	char padding[RB_RING_BUFFER_PADDING];
 } __attribute__((aligned(CAA_CACHE_LINE_SIZE)));
 
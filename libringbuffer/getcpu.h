@@ -22,6 +22,7 @@
 #include <urcu/compiler.h>
 #include <urcu/system.h>
 #include <urcu/arch.h>
+#include <lttng/ust-config.h>
 
 void lttng_ust_getcpu_init(void);
 
@@ -69,6 +70,30 @@ int lttng_ust_get_cpu_internal(void)
 #else /* __UCLIBC__ */
 #include <sched.h>
 
+#ifdef LTTNG_UST_HAVE_RSEQ
+#include <stdint.h>
+#include <sys/rseq.h>
+
+/*
+ * Read the current CPU number from the restartable sequences area
+ * registered by the C library for each thread. The kernel updates it
+ * when returning to user-space, so this is a plain thread-local load
+ * rather than a vDSO call. Returns a negative value if the kernel lacks
+ * rseq support or if registration has been disabled.
+ */
+static inline
+int lttng_ust_rseq_get_cpu(void)
+{
+	const struct rseq *rs;
+
+	if (caa_unlikely(!__rseq_size))
+		return -1;
+	rs = (const struct rseq *) ((char *) __builtin_thread_pointer()
+			+ __rseq_offset);
+	return (int32_t) CMM_LOAD_SHARED(rs->cpu_id);
+}
+#endif	/* LTTNG_UST_HAVE_RSEQ */
+
 /*
  * If getcpu is not implemented in the kernel, use cpu 0 as fallback.
  */
@@ -77,6 +102,11 @@ int lttng_ust_get_cpu_internal(void)
 {
 	int cpu;
 
+#ifdef LTTNG_UST_HAVE_RSEQ
+	cpu = lttng_ust_rseq_get_cpu();
+	if (caa_likely(cpu >= 0))
+		return cpu;
+#endif
 	cpu = sched_getcpu();
 	if (caa_unlikely(cpu < 0))
 		return 0;
@@ -0,0 +1,162 @@
+/*
+ * libringbuffer/memcpy_nt.c
+ *
+ * Non-temporal copy into ring buffers.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include "memcpy_nt.h"
+
+/*
+ * Number of bytes to copy with regular stores for @dest to reach
+ * @align alignment, as required by non-temporal stores.
+ */
+static inline
+size_t nt_head_len(const void *dest, size_t len, size_t align)
+{
+	size_t head = -(uintptr_t) dest & (align - 1);
+
+	return head < len ? head : len;
+}
+
+#if defined(__x86_64__)
+
+#include <immintrin.h>
+
+static
+void memcpy_nt_sse2(void *_dest, const void *_src, size_t len)
+{
+	char *dest = _dest;
+	const char *src = _src;
+	size_t head = nt_head_len(dest, len, 16);
+
+	memcpy(dest, src, head);
+	dest += head;
+	src += head;
+	len -= head;
+	for (; len >= 64; len -= 64, dest += 64, src += 64) {
+		__m128i a, b, c, d;
+
+		a = _mm_loadu_si128((const __m128i *) src);
+		b = _mm_loadu_si128((const __m128i *) (src + 16));
+		c = _mm_loadu_si128((const __m128i *) (src + 32));
+		d = _mm_loadu_si128((const __m128i *) (src + 48));
+		_mm_stream_si128((__m128i *) dest, a);
+		_mm_stream_si128((__m128i *) (dest + 16), b);
+		_mm_stream_si128((__m128i *) (dest + 32), c);
+		_mm_stream_si128((__m128i *) (dest + 48), d);
+	}
+	/* Order the weakly-ordered stores before the commit. */
+	_mm_sfence();
+	memcpy(dest, src, len);
+}
+
+static __attribute__((target("avx2")))
+void memcpy_nt_avx2(void *_dest, const void *_src, size_t len)
+{
+	char *dest = _dest;
+	const char *src = _src;
+	size_t head = nt_head_len(dest, len, 32);
+
+	memcpy(dest, src, head);
+	dest += head;
+	src += head;
+	len -= head;
+	for (; len >= 128; len -= 128, dest += 128, src += 128) {
+		__m256i a, b, c, d;
+
+		a = _mm256_loadu_si256((const __m256i *) src);
+		b = _mm256_loadu_si256((const __m256i *) (src + 32));
+		c = _mm256_loadu_si256((const __m256i *) (src + 64));
+		d = _mm256_loadu_si256((const __m256i *) (src + 96));
+		_mm256_stream_si256((__m256i *) dest, a);
+		_mm256_stream_si256((__m256i *) (dest + 32), b);
+		_mm256_stream_si256((__m256i *) (dest + 64), c);
+		_mm256_stream_si256((__m256i *) (dest + 96), d);
+	}
+	_mm_sfence();
+	memcpy(dest, src, len);
+}
+
+void (*lib_ring_buffer_memcpy_nt)(void *dest, const void *src, size_t len) =
+	memcpy_nt_sse2;
+
+/*
+ * AVX-512 is not used: it lowers the frequency of the core running the
+ * application on many parts, for little gain on memory-bound copies.
+ */
+void lib_ring_buffer_nt_init(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		lib_ring_buffer_memcpy_nt = memcpy_nt_avx2;
+}
+
+#elif defined(__aarch64__)
+
+static
+void memcpy_nt_stnp(void *_dest, const void *_src, size_t len)
+{
+	char *dest = _dest;
+	const char *src = _src;
+	size_t head = nt_head_len(dest, len, 16);
+
+	memcpy(dest, src, head);
+	dest += head;
+	src += head;
+	len -= head;
+	for (; len >= 32; len -= 32, dest += 32, src += 32) {
+		uint64_t a, b, c, d;
+
+		memcpy(&a, src, sizeof(a));
+		memcpy(&b, src + 8, sizeof(b));
+		memcpy(&c, src + 16, sizeof(c));
+		memcpy(&d, src + 24, sizeof(d));
+		__asm__ __volatile__ ("stnp %1, %2, [%0]\n\t"
+				"stnp %3, %4, [%0, #16]"
+				: : "r" (dest), "r" (a), "r" (b), "r" (c), "r" (d)
+				: "memory");
+	}
+	__asm__ __volatile__ ("dmb ishst" : : : "memory");
+	memcpy(dest, src, len);
+}
+
+void (*lib_ring_buffer_memcpy_nt)(void *dest, const void *src, size_t len) =
+	memcpy_nt_stnp;
+
+void lib_ring_buffer_nt_init(void)
+{
+}
+
+#else
+
+static
+void memcpy_nt_generic(void *dest, const void *src, size_t len)
+{
+	memcpy(dest, src, len);
+}
+
+void (*lib_ring_buffer_memcpy_nt)(void *dest, const void *src, size_t len) =
+	memcpy_nt_generic;
+
+void lib_ring_buffer_nt_init(void)
+{
+}
+
+#endif
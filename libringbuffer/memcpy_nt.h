@@ -0,0 +1,43 @@
+#ifndef _LIBRINGBUFFER_MEMCPY_NT_H
+#define _LIBRINGBUFFER_MEMCPY_NT_H
+
+/*
+ * libringbuffer/memcpy_nt.h
+ *
+ * Non-temporal copy into ring buffers.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stddef.h>
+
+/*
+ * Payloads of at least this size are copied with non-temporal stores:
+ * they are only read back by the consumer, so there is no point in
+ * evicting application data from the writer cache to hold them.
+ */
+#define LIB_RING_BUFFER_NT_COPY_THRESHOLD	1024
+
+/*
+ * Copy @len bytes with non-temporal stores to @dest, which is made
+ * visible before any later store. Selected by lib_ring_buffer_nt_init()
+ * according to the cpu features, plain memcpy if unsupported.
+ */
+extern void (*lib_ring_buffer_memcpy_nt)(void *dest, const void *src,
+		size_t len);
+
+void lib_ring_buffer_nt_init(void);
+
+#endif /* _LIBRINGBUFFER_MEMCPY_NT_H */
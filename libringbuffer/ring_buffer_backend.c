@@ -234,6 +234,47 @@ void channel_backend_reset(struct channel_backend *chanb)
 	chanb->start_tsc = config->cb.ring_buffer_clock_read(chan);
 }
 
+/**
+ * channel_backend_lazy_range - range of a stream left uncommitted
+ * @chanb: channel backend
+ * @offset: offset of the range within the stream shm object (output)
+ * @len: length of the range (output)
+ *
+ * With lazy allocation, stream memory is committed on first use, except
+ * for the control structures and the first sub-buffer page, which are
+ * written when the buffer is created. The range follows the allocation
+ * order of lib_ring_buffer_create(), with room for the extra reader
+ * sub-buffer: the sub-buffer pages may start one page earlier without
+ * it, so the range only covers sub-buffer pages in both cases. It is
+ * page aligned, and may be empty.
+ */
+void channel_backend_lazy_range(struct channel_backend *chanb,
+		size_t *offset, size_t *len)
+{
+	size_t data_offset = 0, begin, end;
+	long page_size;
+
+	*offset = 0;
+	*len = 0;
+	page_size = sysconf(_SC_PAGE_SIZE);
+	if (page_size <= 0)
+		return;
+	data_offset += sizeof(struct lttng_ust_lib_ring_buffer);
+	data_offset += offset_align(data_offset, __alignof__(struct commit_counters_hot));
+	data_offset += sizeof(struct commit_counters_hot) * chanb->num_subbuf;
+	data_offset += offset_align(data_offset, __alignof__(struct commit_counters_cold));
+	data_offset += sizeof(struct commit_counters_cold) * chanb->num_subbuf;
+	data_offset += offset_align(data_offset, __alignof__(struct lttng_ust_lib_ring_buffer_backend_pages_shmp));
+	data_offset += sizeof(struct lttng_ust_lib_ring_buffer_backend_pages_shmp) * (chanb->num_subbuf + 1);
+	data_offset += offset_align(data_offset, page_size);
+	begin = data_offset + page_size;
+	end = data_offset - page_size + chanb->subbuf_size * chanb->num_subbuf;
+	if (end <= begin)
+		return;
+	*offset = begin;
+	*len = end - begin;
+}
+
 /**
  * channel_backend_init - initialize a channel backend
  * @chanb: channel backend
@@ -329,18 +370,38 @@ int channel_backend_init(struct channel_backend *chanb,
 	shmsize += offset_align(shmsize, __alignof__(struct commit_counters_cold));
 	shmsize += sizeof(struct commit_counters_cold) * num_subbuf;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL) {
 		struct lttng_ust_lib_ring_buffer *buf;
 		/*
-		 * We need to allocate for all possible cpus.
+		 * We need to allocate for all possible cpus, or for each
+		 * stream of the per-thread pool.
 		 */
-		for_each_possible_cpu(i) {
+		size_t lazy_offset = 0, lazy_len = 0;
+
+		if (handle->table->attr.lazy_alloc)
+			channel_backend_lazy_range(chanb, &lazy_offset,
+					&lazy_len);
+		for (i = 0; i < chan->nr_streams; i++) {
 			struct shm_object *shmobj;
+			int cpu = -1;
 
+			/* Per-cpu buffers are placed on the cpu memory node. */
+			if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+				cpu = i;
 			shmobj = shm_object_table_alloc(handle->table, shmsize,
-					SHM_OBJECT_SHM, stream_fds[i]);
+					SHM_OBJECT_SHM, stream_fds[i], cpu);
 			if (!shmobj)
 				goto end;
+			if (handle->table->attr.lazy_alloc) {
+				/* Commit all but the sub-buffer pages. */
+				size_t lazy_end = lazy_offset + lazy_len;
+
+				if (shm_object_commit(shmobj, 0, lazy_offset))
+					goto end;
+				if (shm_object_commit(shmobj, lazy_end,
+						shmobj->memory_map_size - lazy_end))
+					goto end;
+			}
 			align_shm(shmobj, __alignof__(struct lttng_ust_lib_ring_buffer));
 			set_shmp(chanb->buf[i].shmp, zalloc_shm(shmobj, sizeof(struct lttng_ust_lib_ring_buffer)));
 			buf = shmp(handle, chanb->buf[i].shmp);
@@ -351,13 +412,15 @@ int channel_backend_init(struct channel_backend *chanb,
 					handle, shmobj);
 			if (ret)
 				goto free_bufs;	/* cpu hotplug locked */
+			if (lazy_len)
+				buf->backing_pending = 1;
 		}
 	} else {
 		struct shm_object *shmobj;
 		struct lttng_ust_lib_ring_buffer *buf;
 
 		shmobj = shm_object_table_alloc(handle->table, shmsize,
-					SHM_OBJECT_SHM, stream_fds[0]);
+					SHM_OBJECT_SHM, stream_fds[0], -1);
 		if (!shmobj)
 			goto end;
 		align_shm(shmobj, __alignof__(struct lttng_ust_lib_ring_buffer));
@@ -64,6 +64,7 @@
 #include <urcu/tls-compat.h>
 #include <poll.h>
 #include <helper.h>
+#include <lttng/ust-tid.h>
 
 #include "smp.h"
 #include <lttng/ringbuffer-config.h>
@@ -120,6 +121,8 @@ struct switch_offsets {
 };
 
 DEFINE_URCU_TLS(unsigned int, lib_ring_buffer_nesting);
+DEFINE_URCU_TLS(struct lib_ring_buffer_thread_cache,
+	lib_ring_buffer_thread_cache);
 
 /*
  * wakeup_fd_mutex protects wakeup fd use by timer from concurrent
@@ -400,8 +403,8 @@ void lib_ring_buffer_channel_switch_timer(int sig, siginfo_t *si, void *uc)
 	 * Only flush buffers periodically if readers are active.
 	 */
 	pthread_mutex_lock(&wakeup_fd_mutex);
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
-		for_each_possible_cpu(cpu) {
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL) {
+		for_each_channel_stream(cpu, chan) {
 			struct lttng_ust_lib_ring_buffer *buf =
 				shmp(handle, chan->backend.buf[cpu].shmp);
 
@@ -439,8 +442,8 @@ void lib_ring_buffer_channel_do_read(struct channel *chan)
 	 * Only flush buffers periodically if readers are active.
 	 */
 	pthread_mutex_lock(&wakeup_fd_mutex);
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
-		for_each_possible_cpu(cpu) {
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL) {
+		for_each_channel_stream(cpu, chan) {
 			struct lttng_ust_lib_ring_buffer *buf =
 				shmp(handle, chan->backend.buf[cpu].shmp);
 
@@ -747,8 +750,8 @@ static void channel_print_errors(struct channel *chan,
 			&chan->backend.config;
 	int cpu;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
-		for_each_possible_cpu(cpu) {
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL) {
+		for_each_channel_stream(cpu, chan) {
 			struct lttng_ust_lib_ring_buffer *buf =
 				shmp(handle, chan->backend.buf[cpu].shmp);
 			lib_ring_buffer_print_errors(chan, buf, cpu, handle);
@@ -770,6 +773,34 @@ static void channel_free(struct channel *chan,
 	free(handle);
 }
 
+/**
+ * lib_ring_buffer_commit_backing - commit lazily allocated buffer memory
+ * @buf: buffer
+ * @chan: channel
+ * @handle: shared memory handle
+ *
+ * Called on first use of a buffer created with lazy allocation.
+ * Concurrent callers commit the same range, which is harmless.
+ * Returns 0 on success, a negative error value (e.g. -ENOSPC) if the
+ * memory cannot be committed, in which case the buffer stays unused.
+ */
+int lib_ring_buffer_commit_backing(struct lttng_ust_lib_ring_buffer *buf,
+		struct channel *chan, struct lttng_ust_shm_handle *handle)
+{
+	struct shm_object_table *table = handle->table;
+	size_t index = buf->self._ref.index, offset, len;
+	int ret;
+
+	if (index >= table->allocated_len)
+		return -EPERM;
+	channel_backend_lazy_range(&chan->backend, &offset, &len);
+	ret = shm_object_commit(&table->objects[index], offset, len);
+	if (ret)
+		return ret;
+	CMM_STORE_SHARED(buf->backing_pending, 0);
+	return 0;
+}
+
 /**
  * channel_create - Create channel.
  * @config: ring buffer instance configuration
@@ -788,6 +819,7 @@ static void channel_free(struct channel *chan,
  * @read_timer_interval: Time interval (in us) to wake up pending readers.
  * @stream_fds: array of stream file descriptors.
  * @nr_stream_fds: number of file descriptors in array.
+ * @shm_attr: stream shm object allocation attributes, NULL for defaults.
  *
  * Holds cpu hotplug.
  * Returns NULL on failure.
@@ -801,7 +833,8 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 		   void *buf_addr, size_t subbuf_size,
 		   size_t num_subbuf, unsigned int switch_timer_interval,
 		   unsigned int read_timer_interval,
-		   const int *stream_fds, int nr_stream_fds)
+		   const int *stream_fds, int nr_stream_fds,
+		   const struct lttng_ust_shm_attr *shm_attr)
 {
 	int ret;
 	size_t shmsize, chansize;
@@ -810,10 +843,20 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 	struct shm_object *shmobj;
 	unsigned int nr_streams;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	switch (config->alloc) {
+	case RING_BUFFER_ALLOC_PER_CPU:
 		nr_streams = num_possible_cpus();
-	else
+		break;
+	case RING_BUFFER_ALLOC_PER_THREAD:
+		/* Stream pool size is chosen by the caller. */
+		if (nr_stream_fds <= 0)
+			return NULL;
+		nr_streams = nr_stream_fds;
+		break;
+	default:
 		nr_streams = 1;
+		break;
+	}
 
 	if (nr_stream_fds != nr_streams)
 		return NULL;
@@ -827,9 +870,12 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 		return NULL;
 
 	/* Allocate table for channel + per-cpu buffers */
-	handle->table = shm_object_table_create(1 + num_possible_cpus());
+	handle->table = shm_object_table_create(1 + max_t(unsigned int,
+				nr_streams, num_possible_cpus()));
 	if (!handle->table)
 		goto error_table_alloc;
+	if (shm_attr)
+		handle->table->attr = *shm_attr;
 
 	/* Calculate the shm allocation layout */
 	shmsize = sizeof(struct channel);
@@ -842,7 +888,7 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 
 	/* Allocate normal memory for channel (not shared) */
 	shmobj = shm_object_table_alloc(handle->table, shmsize, SHM_OBJECT_MEM,
-			-1);
+			-1, -1);
 	if (!shmobj)
 		goto error_append;
 	/* struct channel is at object 0, offset 0 (hardcoded) */
@@ -853,6 +899,7 @@ struct lttng_ust_shm_handle *channel_create(const struct lttng_ust_lib_ring_buff
 	if (!chan)
 		goto error_append;
 	chan->nr_streams = nr_streams;
+	chan->shm_page_type = handle->table->attr.page_type;
 
 	/* space for private data */
 	if (priv_data_size) {
@@ -901,15 +948,28 @@ struct lttng_ust_shm_handle *channel_handle_create(void *data,
 {
 	struct lttng_ust_shm_handle *handle;
 	struct shm_object *object;
+	unsigned int nr_streams;
+
+	if (memory_map_size < sizeof(struct channel))
+		return NULL;
+	/*
+	 * struct channel is at offset 0 of the channel data. The
+	 * per-thread stream pool may be larger than the number of
+	 * possible cpus.
+	 */
+	nr_streams = ((struct channel *) data)->nr_streams;
 
 	handle = zmalloc(sizeof(struct lttng_ust_shm_handle));
 	if (!handle)
 		return NULL;
 
 	/* Allocate table for channel + per-cpu buffers */
-	handle->table = shm_object_table_create(1 + num_possible_cpus());
+	handle->table = shm_object_table_create(1 + max_t(unsigned int,
+				nr_streams, num_possible_cpus()));
 	if (!handle->table)
 		goto error_table_alloc;
+	/* Streams are mapped according to the consumer page type. */
+	handle->table->attr.page_type = ((struct channel *) data)->shm_page_type;
 	/* Add channel object */
 	object = shm_object_table_append_mem(handle->table, data,
 			memory_map_size, wakeup_fd);
@@ -1000,7 +1060,7 @@ struct lttng_ust_lib_ring_buffer *channel_get_ring_buffer(
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
 		cpu = 0;
 	} else {
-		if (cpu >= num_possible_cpus())
+		if (cpu >= chan->nr_streams)
 			return NULL;
 	}
 	ref = &chan->backend.buf[cpu].shmp._ref;
@@ -1042,7 +1102,7 @@ int ring_buffer_stream_close_wait_fd(const struct lttng_ust_lib_ring_buffer_conf
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
 		cpu = 0;
 	} else {
-		if (cpu >= num_possible_cpus())
+		if (cpu >= chan->nr_streams)
 			return -EINVAL;
 	}
 	ref = &chan->backend.buf[cpu].shmp._ref;
@@ -1060,7 +1120,7 @@ int ring_buffer_stream_close_wakeup_fd(const struct lttng_ust_lib_ring_buffer_co
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
 		cpu = 0;
 	} else {
-		if (cpu >= num_possible_cpus())
+		if (cpu >= chan->nr_streams)
 			return -EINVAL;
 	}
 	ref = &chan->backend.buf[cpu].shmp._ref;
@@ -1744,6 +1804,17 @@ void lib_ring_buffer_switch_slow(struct lttng_ust_lib_ring_buffer *buf, enum swi
 	unsigned long oldidx;
 	uint64_t tsc;
 
+	/*
+	 * Nothing was written to a buffer whose memory is not committed:
+	 * only commit it for explicit flushes.
+	 */
+	if (caa_unlikely(CMM_LOAD_SHARED(buf->backing_pending))) {
+		if (mode != SWITCH_FLUSH)
+			return;
+		if (lib_ring_buffer_commit_backing(buf, chan, handle))
+			return;
+	}
+
 	offsets.size = 0;
 
 	/*
@@ -1971,6 +2042,121 @@ retry:
 	return 0;
 }
 
+/*
+ * Returns 1 if thread @tid of process @pid has exited, 0 otherwise.
+ */
+static
+int lib_ring_buffer_thread_exited(pid_t pid, pid_t tid)
+{
+#ifdef __NR_tgkill
+	if (syscall(__NR_tgkill, pid, tid, 0) < 0 && errno == ESRCH)
+		return 1;
+#endif
+	return 0;
+}
+
+/*
+ * Claim stream @buf from @owner, 0 if unclaimed. The owner tid is held at
+ * -1 while the owner pid is updated, so that readers of both see a
+ * consistent pair: per-UID buffers are shared by threads of different
+ * processes. Returns 1 on success, 0 if another thread claimed it.
+ */
+static
+int lib_ring_buffer_claim_owner(struct lttng_ust_lib_ring_buffer *buf,
+		int32_t owner, int32_t pid, int32_t tid)
+{
+	if (uatomic_cmpxchg(&buf->owner_tid, owner, -1) != owner)
+		return 0;
+	CMM_STORE_SHARED(buf->owner_pid, pid);
+	cmm_smp_wmb();
+	CMM_STORE_SHARED(buf->owner_tid, tid);
+	return 1;
+}
+
+/*
+ * Read the owner of stream @buf into @pid and @tid. Returns 0 if the
+ * stream is unclaimed or being claimed.
+ */
+static
+int lib_ring_buffer_read_owner(struct lttng_ust_lib_ring_buffer *buf,
+		int32_t *pid, int32_t *tid)
+{
+	*tid = CMM_LOAD_SHARED(buf->owner_tid);
+	if (*tid <= 0)
+		return 0;
+	cmm_smp_rmb();
+	*pid = CMM_LOAD_SHARED(buf->owner_pid);
+	cmm_smp_rmb();
+	return CMM_LOAD_SHARED(buf->owner_tid) == *tid;
+}
+
+/**
+ * lib_ring_buffer_claim_thread_stream - Claim a stream for current thread.
+ * @chan: RING_BUFFER_ALLOC_PER_THREAD channel.
+ * @handle: shared memory handle.
+ *
+ * Slow path of lib_ring_buffer_get_thread_stream(). Looks for a stream
+ * already owned by the current thread, else claims an unused stream of
+ * the pool, else reclaims a stream owned by an exited thread. Streams
+ * are never released explicitly: doing so from a thread exit handler
+ * would race with channel teardown. When the pool is exhausted, the
+ * current thread shares a stream with other threads, which is safe
+ * because per-thread channels use global synchronization.
+ *
+ * Returns the stream index, or -EIO on error.
+ */
+int lib_ring_buffer_claim_thread_stream(struct channel *chan,
+		struct lttng_ust_shm_handle *handle)
+{
+	struct lib_ring_buffer_thread_stream *entry;
+	struct lttng_ust_lib_ring_buffer *buf;
+	int32_t pid, tid, owner_pid, owner;
+	unsigned int i;
+	int free_stream, shared = 0;
+
+	pid = getpid();
+	tid = gettid();
+	URCU_TLS(lib_ring_buffer_thread_cache).tid = tid;
+
+retry:
+	free_stream = -1;
+	for_each_channel_stream(i, chan) {
+		buf = shmp(handle, chan->backend.buf[i].shmp);
+		if (!buf)
+			return -EIO;
+		if (lib_ring_buffer_read_owner(buf, &owner_pid, &owner)
+				&& owner == tid && owner_pid == pid)
+			goto found;
+		if (!owner && free_stream < 0)
+			free_stream = i;
+	}
+	if (free_stream >= 0) {
+		i = free_stream;
+		buf = shmp(handle, chan->backend.buf[i].shmp);
+		if (lib_ring_buffer_claim_owner(buf, 0, pid, tid))
+			goto found;
+		/* Raced with another thread, which claimed a stream. */
+		goto retry;
+	}
+	for_each_channel_stream(i, chan) {
+		buf = shmp(handle, chan->backend.buf[i].shmp);
+		if (!lib_ring_buffer_read_owner(buf, &owner_pid, &owner)
+				|| !lib_ring_buffer_thread_exited(owner_pid, owner))
+			continue;
+		if (lib_ring_buffer_claim_owner(buf, owner, pid, tid))
+			goto found;
+	}
+	i = (uint32_t) tid % chan->nr_streams;
+	shared = 1;
+found:
+	entry = &URCU_TLS(lib_ring_buffer_thread_cache).entries[
+			lib_ring_buffer_thread_cache_hash(chan)];
+	entry->chan = chan;
+	entry->stream = i;
+	entry->shared = shared;
+	return i;
+}
+
 /**
  * lib_ring_buffer_reserve_slow - Atomic slot reservation in a buffer.
  * @ctx: ring buffer context.
@@ -1988,7 +2174,7 @@ int lib_ring_buffer_reserve_slow(struct lttng_ust_lib_ring_buffer_ctx *ctx)
 	struct switch_offsets offsets;
 	int ret;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	if (config->alloc != RING_BUFFER_ALLOC_GLOBAL)
 		buf = shmp(handle, chan->backend.buf[ctx->cpu].shmp);
 	else
 		buf = shmp(handle, chan->backend.buf[0].shmp);
@@ -2056,6 +2242,7 @@ int lib_ring_buffer_reserve_slow(struct lttng_ust_lib_ring_buffer_ctx *ctx)
 void lttng_fixup_ringbuffer_tls(void)
 {
 	asm volatile ("" : : "m" (URCU_TLS(lib_ring_buffer_nesting)));
+	asm volatile ("" : : "m" (URCU_TLS(lib_ring_buffer_thread_cache)));
 }
 
 void lib_ringbuffer_signal_init(void)
@@ -18,12 +18,16 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE
 #include "shm.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>	/* For mode constants */
+#include <sys/eventfd.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
 #include <fcntl.h>	/* For O_* constants */
 #include <assert.h>
 #include <stdio.h>
@@ -32,6 +36,28 @@
 #include <lttng/align.h>
 #include <limits.h>
 #include <helper.h>
+#include "smp.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC		0x0001U
+#endif
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB		0x0004U
+#endif
+#ifndef HUGETLBFS_MAGIC
+#define HUGETLBFS_MAGIC		0x958458f6
+#endif
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE		14
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE	23
+#endif
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED		1
+#endif
+
+#define SHM_MAX_NUMA_NODES	1024
 
 /*
  * Ensure we have the required amount of space available by writing 0
@@ -83,20 +109,29 @@ struct shm_object_table *shm_object_table_create(size_t max_nb_obj)
 	return table;
 }
 
+/*
+ * Create the wait/wakeup file descriptors of a shm object. When an
+ * eventfd is requested, a single eventfd is used for both ends, which
+ * falls back on a pipe if eventfd is unavailable.
+ * Returns 0 on success, -1 on error.
+ */
 static
-struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
-					   size_t memory_map_size,
-					   int stream_fd)
+int shm_object_wait_fd_create(struct shm_object *obj,
+		enum shm_wakeup_type wakeup_type)
 {
-	int shmfd, waitfd[2], ret, i;
-	struct shm_object *obj;
-	char *memory_map;
-
-	if (stream_fd < 0)
-		return NULL;
-	if (table->allocated_len >= table->size)
-		return NULL;
-	obj = &table->objects[table->allocated_len];
+	int waitfd[2], ret, i;
+
+	if (wakeup_type == SHM_WAKEUP_EVENTFD) {
+		ret = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (ret >= 0) {
+			obj->wait_fd[0] = ret;
+			obj->wait_fd[1] = ret;
+			obj->wakeup_type = SHM_WAKEUP_EVENTFD;
+			return 0;
+		}
+		PERROR("eventfd");
+		/* Fallback on pipe. */
+	}
 
 	/* wait_fd: create pipe */
 	ret = pipe(waitfd);
@@ -118,50 +153,289 @@ struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
 		goto error_fcntl;
 	}
 	memcpy(obj->wait_fd, waitfd, sizeof(waitfd));
+	obj->wakeup_type = SHM_WAKEUP_PIPE;
+	return 0;
+
+error_fcntl:
+	for (i = 0; i < 2; i++) {
+		ret = close(waitfd[i]);
+		if (ret) {
+			PERROR("close");
+			assert(0);
+		}
+	}
+error_pipe:
+	return -1;
+}
+
+static
+void shm_object_wait_fd_close(struct shm_object *obj)
+{
+	int ret, i;
 
-	/* create shm */
+	for (i = 0; i < 2; i++) {
+		if (obj->wait_fd[i] < 0)
+			continue;
+		/* An eventfd is shared by both ends. */
+		if (i == 1 && obj->wait_fd[1] == obj->wait_fd[0])
+			continue;
+		ret = close(obj->wait_fd[i]);
+		if (ret) {
+			PERROR("close");
+			assert(0);
+		}
+	}
+}
 
-	shmfd = stream_fd;
-	ret = zero_file(shmfd, memory_map_size);
+/*
+ * Prefer allocating the pages of @memory_map from memory node @node.
+ * On shmem, this sets the shared policy of the file, which also applies
+ * to pages allocated through write(). Must be called before populating
+ * the mapping. Returns the node, or -1 if the mapping is not bound.
+ */
+static
+int shm_bind_node(char *memory_map, size_t len, int node)
+{
+#ifdef __NR_mbind
+	unsigned long nodemask[SHM_MAX_NUMA_NODES / CAA_BITS_PER_LONG];
+	long ret;
+
+	if (node < 0 || node >= SHM_MAX_NUMA_NODES)
+		return -1;
+	memset(nodemask, 0, sizeof(nodemask));
+	nodemask[node / CAA_BITS_PER_LONG] |= 1UL << (node % CAA_BITS_PER_LONG);
+	/* The kernel expects the mask size plus one. */
+	ret = syscall(__NR_mbind, memory_map, len, MPOL_PREFERRED,
+			nodemask, SHM_MAX_NUMA_NODES + 1, 0);
 	if (ret) {
-		PERROR("zero_file");
-		goto error_zero_file;
+		DBG("mbind to node %d failed: %s", node, strerror(errno));
+		return -1;
 	}
-	ret = ftruncate(shmfd, memory_map_size);
+	return node;
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Huge page size of a hugetlbfs file, 0 if @fd is not on hugetlbfs.
+ */
+static
+size_t shm_hugetlb_page_size(int fd)
+{
+	struct statfs buf;
+
+	if (fstatfs(fd, &buf) < 0 || buf.f_type != HUGETLBFS_MAGIC)
+		return 0;
+	return buf.f_bsize;
+}
+
+/*
+ * Map @stream_fd backed by hugetlb pages. Unless the stream file is on
+ * hugetlbfs already, it is replaced, keeping its descriptor number and
+ * flags, by an anonymous MFD_HUGETLB memfd. Shared hugetlb mappings
+ * reserve their pages at mmap time, so there is no need to zero the
+ * file, only to fault the pages in. The map size is rounded up to the
+ * huge page size.
+ * Returns NULL if huge pages are unavailable, leaving @stream_fd
+ * untouched.
+ */
+static
+char *shm_map_hugetlb(int stream_fd, size_t *memory_map_size,
+		size_t *page_size, int *node, int populate)
+{
+	size_t hpage_size, len, offset;
+	char *memory_map;
+	int fd, flags, ret;
+
+	if (shm_hugetlb_page_size(stream_fd)) {
+		fd = stream_fd;
+	} else {
+#ifdef __NR_memfd_create
+		fd = syscall(__NR_memfd_create, "lttng-ust-shm",
+				MFD_CLOEXEC | MFD_HUGETLB);
+		if (fd < 0)
+			return NULL;
+#else
+		return NULL;
+#endif
+	}
+	hpage_size = shm_hugetlb_page_size(fd);
+	if (!hpage_size)
+		goto error;
+	len = ALIGN(*memory_map_size, hpage_size);
+	ret = ftruncate(fd, len);
+	if (ret)
+		goto error;
+	memory_map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, fd, 0);
+	if (memory_map == MAP_FAILED)
+		goto error;
+	*node = shm_bind_node(memory_map, len, *node);
+	for (offset = 0; populate && offset < len; offset += hpage_size)
+		memory_map[offset] = 0;
+	if (fd != stream_fd) {
+		flags = fcntl(stream_fd, F_GETFD);
+		if (flags < 0 || dup2(fd, stream_fd) < 0
+				|| fcntl(stream_fd, F_SETFD, flags) < 0) {
+			PERROR("dup2");
+			ret = munmap(memory_map, len);
+			assert(!ret);
+			goto error;
+		}
+		ret = close(fd);
+		assert(!ret);
+	}
+	*memory_map_size = len;
+	*page_size = hpage_size;
+	return memory_map;
+
+error:
+	if (fd != stream_fd) {
+		ret = close(fd);
+		assert(!ret);
+	}
+	return NULL;
+}
+
+/*
+ * Map @stream_fd with transparent huge pages advised. The file must be
+ * populated through the mapping for the advice to apply, falling back
+ * on zeroing it with write() on kernels without MADV_POPULATE_WRITE.
+ */
+static
+char *shm_map_thp(int stream_fd, size_t memory_map_size, int *node,
+		int populate)
+{
+	char *memory_map;
+	int ret;
+
+	ret = ftruncate(stream_fd, memory_map_size);
 	if (ret) {
 		PERROR("ftruncate");
-		goto error_ftruncate;
+		return NULL;
 	}
-	obj->shm_fd_ownership = 0;
-	obj->shm_fd = shmfd;
+	memory_map = mmap(NULL, memory_map_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, stream_fd, 0);
+	if (memory_map == MAP_FAILED) {
+		PERROR("mmap");
+		return NULL;
+	}
+	/* Advisory only, e.g. THP disabled for shmem. */
+	(void) madvise(memory_map, memory_map_size, MADV_HUGEPAGE);
+	*node = shm_bind_node(memory_map, memory_map_size, *node);
+	if (!populate)
+		return memory_map;
+	ret = madvise(memory_map, memory_map_size, MADV_POPULATE_WRITE);
+	if (ret && errno == EINVAL)
+		ret = zero_file(stream_fd, memory_map_size);
+	if (ret) {
+		PERROR("populate");
+		ret = munmap(memory_map, memory_map_size);
+		assert(!ret);
+		return NULL;
+	}
+	return memory_map;
+}
 
-	/* memory_map: mmap */
+/*
+ * The file is sized and mapped before being zeroed, so the memory node
+ * policy applies to the zeroed pages.
+ */
+static
+char *shm_map_default(int stream_fd, size_t memory_map_size, int *node,
+		int populate)
+{
+	char *memory_map;
+	int ret;
+
+	ret = ftruncate(stream_fd, memory_map_size);
+	if (ret) {
+		PERROR("ftruncate");
+		return NULL;
+	}
 	memory_map = mmap(NULL, memory_map_size, PROT_READ | PROT_WRITE,
-			  MAP_SHARED, shmfd, 0);
+			  MAP_SHARED, stream_fd, 0);
 	if (memory_map == MAP_FAILED) {
 		PERROR("mmap");
-		goto error_mmap;
+		return NULL;
+	}
+	*node = shm_bind_node(memory_map, memory_map_size, *node);
+	if (!populate)
+		return memory_map;
+	ret = zero_file(stream_fd, memory_map_size);
+	if (ret) {
+		PERROR("zero_file");
+		ret = munmap(memory_map, memory_map_size);
+		assert(!ret);
+		return NULL;
+	}
+	return memory_map;
+}
+
+static
+struct shm_object *_shm_object_table_alloc_shm(struct shm_object_table *table,
+					   size_t memory_map_size,
+					   int stream_fd, int cpu)
+{
+	struct shm_object *obj;
+	char *memory_map = NULL;
+	size_t page_size = PAGE_SIZE;
+	int ret, node = -1, populate;
+
+	if (stream_fd < 0)
+		return NULL;
+	if (table->allocated_len >= table->size)
+		return NULL;
+	obj = &table->objects[table->allocated_len];
+
+	ret = shm_object_wait_fd_create(obj, table->attr.wakeup_type);
+	if (ret)
+		goto error_wait_fd;
+
+	if (cpu >= 0)
+		node = cpu_to_node(cpu);
+	/* Lazy allocation commits the memory with shm_object_commit(). */
+	populate = !table->attr.lazy_alloc;
+
+	/* create shm, memory_map: mmap */
+	switch (table->attr.page_type) {
+	case SHM_PAGE_HUGETLB:
+		memory_map = shm_map_hugetlb(stream_fd, &memory_map_size,
+				&page_size, &node, populate);
+		if (!memory_map)
+			DBG("Huge pages unavailable, using base pages for stream shm");
+		break;
+	case SHM_PAGE_THP:
+		memory_map = shm_map_thp(stream_fd, memory_map_size, &node,
+				populate);
+		if (!memory_map)
+			goto error_mmap;
+		break;
+	case SHM_PAGE_DEFAULT:
+		break;
+	}
+	if (!memory_map) {
+		memory_map = shm_map_default(stream_fd, memory_map_size, &node,
+				populate);
+		if (!memory_map)
+			goto error_mmap;
 	}
+	obj->shm_fd_ownership = 0;
+	obj->shm_fd = stream_fd;
 	obj->type = SHM_OBJECT_SHM;
 	obj->memory_map = memory_map;
 	obj->memory_map_size = memory_map_size;
+	obj->page_size = page_size;
+	obj->numa_node = node;
 	obj->allocated_len = 0;
 	obj->index = table->allocated_len++;
 
 	return obj;
 
 error_mmap:
-error_ftruncate:
-error_zero_file:
-error_fcntl:
-	for (i = 0; i < 2; i++) {
-		ret = close(waitfd[i]);
-		if (ret) {
-			PERROR("close");
-			assert(0);
-		}
-	}
-error_pipe:
+	shm_object_wait_fd_close(obj);
+error_wait_fd:
 	return NULL;
 }
 
@@ -171,7 +445,7 @@ struct shm_object *_shm_object_table_alloc_mem(struct shm_object_table *table,
 {
 	struct shm_object *obj;
 	void *memory_map;
-	int waitfd[2], i, ret;
+	int ret;
 
 	if (table->allocated_len >= table->size)
 		return NULL;
@@ -181,26 +455,10 @@ struct shm_object *_shm_object_table_alloc_mem(struct shm_object_table *table,
 	if (!memory_map)
 		goto alloc_error;
 
-	/* wait_fd: create pipe */
-	ret = pipe(waitfd);
-	if (ret < 0) {
-		PERROR("pipe");
-		goto error_pipe;
-	}
-	for (i = 0; i < 2; i++) {
-		ret = fcntl(waitfd[i], F_SETFD, FD_CLOEXEC);
-		if (ret < 0) {
-			PERROR("fcntl");
-			goto error_fcntl;
-		}
-	}
-	/* The write end of the pipe needs to be non-blocking */
-	ret = fcntl(waitfd[1], F_SETFL, O_NONBLOCK);
-	if (ret < 0) {
-		PERROR("fcntl");
-		goto error_fcntl;
-	}
-	memcpy(obj->wait_fd, waitfd, sizeof(waitfd));
+	/* The channel wakeup is always a pipe. */
+	ret = shm_object_wait_fd_create(obj, SHM_WAKEUP_PIPE);
+	if (ret)
+		goto error_wait_fd;
 
 	/* no shm_fd */
 	obj->shm_fd = -1;
@@ -209,20 +467,14 @@ struct shm_object *_shm_object_table_alloc_mem(struct shm_object_table *table,
 	obj->type = SHM_OBJECT_MEM;
 	obj->memory_map = memory_map;
 	obj->memory_map_size = memory_map_size;
+	obj->page_size = PAGE_SIZE;
+	obj->numa_node = -1;
 	obj->allocated_len = 0;
 	obj->index = table->allocated_len++;
 
 	return obj;
 
-error_fcntl:
-	for (i = 0; i < 2; i++) {
-		ret = close(waitfd[i]);
-		if (ret) {
-			PERROR("close");
-			assert(0);
-		}
-	}
-error_pipe:
+error_wait_fd:
 	free(memory_map);
 alloc_error:
 	return NULL;
@@ -231,12 +483,13 @@ alloc_error:
 struct shm_object *shm_object_table_alloc(struct shm_object_table *table,
 			size_t memory_map_size,
 			enum shm_object_type type,
-			int stream_fd)
+			int stream_fd,
+			int cpu)
 {
 	switch (type) {
 	case SHM_OBJECT_SHM:
 		return _shm_object_table_alloc_shm(table, memory_map_size,
-				stream_fd);
+				stream_fd, cpu);
 	case SHM_OBJECT_MEM:
 		return _shm_object_table_alloc_mem(table, memory_map_size);
 	default:
@@ -250,7 +503,9 @@ struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 			size_t memory_map_size)
 {
 	struct shm_object *obj;
+	struct stat statbuf;
 	char *memory_map;
+	size_t page_size;
 	int ret;
 
 	if (table->allocated_len >= table->size)
@@ -261,12 +516,26 @@ struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 
 	obj = &table->objects[table->allocated_len];
 
-	/* wait_fd: set write end of the pipe. */
+	/* wait_fd: set write end of the pipe, or the eventfd. */
 	obj->wait_fd[0] = -1;	/* read end is unset */
 	obj->wait_fd[1] = wakeup_fd;
 	obj->shm_fd = shm_fd;
 	obj->shm_fd_ownership = 1;
 
+	/*
+	 * The consumer chooses the wakeup mechanism: anything else than
+	 * a pipe is an eventfd.
+	 */
+	ret = fstat(wakeup_fd, &statbuf);
+	if (ret < 0) {
+		PERROR("fstat");
+		goto error_fcntl;
+	}
+	if (S_ISFIFO(statbuf.st_mode))
+		obj->wakeup_type = SHM_WAKEUP_PIPE;
+	else
+		obj->wakeup_type = SHM_WAKEUP_EVENTFD;
+
 	ret = fcntl(obj->wait_fd[1], F_SETFD, FD_CLOEXEC);
 	if (ret < 0) {
 		PERROR("fcntl");
@@ -286,9 +555,15 @@ struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 		PERROR("mmap");
 		goto error_mmap;
 	}
+	/* The writer needs the advice on its own mapping. */
+	if (table->attr.page_type == SHM_PAGE_THP)
+		(void) madvise(memory_map, memory_map_size, MADV_HUGEPAGE);
+	page_size = shm_hugetlb_page_size(shm_fd);
 	obj->type = SHM_OBJECT_SHM;
 	obj->memory_map = memory_map;
 	obj->memory_map_size = memory_map_size;
+	obj->page_size = page_size ? page_size : PAGE_SIZE;
+	obj->numa_node = -1;
 	obj->allocated_len = memory_map_size;
 	obj->index = table->allocated_len++;
 
@@ -314,6 +589,7 @@ struct shm_object *shm_object_table_append_mem(struct shm_object_table *table,
 
 	obj->wait_fd[0] = -1;	/* read end is unset */
 	obj->wait_fd[1] = wakeup_fd;
+	obj->wakeup_type = SHM_WAKEUP_PIPE;
 	obj->shm_fd = -1;
 	obj->shm_fd_ownership = 0;
 
@@ -332,6 +608,8 @@ struct shm_object *shm_object_table_append_mem(struct shm_object_table *table,
 	obj->type = SHM_OBJECT_MEM;
 	obj->memory_map = mem;
 	obj->memory_map_size = memory_map_size;
+	obj->page_size = PAGE_SIZE;
+	obj->numa_node = -1;
 	obj->allocated_len = memory_map_size;
 	obj->index = table->allocated_len++;
 
@@ -347,7 +625,7 @@ void shmp_object_destroy(struct shm_object *obj)
 	switch (obj->type) {
 	case SHM_OBJECT_SHM:
 	{
-		int ret, i;
+		int ret;
 
 		ret = munmap(obj->memory_map, obj->memory_map_size);
 		if (ret) {
@@ -361,30 +639,12 @@ void shmp_object_destroy(struct shm_object *obj)
 				assert(0);
 			}
 		}
-		for (i = 0; i < 2; i++) {
-			if (obj->wait_fd[i] < 0)
-				continue;
-			ret = close(obj->wait_fd[i]);
-			if (ret) {
-				PERROR("close");
-				assert(0);
-			}
-		}
+		shm_object_wait_fd_close(obj);
 		break;
 	}
 	case SHM_OBJECT_MEM:
 	{
-		int ret, i;
-
-		for (i = 0; i < 2; i++) {
-			if (obj->wait_fd[i] < 0)
-				continue;
-			ret = close(obj->wait_fd[i]);
-			if (ret) {
-				PERROR("close");
-				assert(0);
-			}
-		}
+		shm_object_wait_fd_close(obj);
 		free(obj->memory_map);
 		break;
 	}
@@ -393,6 +653,35 @@ void shmp_object_destroy(struct shm_object *obj)
 	}
 }
 
+/*
+ * Commit the memory backing a range of a shm object, allocating its
+ * pages so that later accesses cannot fault with SIGBUS. Falls back on
+ * populating the mapping if the file system does not support
+ * fallocate, and on faulting pages on first access if the kernel cannot
+ * populate mappings either. @offset must be page aligned.
+ * Returns 0 on success, a negative error value (e.g. -ENOSPC) if the
+ * memory cannot be allocated.
+ */
+int shm_object_commit(struct shm_object *obj, size_t offset, size_t len)
+{
+	int ret;
+
+	if (!len)
+		return 0;
+	if (obj->type != SHM_OBJECT_SHM
+			|| offset + len > obj->memory_map_size)
+		return -EINVAL;
+	ret = fallocate(obj->shm_fd, 0, offset, len);
+	if (!ret)
+		return 0;
+	if (errno != EOPNOTSUPP && errno != ENOSYS)
+		return -errno;
+	ret = madvise(obj->memory_map + offset, len, MADV_POPULATE_WRITE);
+	if (!ret || errno == EINVAL)
+		return 0;
+	return -errno;
+}
+
 void shm_object_table_destroy(struct shm_object_table *table)
 {
 	int i;
@@ -89,7 +89,8 @@ struct shm_object_table *shm_object_table_create(size_t max_nb_obj);
 struct shm_object *shm_object_table_alloc(struct shm_object_table *table,
 			size_t memory_map_size,
 			enum shm_object_type type,
-			const int stream_fd);
+			const int stream_fd,
+			int cpu);
 struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 			int shm_fd, int wakeup_fd, uint32_t stream_nr,
 			size_t memory_map_size);
@@ -97,6 +98,7 @@ struct shm_object *shm_object_table_append_shm(struct shm_object_table *table,
 struct shm_object *shm_object_table_append_mem(struct shm_object_table *table,
 			void *mem, size_t memory_map_size, int wakeup_fd);
 void shm_object_table_destroy(struct shm_object_table *table);
+int shm_object_commit(struct shm_object *obj, size_t offset, size_t len);
 
 /*
  * zalloc_shm - allocate memory within a shm object.
@@ -136,6 +138,19 @@ int shm_get_wakeup_fd(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
 	return obj->wait_fd[1];
 }
 
+static inline
+enum shm_wakeup_type shm_get_wakeup_type(struct lttng_ust_shm_handle *handle,
+		struct shm_ref *ref)
+{
+	struct shm_object_table *table = handle->table;
+	size_t index;
+
+	index = (size_t) ref->index;
+	if (caa_unlikely(index >= table->allocated_len))
+		return SHM_WAKEUP_PIPE;
+	return table->objects[index].wakeup_type;
+}
+
 static inline
 int shm_close_wait_fd(struct lttng_ust_shm_handle *handle,
 		struct shm_ref *ref)
@@ -154,6 +169,9 @@ int shm_close_wait_fd(struct lttng_ust_shm_handle *handle,
 	if (wait_fd < 0)
 		return -ENOENT;
 	obj->wait_fd[0] = -1;
+	/* An eventfd stays open while the wakeup end uses it. */
+	if (wait_fd == obj->wait_fd[1])
+		return 0;
 	ret = close(wait_fd);
 	if (ret) {
 		ret = -errno;
@@ -180,6 +198,9 @@ int shm_close_wakeup_fd(struct lttng_ust_shm_handle *handle,
 	if (wakeup_fd < 0)
 		return -ENOENT;
 	obj->wait_fd[1] = -1;
+	/* An eventfd stays open while the wait end uses it. */
+	if (wakeup_fd == obj->wait_fd[0])
+		return 0;
 	ret = close(wakeup_fd);
 	if (ret) {
 		ret = -errno;
@@ -219,4 +240,34 @@ int shm_get_shm_size(struct lttng_ust_shm_handle *handle, struct shm_ref *ref,
 	return 0;
 }
 
+static inline
+int shm_get_page_size(struct lttng_ust_shm_handle *handle, struct shm_ref *ref,
+		uint64_t *page_size)
+{
+	struct shm_object_table *table = handle->table;
+	struct shm_object *obj;
+	size_t index;
+
+	index = (size_t) ref->index;
+	if (caa_unlikely(index >= table->allocated_len))
+		return -EPERM;
+	obj = &table->objects[index];
+	*page_size = obj->page_size;
+	return 0;
+}
+
+static inline
+int shm_get_numa_node(struct lttng_ust_shm_handle *handle, struct shm_ref *ref)
+{
+	struct shm_object_table *table = handle->table;
+	struct shm_object *obj;
+	size_t index;
+
+	index = (size_t) ref->index;
+	if (caa_unlikely(index >= table->allocated_len))
+		return -EPERM;
+	obj = &table->objects[index];
+	return obj->numa_node;
+}
+
 #endif /* _LIBRINGBUFFER_SHM_H */
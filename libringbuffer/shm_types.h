@@ -32,13 +32,39 @@ enum shm_object_type {
 	SHM_OBJECT_MEM,
 };
 
+/* Mechanism used to wake up the reader of a shm object. */
+enum shm_wakeup_type {
+	SHM_WAKEUP_PIPE = 0,	/* 1 byte written into a pipe */
+	SHM_WAKEUP_EVENTFD = 1,	/* eventfd counter, same fd for wait/wakeup */
+};
+
+/* Pages backing the stream shm objects. */
+enum shm_page_type {
+	SHM_PAGE_DEFAULT = 0,	/* base pages */
+	SHM_PAGE_THP = 1,	/* transparent huge pages advised */
+	SHM_PAGE_HUGETLB = 2,	/* hugetlbfs pages, fallback on base pages */
+};
+
+/*
+ * Allocation attributes of the shm objects created for a channel by
+ * the consumer.
+ */
+struct lttng_ust_shm_attr {
+	enum shm_wakeup_type wakeup_type;
+	enum shm_page_type page_type;
+	int lazy_alloc;		/* commit sub-buffer memory on first use */
+};
+
 struct shm_object {
 	enum shm_object_type type;
 	size_t index;	/* within the object table */
 	int shm_fd;	/* shm fd */
 	int wait_fd[2];	/* fd for wait/wakeup */
+	enum shm_wakeup_type wakeup_type;
 	char *memory_map;
 	size_t memory_map_size;
+	size_t page_size;	/* size of the pages backing the map */
+	int numa_node;		/* preferred memory node, -1 if none */
 	uint64_t allocated_len;
 	int shm_fd_ownership;
 };
@@ -46,6 +72,7 @@ struct shm_object {
 struct shm_object_table {
 	size_t size;
 	size_t allocated_len;
+	struct lttng_ust_shm_attr attr;
 	struct shm_object objects[];
 };
 
@@ -21,6 +21,12 @@
 #define _GNU_SOURCE
 #include <unistd.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <dirent.h>
 #include "smp.h"
 
 int __num_possible_cpus;
@@ -42,3 +48,36 @@ void _get_num_possible_cpus(void)
 		return;
 	__num_possible_cpus = result;
 }
+
+/*
+ * NUMA node of @cpu, found as the "nodeN" link of the cpu sysfs
+ * directory. Returns -1 if unknown, e.g. without kernel NUMA support.
+ */
+int cpu_to_node(int cpu)
+{
+	char path[PATH_MAX];
+	struct dirent *entry;
+	DIR *dir;
+	int node = -1;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (!dir)
+		return -1;
+	while ((entry = readdir(dir))) {
+		char *endptr;
+		long val;
+
+		if (strncmp(entry->d_name, "node", strlen("node")))
+			continue;
+		errno = 0;
+		val = strtol(entry->d_name + strlen("node"), &endptr, 10);
+		if (errno || endptr == entry->d_name + strlen("node")
+				|| *endptr != '\0' || val < 0 || val > INT_MAX)
+			continue;
+		node = val;
+		break;
+	}
+	(void) closedir(dir);
+	return node;
+}
@@ -31,6 +31,7 @@
 
 extern int __num_possible_cpus;
 extern void _get_num_possible_cpus(void);
+extern int cpu_to_node(int cpu);
 
 static inline
 int num_possible_cpus(void)
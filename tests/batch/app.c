@@ -0,0 +1,65 @@
+/*
+ * app.c
+ *
+ * Application started by prog. For each "<nr> <len>" line read on the
+ * standard input, it emits a batch of nr records, each with a text of
+ * len characters numbering it, until the standard input is closed.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACEPOINT_DEFINE
+#include "ust_tests_batch.h"
+
+#define TEXT_MAX_LEN	512
+
+static char text[TEXT_MAX_LEN + 1];
+
+/* Same text as record_text() in prog.c. */
+static const char *record_text(unsigned int seq, unsigned int len)
+{
+	int count;
+
+	count = snprintf(text, sizeof(text), "rec-%05u", seq);
+	if (count < len)
+		memset(text + count, 'x', len - count);
+	text[len] = '\0';
+	return text;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int seq = 0, nr, len;
+	char line[64];
+
+	while (fgets(line, sizeof(line), stdin)) {
+		if (sscanf(line, "%u %u", &nr, &len) != 2
+				|| len > TEXT_MAX_LEN)
+			return 1;
+		tracepoint_batch(ust_tests_batch, record, nr, i,
+			seq + i, record_text(seq + i, len));
+		seq += nr;
+		printf("done\n");
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * prog.c
+ *
+ * Stand in for the per-user session daemon and consumer of the
+ * application given as argument, and check the records it emits with
+ * tracepoint_batch() are all written once, whether the batch fits in the
+ * staging area of the tracer or is flushed midway, when its record count
+ * or its size exceeds it.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <lttng/ust-ctl.h>
+
+#include "sessiond-stub.h"
+#include "tap.h"
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define EVENTS			"ust_tests_batch:*"
+#define TEXT_MAX_LEN		512
+
+/* Staged records are flushed every 32 records or 2048 bytes. */
+static const struct batch {
+	unsigned int nr;
+	unsigned int len;
+} batches[] = {
+	{ 0, 16 },
+	{ 1, 16 },
+	{ 32, 16 },
+	{ 100, 16 },
+	{ 20, 400 },
+};
+
+#define NUM_TESTS		(4 + 2 * ARRAY_SIZE(batches))
+
+/* Same text as record_text() in app.c. */
+static
+const char *record_text(unsigned int seq, unsigned int len)
+{
+	static char text[TEXT_MAX_LEN + 1];
+	int count;
+
+	count = snprintf(text, sizeof(text), "rec-%05u", seq);
+	if (count < len)
+		memset(text + count, 'x', len - count);
+	text[len] = '\0';
+	return text;
+}
+
+/*
+ * Ask the application to emit @batch, and wait for it to complete.
+ */
+static
+int app_batch(FILE *to_app, FILE *from_app, const struct batch *batch)
+{
+	char line[64];
+
+	if (fprintf(to_app, "%u %u\n", batch->nr, batch->len) < 0
+			|| fflush(to_app))
+		return -1;
+	if (!fgets(line, sizeof(line), from_app) || strcmp(line, "done\n"))
+		return -1;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct session s = { 0 };
+	char home[] = "/tmp/batch-home-XXXXXX";
+	int listen_fd, cmd_fd = -1, notify_fd = -1, status;
+	int to_app[2], from_app[2];
+	FILE *to_app_file, *from_app_file;
+	unsigned int i, seq, first_seq;
+	pthread_t notify_tid;
+	pid_t pid;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2 || !mkdtemp(home)) {
+		diag("Usage: %s app", argv[0]);
+		return 1;
+	}
+	listen_fd = sessiond_listen(home);
+	if (listen_fd < 0 || pipe(to_app) || pipe(from_app)) {
+		diag("Test setup failed");
+		return 1;
+	}
+	setenv("LTTNG_HOME", home, 1);
+	setenv("LTTNG_UST_WITHOUT_BADDR_STATEDUMP", "1", 1);
+	pid = fork();
+	if (pid < 0) {
+		diag("fork: %s", strerror(errno));
+		return 1;
+	}
+	if (!pid) {
+		dup2(to_app[0], STDIN_FILENO);
+		dup2(from_app[1], STDOUT_FILENO);
+		close(to_app[0]);
+		close(to_app[1]);
+		close(from_app[0]);
+		close(from_app[1]);
+		close(listen_fd);
+		execl(argv[1], argv[1], NULL);
+		_exit(127);
+	}
+	close(to_app[0]);
+	close(from_app[1]);
+	to_app_file = fdopen(to_app[1], "w");
+	from_app_file = fdopen(from_app[0], "r");
+	if (!to_app_file || !from_app_file) {
+		diag("Test setup failed");
+		return 1;
+	}
+
+	cmd_fd = sessiond_accept(listen_fd);
+	if (cmd_fd >= 0)
+		notify_fd = sessiond_accept(listen_fd);
+	ok(notify_fd >= 0 && !pthread_create(&notify_tid, NULL,
+			sessiond_notify_thread, (void *) (long) notify_fd),
+		"Accept application sockets");
+	if (notify_fd < 0)
+		return 1;
+	ok(!session_start(cmd_fd, &s, EVENTS), "Start session");
+	ok(!ustctl_register_done(cmd_fd), "Registration done");
+
+	for (i = 0; i < ARRAY_SIZE(batches); i++)
+		ok(!app_batch(to_app_file, from_app_file, &batches[i]),
+			"Emit a batch of %u records of %u bytes",
+			batches[i].nr, batches[i].len);
+
+	if (session_read(&s))
+		diag("Unable to read the session records");
+	for (i = 0, seq = 0; i < ARRAY_SIZE(batches); i++) {
+		int bad = 0;
+
+		for (first_seq = seq; seq < first_seq + batches[i].nr; seq++) {
+			int count = session_count_records(&s,
+					record_text(seq, batches[i].len));
+
+			if (count == 1)
+				continue;
+			diag("Record %u written %d times", seq, count);
+			bad++;
+		}
+		ok(!bad, "Batch of %u records of %u bytes written once",
+			batches[i].nr, batches[i].len);
+	}
+
+	fclose(to_app_file);
+	ok(waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+		&& !WEXITSTATUS(status),
+		"Application exits");
+	sessiond_cleanup(home);
+	return 0;
+}
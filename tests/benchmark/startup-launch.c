@@ -0,0 +1,365 @@
+/*
+ * startup-launch.c
+ *
+ * Start an application repeatedly and report the distribution of the
+ * metrics it prints, one JSON object per line. Optionally stand in for
+ * the per-user session daemon: accept the registration of each
+ * application and reply "registration done", so the constructor wait
+ * of liblttng-ust is measured without a real session daemon.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <lttng/ust-ctl.h>
+#include <ust-comm.h>
+
+#define MAX_METRICS		16
+#define METRIC_NAME_LEN		64
+#define ACCEPT_TIMEOUT_MS	5000
+
+struct metric {
+	char name[METRIC_NAME_LEN];
+	uint64_t *samples;
+	int nr_samples;
+};
+
+static struct metric metrics[MAX_METRICS];
+static int nr_metrics;
+static int iters = 100;
+
+extern char **environ;
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-i iterations] [-n scenario] [-p preload] [-s] -- program [args]\n",
+		prog);
+	fprintf(stderr, "  -s  stand in for the per-user session daemon in $LTTNG_HOME\n");
+}
+
+static void add_sample(const char *name, uint64_t value)
+{
+	struct metric *m;
+	int i;
+
+	for (i = 0; i < nr_metrics; i++) {
+		if (!strcmp(metrics[i].name, name))
+			break;
+	}
+	if (i == nr_metrics) {
+		if (nr_metrics == MAX_METRICS)
+			return;
+		m = &metrics[nr_metrics++];
+		snprintf(m->name, sizeof(m->name), "%s", name);
+		m->samples = calloc(iters, sizeof(*m->samples));
+		if (!m->samples)
+			abort();
+	}
+	m = &metrics[i];
+	if (m->nr_samples < iters)
+		m->samples[m->nr_samples++] = value;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void print_metrics(const char *scenario)
+{
+	int i;
+
+	for (i = 0; i < nr_metrics; i++) {
+		struct metric *m = &metrics[i];
+
+		if (!m->nr_samples)
+			continue;
+		qsort(m->samples, m->nr_samples, sizeof(*m->samples), cmp_u64);
+		printf("{\"scenario\": \"%s\", \"metric\": \"%s\", \"iterations\": %d, "
+			"\"min_ns\": %" PRIu64 ", \"median_ns\": %" PRIu64 ", "
+			"\"max_ns\": %" PRIu64 "}\n",
+			scenario, m->name, m->nr_samples, m->samples[0],
+			m->samples[m->nr_samples / 2],
+			m->samples[m->nr_samples - 1]);
+	}
+}
+
+/*
+ * Listen on the per-user application socket, like the session daemon.
+ */
+static int sessiond_listen(void)
+{
+	struct sockaddr_un sun;
+	const char *home;
+	char dir[PATH_MAX];
+	int fd;
+
+	home = getenv("LTTNG_HOME");
+	if (!home)
+		home = getenv("HOME");
+	if (!home) {
+		fprintf(stderr, "LTTNG_HOME or HOME must be set\n");
+		return -1;
+	}
+	snprintf(dir, sizeof(dir), "%s/%s", home, LTTNG_DEFAULT_HOME_RUNDIR);
+	if (mkdir(dir, 0700) && errno != EEXIST) {
+		perror("mkdir");
+		return -1;
+	}
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (snprintf(sun.sun_path, sizeof(sun.sun_path), "%s/%s", dir,
+			LTTNG_UST_SOCK_FILENAME) >= sizeof(sun.sun_path)) {
+		fprintf(stderr, "Socket path too long\n");
+		return -1;
+	}
+	unlink(sun.sun_path);
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+			|| listen(fd, LTTNG_UST_COMM_MAX_LISTEN) < 0) {
+		perror("bind");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t ret = read(fd, (char *) buf + done, len - done);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+/*
+ * Accept one registration, returns the connection socket.
+ */
+static int sessiond_accept(int listen_fd)
+{
+	struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+	struct ustctl_reg_msg reg_msg;
+	int fd;
+
+	if (poll(&pfd, 1, ACCEPT_TIMEOUT_MS) != 1) {
+		fprintf(stderr, "Application did not connect\n");
+		return -1;
+	}
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0) {
+		perror("accept");
+		return -1;
+	}
+	if (read_full(fd, &reg_msg, sizeof(reg_msg))) {
+		fprintf(stderr, "Short registration message\n");
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Accept the command and notification sockets of the application, and
+ * tell it the registration is done.
+ */
+static int sessiond_register(int listen_fd, int *cmd_fd, int *notify_fd)
+{
+	struct ustcomm_ust_msg lum;
+	struct ustcomm_ust_reply lur;
+
+	*cmd_fd = sessiond_accept(listen_fd);
+	if (*cmd_fd < 0)
+		return -1;
+	*notify_fd = sessiond_accept(listen_fd);
+	if (*notify_fd < 0)
+		return -1;
+	memset(&lum, 0, sizeof(lum));
+	lum.handle = LTTNG_UST_ROOT_HANDLE;
+	lum.cmd = LTTNG_UST_REGISTER_DONE;
+	if (write(*cmd_fd, &lum, sizeof(lum)) != sizeof(lum)
+			|| read_full(*cmd_fd, &lur, sizeof(lur))) {
+		fprintf(stderr, "Registration done command failed\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Environment of the application: ours, with its start time, the
+ * libraries to preload, and liblttng-ust writing the duration of its
+ * constructor phases to the standard output, read like the metrics of
+ * the application.
+ */
+static char **child_env(const char *preload, char *t0_buf)
+{
+	char **env;
+	int i, n = 0;
+
+	while (environ[n])
+		n++;
+	env = calloc(n + 4, sizeof(*env));
+	if (!env)
+		abort();
+	for (i = 0; i < n; i++)
+		env[i] = environ[i];
+	env[n++] = t0_buf;
+	env[n++] = "LTTNG_UST_INIT_PHASES_FD=1";
+	if (preload && preload[0]) {
+		if (asprintf(&env[n++], "LD_PRELOAD=%s", preload) < 0)
+			abort();
+	}
+	return env;
+}
+
+static int run_once(char **argv, char **env, char *t0_buf, int listen_fd)
+{
+	int out[2], cmd_fd = -1, notify_fd = -1, status, ret = 0;
+	char line[128];
+	pid_t pid;
+	FILE *f;
+
+	if (pipe(out)) {
+		perror("pipe");
+		return -1;
+	}
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		dup2(out[1], STDOUT_FILENO);
+		close(out[0]);
+		close(out[1]);
+		if (listen_fd >= 0)
+			close(listen_fd);
+		snprintf(t0_buf, 64, "STARTUP_T0_NS=%" PRIu64, clock_ns());
+		execve(argv[0], argv, env);
+		perror("execve");
+		_exit(127);
+	}
+	close(out[1]);
+	if (listen_fd >= 0 && sessiond_register(listen_fd, &cmd_fd, &notify_fd))
+		ret = -1;
+	f = fdopen(out[0], "r");
+	while (f && fgets(line, sizeof(line), f)) {
+		char name[METRIC_NAME_LEN];
+		uint64_t value;
+
+		if (sscanf(line, "%63s %" SCNu64, name, &value) == 2)
+			add_sample(name, value);
+	}
+	if (f)
+		fclose(f);
+	else
+		close(out[0]);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+			|| WEXITSTATUS(status))
+		ret = -1;
+	if (cmd_fd >= 0)
+		close(cmd_fd);
+	if (notify_fd >= 0)
+		close(notify_fd);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const char *scenario = "default", *preload = NULL;
+	int opt, i, listen_fd = -1, standin = 0;
+	char t0_buf[64] = "STARTUP_T0_NS=0";
+	char **env;
+
+	while ((opt = getopt(argc, argv, "i:n:p:s")) != -1) {
+		switch (opt) {
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		case 'n':
+			scenario = optarg;
+			break;
+		case 'p':
+			preload = optarg;
+			break;
+		case 's':
+			standin = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind >= argc || iters <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (standin) {
+		listen_fd = sessiond_listen();
+		if (listen_fd < 0)
+			return 1;
+	}
+	env = child_env(preload, t0_buf);
+	for (i = 0; i < iters; i++) {
+		if (run_once(&argv[optind], env, t0_buf, listen_fd)) {
+			fprintf(stderr, "%s: run %d failed\n", scenario, i);
+			return 1;
+		}
+	}
+	print_metrics(scenario);
+	if (listen_fd >= 0)
+		close(listen_fd);
+	return 0;
+}
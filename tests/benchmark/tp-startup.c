@@ -0,0 +1,40 @@
+/*
+ * tp-startup.c
+ *
+ * Provider library preloaded by the startup benchmark. Built once per
+ * provider, selected by STARTUP_PROVIDER_ID. It holds both the probes
+ * and the callsites of its events.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define TRACEPOINT_CREATE_PROBES
+#define TRACEPOINT_DEFINE
+
+#if STARTUP_PROVIDER_ID == 0
+#include "ust_tests_startup0.h"
+#elif STARTUP_PROVIDER_ID == 1
+#include "ust_tests_startup1.h"
+#elif STARTUP_PROVIDER_ID == 2
+#include "ust_tests_startup2.h"
+#elif STARTUP_PROVIDER_ID == 3
+#include "ust_tests_startup3.h"
+#else
+#error "Unknown STARTUP_PROVIDER_ID"
+#endif
@@ -0,0 +1,53 @@
+#ifndef _UST_TESTS_STARTUP_H
+#define _UST_TESTS_STARTUP_H
+
+/*
+ * ust_tests_startup.h
+ *
+ * Events of the providers preloaded by the startup benchmark. Each
+ * provider header expands them with its own provider name.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define STARTUP_EVENTS(_provider)					\
+	TRACEPOINT_EVENT_CLASS(_provider, cls,				\
+		TP_ARGS(int, value),					\
+		TP_FIELDS(						\
+			ctf_integer(int, value, value)			\
+		)							\
+	)								\
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev0, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev1, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev2, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev3, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev4, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev5, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev6, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev7, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev8, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev9, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev10, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev11, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev12, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev13, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev14, TP_ARGS(int, value)) \
+	TRACEPOINT_EVENT_INSTANCE(_provider, cls, ev15, TP_ARGS(int, value))
+
+#endif /* _UST_TESTS_STARTUP_H */
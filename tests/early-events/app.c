@@ -0,0 +1,56 @@
+/*
+ * app.c
+ *
+ * Application started by prog, with early event records captured. It
+ * hits the marker tracepoint before prog completes its registration,
+ * then once more each time prog asks for it on the standard input,
+ * until the standard input is closed.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACEPOINT_DEFINE
+#include "ust_tests_early.h"
+
+#define NR_MARKERS	16
+
+static void hit_markers(const char *text)
+{
+	int i;
+
+	for (i = 0; i < NR_MARKERS; i++)
+		tracepoint(ust_tests_early, marker, i, text);
+	printf("done\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	char line[64];
+
+	hit_markers("early-marker");
+	while (fgets(line, sizeof(line), stdin)) {
+		line[strcspn(line, "\n")] = '\0';
+		hit_markers(line);
+	}
+	return 0;
+}
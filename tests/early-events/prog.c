@@ -0,0 +1,152 @@
+/*
+ * prog.c
+ *
+ * Stand in for the per-user session daemon and consumer of the
+ * application given as argument, started with early event records
+ * captured, and check the records hit before its registration completed
+ * are replayed once into each session enabled meanwhile.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <lttng/ust-ctl.h>
+
+#include "sessiond-stub.h"
+#include "tap.h"
+
+#define NUM_TESTS		12
+#define NR_MARKERS		16	/* Hits per marker text, see app.c */
+#define EVENTS			"ust_tests_early:*"
+
+/*
+ * Ask the application to hit the marker NR_MARKERS times with @text, or
+ * wait for its first hits if @text is NULL.
+ */
+static
+int app_markers(FILE *to_app, FILE *from_app, const char *text)
+{
+	char line[64];
+
+	if (text && (fprintf(to_app, "%s\n", text) < 0 || fflush(to_app)))
+		return -1;
+	if (!fgets(line, sizeof(line), from_app) || strcmp(line, "done\n"))
+		return -1;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct session s1 = { 0 }, s2 = { 0 };
+	char home[] = "/tmp/early-events-home-XXXXXX";
+	int listen_fd, cmd_fd = -1, notify_fd = -1, status;
+	int to_app[2], from_app[2];
+	FILE *to_app_file, *from_app_file;
+	pthread_t notify_tid;
+	pid_t pid;
+
+	plan_tests(NUM_TESTS);
+
+	if (argc != 2 || !mkdtemp(home)) {
+		diag("Usage: %s app", argv[0]);
+		return 1;
+	}
+	listen_fd = sessiond_listen(home);
+	if (listen_fd < 0 || pipe(to_app) || pipe(from_app)) {
+		diag("Test setup failed");
+		return 1;
+	}
+	setenv("LTTNG_HOME", home, 1);
+	setenv("LTTNG_UST_EARLY_BUFFER_SIZE", "65536", 1);
+	setenv("LTTNG_UST_WITHOUT_BADDR_STATEDUMP", "1", 1);
+	pid = fork();
+	if (pid < 0) {
+		diag("fork: %s", strerror(errno));
+		return 1;
+	}
+	if (!pid) {
+		dup2(to_app[0], STDIN_FILENO);
+		dup2(from_app[1], STDOUT_FILENO);
+		close(to_app[0]);
+		close(to_app[1]);
+		close(from_app[0]);
+		close(from_app[1]);
+		close(listen_fd);
+		execl(argv[1], argv[1], NULL);
+		_exit(127);
+	}
+	close(to_app[0]);
+	close(from_app[1]);
+	to_app_file = fdopen(to_app[1], "w");
+	from_app_file = fdopen(from_app[0], "r");
+	if (!to_app_file || !from_app_file) {
+		diag("Test setup failed");
+		return 1;
+	}
+
+	/* The application runs on without waiting for its registration. */
+	ok(!app_markers(to_app_file, from_app_file, NULL),
+		"Early markers hit before registration");
+	cmd_fd = sessiond_accept(listen_fd);
+	if (cmd_fd >= 0)
+		notify_fd = sessiond_accept(listen_fd);
+	ok(notify_fd >= 0 && !pthread_create(&notify_tid, NULL,
+			sessiond_notify_thread, (void *) (long) notify_fd),
+		"Accept application sockets");
+	if (notify_fd < 0)
+		return 1;
+
+	ok(!session_start(cmd_fd, &s1, EVENTS), "Start first session");
+	ok(!ustctl_stop_session(cmd_fd, s1.handle)
+		&& !ustctl_start_session(cmd_fd, s1.handle),
+		"Restart first session");
+	ok(!app_markers(to_app_file, from_app_file, "late-marker"),
+		"Late markers hit before registration");
+	ok(!session_start(cmd_fd, &s2, EVENTS), "Start second session");
+	ok(!ustctl_register_done(cmd_fd), "Registration done");
+	ok(!app_markers(to_app_file, from_app_file, "final-marker"),
+		"Final markers hit after registration");
+
+	ok(!session_read(&s1)
+		&& session_count_records(&s1, "early-marker") == NR_MARKERS
+		&& session_count_records(&s1, "late-marker") == NR_MARKERS
+		&& session_count_records(&s1, "final-marker") == NR_MARKERS,
+		"First session has the early markers once and the others");
+	ok(!session_read(&s2)
+		&& session_count_records(&s2, "early-marker") == NR_MARKERS
+		&& session_count_records(&s2, "late-marker") == NR_MARKERS,
+		"Second session has the markers hit before it started");
+	ok(session_count_records(&s2, "final-marker") == NR_MARKERS,
+		"Second session has the final markers once");
+
+	fclose(to_app_file);
+	ok(waitpid(pid, &status, 0) == pid && WIFEXITED(status)
+		&& !WEXITSTATUS(status),
+		"Application exits");
+	sessiond_cleanup(home);
+	return 0;
+}
@@ -0,0 +1,642 @@
+/*
+ * prog.c
+ *
+ * Link filter bytecode as the tracer does, and check the interpreter,
+ * the optimized bytecode and the native code agree on the same records:
+ * integer expressions, star globbing patterns, integer array and
+ * sequence elements, sampling and rate limiting.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lttng-filter.h"
+#include "tap.h"
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+#define PROGRAM_MAX_LEN	512
+#define MAX_RECORDS	16
+
+/*
+ * Filter stack data of the test records, laid out like the probes do:
+ * integers as int64_t, arrays and sequences as their length followed
+ * by a pointer, strings as a pointer.
+ */
+struct record {
+	int64_t a;
+	int64_t b;
+	const char *str;
+	unsigned long seq_len;
+	const char *seq;
+	unsigned long elems_len;
+	const void *elems;
+};
+
+#define FIELD(name)	offsetof(struct record, name)
+
+/* Bytecode as linked, with the field references already typed. */
+struct program {
+	char data[PROGRAM_MAX_LEN];
+	uint16_t len;
+};
+
+enum variant {
+	VARIANT_INTERPRETED,
+	VARIANT_OPTIMIZED,
+	VARIANT_COMPILED,	/* optimized, then compiled if supported */
+	NR_VARIANTS,
+};
+
+static void emit(struct program *p, const void *insn, size_t len)
+{
+	if (p->len + len > PROGRAM_MAX_LEN)
+		abort();
+	memcpy(p->data + p->len, insn, len);
+	p->len += len;
+}
+
+/* Binary, unary, cast and return instructions. */
+static void emit_op(struct program *p, filter_opcode_t op)
+{
+	emit(p, &op, sizeof(op));
+}
+
+static void emit_field(struct program *p, filter_opcode_t op,
+		uint16_t offset)
+{
+	struct {
+		struct load_op insn;
+		struct field_ref ref;
+	} __attribute__((packed)) load = { { op }, { offset } };
+
+	emit(p, &load, sizeof(load));
+}
+
+static void emit_s64(struct program *p, int64_t v)
+{
+	struct {
+		struct load_op insn;
+		struct literal_numeric v;
+	} __attribute__((packed)) load = { { FILTER_OP_LOAD_S64 }, { v } };
+
+	emit(p, &load, sizeof(load));
+}
+
+static void emit_string(struct program *p, filter_opcode_t op,
+		const char *s)
+{
+	emit_op(p, op);
+	emit(p, s, strlen(s) + 1);
+}
+
+static void emit_elem(struct program *p, filter_opcode_t op,
+		uint16_t index, uint8_t elem_size, uint8_t elem_signed)
+{
+	struct {
+		struct load_op insn;
+		struct field_elem_ref ref;
+	} __attribute__((packed)) load = {
+		{ op }, { FIELD(elems_len), index, elem_size, elem_signed },
+	};
+
+	emit(p, &load, sizeof(load));
+}
+
+static void emit_aggr(struct program *p, filter_opcode_t op,
+		uint16_t nr, filter_opcode_t cmp, int64_t v)
+{
+	struct {
+		struct load_op insn;
+		struct field_aggr_ref ref;
+	} __attribute__((packed)) load = {
+		{ op }, { { FIELD(elems_len), nr, 4, 1 }, cmp, v },
+	};
+
+	emit(p, &load, sizeof(load));
+}
+
+static void emit_sample(struct program *p, uint32_t period)
+{
+	struct sample_op insn = { FILTER_OP_SAMPLE, 0, period };
+
+	emit(p, &insn, sizeof(insn));
+}
+
+static void emit_rate_limit(struct program *p, uint32_t rate,
+		uint32_t burst)
+{
+	struct rate_limit_op insn = { FILTER_OP_RATE_LIMIT, 0, rate, burst };
+
+	emit(p, &insn, sizeof(insn));
+}
+
+/* AND or OR, returns its offset, to be given to emit_skip_target(). */
+static uint16_t emit_logical(struct program *p, filter_opcode_t op)
+{
+	struct logical_op insn = { op, 0 };
+	uint16_t offset = p->len;
+
+	emit(p, &insn, sizeof(insn));
+	return offset;
+}
+
+static void emit_skip_target(struct program *p, uint16_t logical)
+{
+	struct logical_op *insn = (struct logical_op *) &p->data[logical];
+
+	insn->skip_offset = p->len;
+}
+
+/*
+ * Validate and specialize @p like _lttng_filter_event_link_bytecode(),
+ * with a single sampling state per operator.
+ */
+static struct bytecode_runtime *link_program(const struct program *p,
+		enum variant variant, int *jit_ret)
+{
+	struct bytecode_runtime *runtime;
+	void *state;
+
+	runtime = zmalloc(sizeof(*runtime) + p->len);
+	if (!runtime)
+		return NULL;
+	runtime->len = p->len;
+	runtime->nr_cpus = 1;
+	memcpy(runtime->data, p->data, p->len);
+	if (lttng_filter_validate_bytecode(runtime)
+			|| lttng_filter_specialize_bytecode(runtime))
+		goto error;
+	if (runtime->nr_sample_slots) {
+		if (posix_memalign(&state, CAA_CACHE_LINE_SIZE,
+				runtime->nr_sample_slots
+				* sizeof(struct filter_sample_state)))
+			goto error;
+		memset(state, 0, runtime->nr_sample_slots
+				* sizeof(struct filter_sample_state));
+		runtime->sample_state = state;
+	}
+	if (variant != VARIANT_INTERPRETED
+			&& lttng_filter_optimize_bytecode(runtime))
+		goto error;
+	if (variant == VARIANT_COMPILED)
+		*jit_ret = lttng_filter_jit_compile(runtime);
+	return runtime;
+
+error:
+	free(runtime->sample_state);
+	free(runtime);
+	return NULL;
+}
+
+static void free_runtime(struct bytecode_runtime *runtime)
+{
+	if (!runtime)
+		return;
+	lttng_filter_jit_free(runtime);
+	free(runtime->sample_state);
+	free(runtime);
+}
+
+static uint64_t evaluate(struct bytecode_runtime *runtime,
+		const struct record *rec)
+{
+	filter_func_t filter = lttng_filter_interpret_bytecode;
+
+	if (runtime->jit_code)
+		filter = (filter_func_t) runtime->jit_code;
+	return filter(runtime, (const char *) rec);
+}
+
+/*
+ * Evaluate @p on each record, in order, with each variant. Returns 1
+ * if they all return @expected, 0 otherwise. @jit_ret, if not NULL,
+ * receives the result of the compilation.
+ */
+static int check_program(const char *name, const struct program *p,
+		const struct record *recs, unsigned int nr_recs,
+		const uint64_t *expected, int *jit_ret)
+{
+	struct bytecode_runtime *runtime[NR_VARIANTS];
+	int i, ret = 1, compiled = -ENOTSUP;
+	unsigned int j;
+
+	for (i = 0; i < NR_VARIANTS; i++) {
+		runtime[i] = link_program(p, i, &compiled);
+		if (!runtime[i]) {
+			diag("%s: link failed", name);
+			ret = 0;
+		}
+	}
+	if (jit_ret)
+		*jit_ret = compiled;
+	for (j = 0; ret && j < nr_recs; j++) {
+		for (i = 0; i < NR_VARIANTS; i++) {
+			uint64_t result = evaluate(runtime[i], &recs[j]);
+
+			if (result == expected[j])
+				continue;
+			diag("%s: variant %d returned %" PRIu64 " on record %u, expected %" PRIu64,
+				name, i, result, j, expected[j]);
+			ret = 0;
+		}
+	}
+	for (i = 0; i < NR_VARIANTS; i++)
+		free_runtime(runtime[i]);
+	return ret;
+}
+
+/* Length of @p once optimized, 0 on error. */
+static size_t optimized_len(const struct program *p)
+{
+	struct bytecode_runtime *runtime;
+	size_t len;
+
+	runtime = link_program(p, VARIANT_OPTIMIZED, NULL);
+	if (!runtime)
+		return 0;
+	len = runtime->len;
+	free_runtime(runtime);
+	return len;
+}
+
+/*
+ * ((a > 5 && b != -3) || !(a == b)) && 7 >= 7: integer operators only,
+ * with immediates folded by the optimizer.
+ */
+static void test_integer(void)
+{
+	static const struct record recs[] = {
+		{ .a = 6, .b = 0 },
+		{ .a = 6, .b = -3 },
+		{ .a = 3, .b = 3 },
+		{ .a = 2, .b = 1 },
+		{ .a = -1, .b = -1 },
+		{ .a = INT64_MIN, .b = INT64_MAX },
+		{ .a = INT64_MAX, .b = INT64_MAX },
+	};
+	static const uint64_t expected[] = { 1, 1, 0, 1, 0, 1, 1 };
+	struct program p = { .len = 0 };
+	uint16_t and1, or1, and2;
+	int jit_ret;
+
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_S64, FIELD(a));
+	emit_s64(&p, 5);
+	emit_op(&p, FILTER_OP_GT);
+	and1 = emit_logical(&p, FILTER_OP_AND);
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_S64, FIELD(b));
+	emit_s64(&p, 3);
+	emit_op(&p, FILTER_OP_UNARY_MINUS);
+	emit_op(&p, FILTER_OP_NE);
+	emit_skip_target(&p, and1);
+	or1 = emit_logical(&p, FILTER_OP_OR);
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_S64, FIELD(a));
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_S64, FIELD(b));
+	emit_op(&p, FILTER_OP_EQ);
+	emit_op(&p, FILTER_OP_UNARY_NOT);
+	emit_skip_target(&p, or1);
+	and2 = emit_logical(&p, FILTER_OP_AND);
+	emit_s64(&p, 7);
+	emit_s64(&p, 7);
+	emit_op(&p, FILTER_OP_GE);
+	emit_skip_target(&p, and2);
+	emit_op(&p, FILTER_OP_RETURN);
+
+	ok(check_program("integer", &p, recs, ARRAY_SIZE(recs), expected,
+			&jit_ret),
+		"Integer filter: interpreted, optimized and compiled results match");
+	ok(optimized_len(&p) && optimized_len(&p) < p.len,
+		"Integer filter: optimizer folds immediates");
+#if defined(__x86_64__) || defined(__aarch64__)
+	skip_start(getenv("LTTNG_UST_WITHOUT_FILTER_JIT") || jit_ret == -EACCES
+			|| jit_ret == -EPERM, 1,
+			"Filter JIT disabled or not allowed to map code");
+	ok(!jit_ret, "Integer filter compiled to native code");
+	skip_end();
+#else
+	skip(1, "No filter JIT for this architecture");
+#endif
+}
+
+struct glob_case {
+	const char *pattern;
+	const char *candidate;
+	int seq_len;		/* -1: string field, else sequence length */
+	uint64_t match;
+};
+
+static const struct glob_case glob_cases[] = {
+	{ "", "", -1, 1 },
+	{ "", "a", -1, 0 },
+	{ "*", "", -1, 1 },
+	{ "*", "anything", -1, 1 },
+	{ "***", "a", -1, 1 },
+	{ "a*", "a", -1, 1 },
+	{ "a*", "ba", -1, 0 },
+	{ "*a", "ba", -1, 1 },
+	{ "*a", "ab", -1, 0 },
+	{ "ab", "abc", -1, 0 },
+	{ "abc", "ab", -1, 0 },
+	{ "*ab", "aab", -1, 1 },
+	{ "*aab", "aaab", -1, 1 },
+	{ "a*b*c", "aXbYc", -1, 1 },
+	{ "a*b*c", "aXbY", -1, 0 },
+	{ "*b*", "abc", -1, 1 },
+	{ "*x*", "abc", -1, 0 },
+	{ "a\\*", "a*", -1, 1 },
+	{ "a\\*", "ab", -1, 0 },
+	{ "a\\\\*", "a\\bc", -1, 1 },
+	{ "ab\\", "ab\\", -1, 1 },
+	{ "ab*", "abcd", 2, 1 },
+	{ "abc", "abcd", 3, 1 },
+	{ "abcd", "abcd", 3, 0 },
+	{ "*d", "abcd", 3, 0 },
+	{ "*", "abcd", 0, 1 },
+};
+
+/*
+ * field == "pattern", and "pattern" == field: the pattern may be on
+ * either side of the comparator.
+ */
+static void test_glob(const struct glob_case *c)
+{
+	struct record rec = { .str = c->candidate, .seq = c->candidate };
+	filter_opcode_t load;
+	struct program p;
+	int i, ret = 1;
+
+	if (c->seq_len < 0) {
+		load = FILTER_OP_LOAD_FIELD_REF_STRING;
+		rec.seq_len = 0;
+	} else {
+		load = FILTER_OP_LOAD_FIELD_REF_SEQUENCE;
+		rec.seq_len = c->seq_len;
+	}
+	for (i = 0; i < 2; i++) {
+		p.len = 0;
+		if (!i)
+			emit_field(&p, load, c->seq_len < 0 ?
+				FIELD(str) : FIELD(seq_len));
+		emit_string(&p, FILTER_OP_LOAD_STAR_GLOB_STRING, c->pattern);
+		if (i)
+			emit_field(&p, load, c->seq_len < 0 ?
+				FIELD(str) : FIELD(seq_len));
+		emit_op(&p, FILTER_OP_EQ);
+		emit_op(&p, FILTER_OP_RETURN);
+		ret &= check_program(c->pattern, &p, &rec, 1, &c->match,
+				NULL);
+	}
+	if (c->seq_len < 0)
+		ok(ret, "Glob \"%s\" %s \"%s\"", c->pattern,
+			c->match ? "matches" : "does not match",
+			c->candidate);
+	else
+		ok(ret, "Glob \"%s\" %s sequence \"%.*s\"", c->pattern,
+			c->match ? "matches" : "does not match",
+			c->seq_len, c->candidate);
+}
+
+static void test_glob_ne(void)
+{
+	static const struct record recs[] = {
+		{ .str = "lttng" },
+		{ .str = "ust" },
+	};
+	static const uint64_t expected[] = { 0, 1 };
+	struct program p = { .len = 0 };
+
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_STRING, FIELD(str));
+	emit_string(&p, FILTER_OP_LOAD_STAR_GLOB_STRING, "lt*g");
+	emit_op(&p, FILTER_OP_NE);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("glob ne", &p, recs, ARRAY_SIZE(recs), expected,
+			NULL),
+		"Glob not equal");
+}
+
+static const int32_t elems[] = { 10, -20, 30, 40 };
+static const uint8_t bytes[] = { 200, 1 };
+
+/* Four element array, and sequences of 4, 2 and no elements. */
+static const struct record elem_recs[] = {
+	{ .elems_len = 4, .elems = elems },
+	{ .elems_len = 2, .elems = elems },
+	{ .elems_len = 0, .elems = NULL },
+};
+
+/* elems[index] <cmp> v, elements loaded with @op. */
+static int check_elem(const char *name, filter_opcode_t op,
+		uint16_t index, filter_opcode_t cmp, int64_t v, int negate,
+		const struct record *recs, unsigned int nr_recs,
+		const uint64_t *expected)
+{
+	struct program p = { .len = 0 };
+
+	emit_elem(&p, op, index, sizeof(int32_t), 1);
+	emit_s64(&p, v);
+	emit_op(&p, cmp);
+	if (negate)
+		emit_op(&p, FILTER_OP_UNARY_NOT);
+	emit_op(&p, FILTER_OP_RETURN);
+	return check_program(name, &p, recs, nr_recs, expected, NULL);
+}
+
+static void test_elements(void)
+{
+	static const struct record byte_rec = {
+		.elems_len = 2, .elems = bytes,
+	};
+	static const uint64_t one = 1;
+	struct program p;
+
+	ok(check_elem("array elem", FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+			1, FILTER_OP_EQ, -20, 0, elem_recs, 1,
+			(uint64_t []) { 1 }),
+		"Array element in range");
+	ok(check_elem("array elem out of range",
+			FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+			4, FILTER_OP_NE, 12345, 0, elem_recs, 1,
+			(uint64_t []) { 0 })
+		&& check_elem("array elem out of range, negated",
+			FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+			4, FILTER_OP_EQ, 12345, 1, elem_recs, 1,
+			(uint64_t []) { 0 })
+		&& check_elem("array elem max index",
+			FILTER_OP_LOAD_FIELD_REF_ARRAY_ELEM_S64,
+			UINT16_MAX, FILTER_OP_NE, 0, 0, elem_recs, 1,
+			(uint64_t []) { 0 }),
+		"Array element out of range discards the event");
+	ok(check_elem("sequence elem",
+			FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64,
+			1, FILTER_OP_LT, 0, 0, elem_recs,
+			ARRAY_SIZE(elem_recs), (uint64_t []) { 1, 1, 0 }),
+		"Sequence element within each sequence length");
+	ok(check_elem("sequence elem past length",
+			FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64,
+			2, FILTER_OP_EQ, 30, 0, elem_recs,
+			ARRAY_SIZE(elem_recs), (uint64_t []) { 1, 0, 0 })
+		&& check_elem("sequence elem past length, negated",
+			FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64,
+			2, FILTER_OP_EQ, 0, 1, elem_recs,
+			ARRAY_SIZE(elem_recs), (uint64_t []) { 1, 0, 0 }),
+		"Sequence element past the sequence length discards the event");
+
+	p.len = 0;
+	emit_elem(&p, FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64, 0, 1, 0);
+	emit_s64(&p, 200);
+	emit_op(&p, FILTER_OP_EQ);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("unsigned byte", &p, &byte_rec, 1, &one, NULL),
+		"Unsigned byte element");
+	p.len = 0;
+	emit_elem(&p, FILTER_OP_LOAD_FIELD_REF_SEQUENCE_ELEM_S64, 0, 1, 1);
+	emit_s64(&p, -56);
+	emit_op(&p, FILTER_OP_EQ);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("signed byte", &p, &byte_rec, 1, &one, NULL),
+		"Signed byte element");
+
+	p.len = 0;
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_LEN_S64, FIELD(elems_len));
+	emit_s64(&p, 2);
+	emit_op(&p, FILTER_OP_GE);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("length", &p, elem_recs, ARRAY_SIZE(elem_recs),
+			(uint64_t []) { 1, 1, 0 }, NULL),
+		"Sequence length");
+
+	/* Aggregates only compare the elements present. */
+	p.len = 0;
+	emit_aggr(&p, FILTER_OP_LOAD_FIELD_REF_ANY_S64, 8, FILTER_OP_GT, 35);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("any", &p, elem_recs, ARRAY_SIZE(elem_recs),
+			(uint64_t []) { 1, 0, 0 }, NULL),
+		"Any element, bounded by the sequence length");
+	p.len = 0;
+	emit_aggr(&p, FILTER_OP_LOAD_FIELD_REF_ALL_S64, 8, FILTER_OP_GE, -20);
+	emit_op(&p, FILTER_OP_RETURN);
+	ok(check_program("all", &p, elem_recs, ARRAY_SIZE(elem_recs),
+			(uint64_t []) { 1, 1, 1 }, NULL),
+		"All elements, bounded by the sequence length");
+}
+
+/*
+ * The sampling state is per linked bytecode: each variant sees the same
+ * sequence of evaluations.
+ */
+static void test_sampling(void)
+{
+	struct record recs[MAX_RECORDS];
+	uint64_t expected[MAX_RECORDS];
+	struct program p;
+	uint16_t logical;
+	unsigned int i;
+
+	memset(recs, 0, sizeof(recs));
+	for (i = 0; i < MAX_RECORDS; i++)
+		recs[i].a = !(i % 2);
+
+	p.len = 0;
+	emit_sample(&p, 4);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = (i + 1) % 4 == 0;
+	ok(check_program("sample", &p, recs, MAX_RECORDS, expected, NULL),
+		"Sampling keeps one event out of period");
+
+	p.len = 0;
+	emit_sample(&p, 1);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = 1;
+	ok(check_program("sample all", &p, recs, MAX_RECORDS, expected,
+			NULL),
+		"Sampling period of 1 keeps every event");
+
+	/* a && sample(2): only the events with a set are sampled. */
+	p.len = 0;
+	emit_field(&p, FILTER_OP_LOAD_FIELD_REF_S64, FIELD(a));
+	logical = emit_logical(&p, FILTER_OP_AND);
+	emit_sample(&p, 2);
+	emit_skip_target(&p, logical);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = i % 4 == 2;
+	ok(check_program("conditional sample", &p, recs, MAX_RECORDS,
+			expected, NULL),
+		"Sampling after a condition");
+
+	/* sample(2) && sample(3): each operator has its own state. */
+	p.len = 0;
+	emit_sample(&p, 2);
+	logical = emit_logical(&p, FILTER_OP_AND);
+	emit_sample(&p, 3);
+	emit_skip_target(&p, logical);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = (i + 1) % 6 == 0;
+	ok(check_program("nested sample", &p, recs, MAX_RECORDS, expected,
+			NULL),
+		"Sampling operators have separate states");
+
+	/* 0 || sample(3): the optimizer removes the immediate. */
+	p.len = 0;
+	emit_s64(&p, 0);
+	logical = emit_logical(&p, FILTER_OP_OR);
+	emit_sample(&p, 3);
+	emit_skip_target(&p, logical);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = (i + 1) % 3 == 0;
+	ok(check_program("folded sample", &p, recs, MAX_RECORDS, expected,
+			NULL),
+		"Sampling after a folded immediate");
+
+	/* The burst is kept back-to-back, the rate allows no more. */
+	p.len = 0;
+	emit_rate_limit(&p, 1, 3);
+	emit_op(&p, FILTER_OP_RETURN);
+	for (i = 0; i < MAX_RECORDS; i++)
+		expected[i] = i < 3;
+	ok(check_program("rate limit", &p, recs, MAX_RECORDS, expected,
+			NULL),
+		"Rate limiting keeps the burst");
+}
+
+#define NUM_TESTS	(3 + ARRAY_SIZE(glob_cases) + 1 + 9 + 6)
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	plan_tests(NUM_TESTS);
+
+	test_integer();
+	for (i = 0; i < ARRAY_SIZE(glob_cases); i++)
+		test_glob(&glob_cases[i]);
+	test_glob_ne();
+	test_elements();
+	test_sampling();
+	return 0;
+}
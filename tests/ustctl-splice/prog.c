@@ -0,0 +1,150 @@
+/*
+ * prog.c
+ *
+ * Check that ustctl_splice_subbuf() hands off the packet contents as
+ * they were when spliced, even once the sub-buffer is put and the writer
+ * wraps around and overwrites it.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <lttng/ust-ctl.h>
+
+#include "tap.h"
+
+#define NUM_TESTS	8
+
+static
+int tmp_fd(void)
+{
+	char path[] = "/tmp/ustctl-splice-XXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd >= 0)
+		(void) unlink(path);
+	return fd;
+}
+
+static
+int read_full(int fd, char *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < len) {
+		ret = read(fd, buf + done, len - done);
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+/* Fill and deliver one packet of @c, then wait for it to be readable. */
+static
+int write_packet(struct ustctl_consumer_channel *chan,
+		struct ustctl_consumer_stream *stream, char *buf,
+		size_t len, char c)
+{
+	memset(buf, c, len);
+	if (ustctl_write_one_packet_to_channel(chan, buf, len) <= 0)
+		return -1;
+	ustctl_flush_buffer(stream, 1);
+	return ustctl_get_next_subbuf(stream);
+}
+
+int main(int argc, char **argv)
+{
+	struct ustctl_consumer_channel_attr attr;
+	struct ustctl_consumer_channel *chan;
+	struct ustctl_consumer_stream *stream;
+	unsigned long len, offset, wrapped_offset;
+	char *base, *buf, *expected, *got;
+	size_t page_size = sysconf(_SC_PAGE_SIZE);
+	int pipe_fd[2], file_fd, stream_fd;
+
+	plan_tests(NUM_TESTS);
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = LTTNG_UST_CHAN_METADATA;
+	attr.subbuf_size = page_size;
+	attr.num_subbuf = 2;
+	attr.output = LTTNG_UST_MMAP;
+	stream_fd = tmp_fd();
+	file_fd = tmp_fd();
+	buf = malloc(page_size);
+	expected = malloc(page_size);
+	got = malloc(page_size);
+	if (stream_fd < 0 || file_fd < 0 || pipe(pipe_fd)
+			|| !buf || !expected || !got) {
+		diag("Test setup failed");
+		return 1;
+	}
+	chan = ustctl_create_channel(&attr, &stream_fd, 1);
+	ok(chan != NULL, "Create metadata channel");
+	if (!chan)
+		return 1;
+	stream = ustctl_create_stream(chan, 0);
+	ok(stream != NULL, "Create metadata stream");
+	if (!stream)
+		return 1;
+
+	ok(!write_packet(chan, stream, buf, page_size, 'A')
+		&& !ustctl_get_padded_subbuf_size(stream, &len)
+		&& !ustctl_get_mmap_read_offset(stream, &offset),
+		"Get first packet");
+	base = ustctl_get_mmap_base(stream);
+	memcpy(expected, base + offset, len);
+
+	ok(ustctl_splice_subbuf(stream, pipe_fd[1], len) == len,
+		"Splice packet to pipe");
+	ok(ustctl_splice_subbuf(stream, file_fd, len) == len,
+		"Splice packet to regular file");
+	(void) ustctl_put_next_subbuf(stream);
+
+	/* Overwrite both sub-buffers, the spliced one last. */
+	wrapped_offset = -1UL;
+	if (!write_packet(chan, stream, buf, page_size, 'B')
+			&& !ustctl_put_next_subbuf(stream)
+			&& !write_packet(chan, stream, buf, page_size, 'C')
+			&& !ustctl_get_mmap_read_offset(stream, &wrapped_offset))
+		(void) ustctl_put_next_subbuf(stream);
+	ok(wrapped_offset == offset
+		&& memcmp(base + offset, expected, len),
+		"Writer overwrote the spliced sub-buffer");
+
+	ok(!read_full(pipe_fd[0], got, len) && !memcmp(got, expected, len),
+		"Pipe holds the packet as spliced");
+	ok(pread(file_fd, got, len, 0) == len && !memcmp(got, expected, len),
+		"File holds the packet as spliced");
+
+	ustctl_destroy_stream(stream);
+	ustctl_destroy_channel(chan);
+	free(got);
+	free(expected);
+	free(buf);
+	return 0;
+}
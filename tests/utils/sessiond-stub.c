@@ -0,0 +1,300 @@
+/*
+ * sessiond-stub.c
+ *
+ * Stand in for the per-user session daemon and the consumer of a traced
+ * application: registration, sessions with per-cpu channels, and reading
+ * back their records.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <lttng/ust-ctl.h>
+#include <ust-comm.h>
+
+#include "sessiond-stub.h"
+
+#define ACCEPT_TIMEOUT_MS	5000
+
+static
+int tmp_fd(void)
+{
+	char path[] = "/tmp/sessiond-stub-XXXXXX";
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd >= 0)
+		(void) unlink(path);
+	return fd;
+}
+
+static
+int read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t ret = read(fd, (char *) buf + done, len - done);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+	return 0;
+}
+
+/*
+ * Listen on the per-user application socket of @home.
+ */
+int sessiond_listen(const char *home)
+{
+	struct sockaddr_un sun;
+	char dir[PATH_MAX];
+	int fd;
+
+	snprintf(dir, sizeof(dir), "%s/%s", home, LTTNG_DEFAULT_HOME_RUNDIR);
+	if (mkdir(dir, 0700) && errno != EEXIST)
+		return -1;
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (snprintf(sun.sun_path, sizeof(sun.sun_path), "%s/%s", dir,
+			LTTNG_UST_SOCK_FILENAME) >= sizeof(sun.sun_path))
+		return -1;
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+	if (bind(fd, (struct sockaddr *) &sun, sizeof(sun)) < 0
+			|| listen(fd, LTTNG_UST_COMM_MAX_LISTEN) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void sessiond_cleanup(const char *home)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%s/%s", home,
+		LTTNG_DEFAULT_HOME_RUNDIR, LTTNG_UST_SOCK_FILENAME);
+	(void) unlink(path);
+	snprintf(path, sizeof(path), "%s/%s", home, LTTNG_DEFAULT_HOME_RUNDIR);
+	(void) rmdir(path);
+	(void) rmdir(home);
+}
+
+/*
+ * Accept one registration, returns the connection socket.
+ */
+int sessiond_accept(int listen_fd)
+{
+	struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+	struct ustctl_reg_msg reg_msg;
+	int fd;
+
+	if (poll(&pfd, 1, ACCEPT_TIMEOUT_MS) != 1)
+		return -1;
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+		return -1;
+	if (read_full(fd, &reg_msg, sizeof(reg_msg))) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Reply to the event and channel registrations of the application,
+ * until it closes its notification socket.
+ */
+void *sessiond_notify_thread(void *arg)
+{
+	int fd = (int) (long) arg;
+	uint32_t event_id = 0;
+
+	for (;;) {
+		enum ustctl_notify_cmd cmd;
+		char name[LTTNG_UST_SYM_NAME_LEN];
+		struct ustctl_field *fields;
+		char *signature, *uri;
+		int session_objd, channel_objd, loglevel;
+		size_t nr_fields;
+
+		if (ustctl_recv_notify(fd, &cmd))
+			break;
+		switch (cmd) {
+		case USTCTL_NOTIFY_CMD_EVENT:
+			if (ustctl_recv_register_event(fd, &session_objd,
+					&channel_objd, name, &loglevel,
+					&signature, &nr_fields, &fields, &uri))
+				return NULL;
+			free(signature);
+			free(fields);
+			free(uri);
+			if (ustctl_reply_register_event(fd, event_id++, 0))
+				return NULL;
+			break;
+		case USTCTL_NOTIFY_CMD_CHANNEL:
+			if (ustctl_recv_register_channel(fd, &session_objd,
+					&channel_objd, &nr_fields, &fields))
+				return NULL;
+			free(fields);
+			if (ustctl_reply_register_channel(fd, 0,
+					USTCTL_CHANNEL_HEADER_LARGE, 0))
+				return NULL;
+			break;
+		default:
+			return NULL;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Create a session recording the events matching @event in a per-cpu
+ * channel, with its streams, and start it.
+ */
+int session_start(int cmd_fd, struct session *s, const char *event)
+{
+	struct ustctl_consumer_channel_attr attr;
+	struct lttng_ust_object_data *chan_data, *stream_data, *event_data;
+	struct lttng_ust_event ev;
+	int i, nr_stream_fds, *stream_fds, consumer_fds[2];
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = LTTNG_UST_CHAN_PER_CPU;
+	attr.subbuf_size = 4 * sysconf(_SC_PAGE_SIZE);
+	attr.num_subbuf = 2;
+	attr.output = LTTNG_UST_MMAP;
+	nr_stream_fds = ustctl_get_nr_stream_per_channel();
+	stream_fds = calloc(nr_stream_fds, sizeof(*stream_fds));
+	s->streams = calloc(nr_stream_fds, sizeof(*s->streams));
+	if (!stream_fds || !s->streams)
+		return -1;
+	for (i = 0; i < nr_stream_fds; i++) {
+		stream_fds[i] = tmp_fd();
+		if (stream_fds[i] < 0)
+			return -1;
+	}
+	s->chan = ustctl_create_channel(&attr, stream_fds, nr_stream_fds);
+	free(stream_fds);
+	if (!s->chan)
+		return -1;
+
+	/* Hand the channel and its streams over, like the consumer. */
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, consumer_fds))
+		return -1;
+	s->handle = ustctl_create_session(cmd_fd);
+	if (s->handle < 0
+			|| ustctl_send_channel_to_sessiond(consumer_fds[0], s->chan)
+			|| ustctl_recv_channel_from_consumer(consumer_fds[1],
+				&chan_data)
+			|| ustctl_send_channel_to_ust(cmd_fd, s->handle,
+				chan_data))
+		return -1;
+	for (i = 0; i < nr_stream_fds; i++) {
+		struct ustctl_consumer_stream *stream;
+
+		stream = ustctl_create_stream(s->chan, i);
+		if (!stream)
+			continue;
+		s->streams[s->nr_streams++] = stream;
+		if (ustctl_send_stream_to_sessiond(consumer_fds[0], stream)
+				|| ustctl_recv_stream_from_consumer(
+					consumer_fds[1], &stream_data)
+				|| ustctl_send_stream_to_ust(cmd_fd, chan_data,
+					stream_data))
+			return -1;
+	}
+	close(consumer_fds[0]);
+	close(consumer_fds[1]);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.instrumentation = LTTNG_UST_TRACEPOINT;
+	strncpy(ev.name, event, LTTNG_UST_SYM_NAME_LEN - 1);
+	ev.loglevel_type = LTTNG_UST_LOGLEVEL_ALL;
+	ev.loglevel = -1;
+	if (ustctl_create_event(cmd_fd, &ev, chan_data, &event_data)
+			|| ustctl_enable(cmd_fd, event_data))
+		return -1;
+	return ustctl_start_session(cmd_fd, s->handle);
+}
+
+/*
+ * Flush the streams of @s and append all their sub-buffers to its
+ * records.
+ */
+int session_read(struct session *s)
+{
+	int i;
+
+	for (i = 0; i < s->nr_streams; i++) {
+		struct ustctl_consumer_stream *stream = s->streams[i];
+
+		ustctl_flush_buffer(stream, 1);
+		while (!ustctl_get_next_subbuf(stream)) {
+			unsigned long offset, len;
+			char *records;
+
+			if (ustctl_get_mmap_read_offset(stream, &offset)
+					|| ustctl_get_padded_subbuf_size(stream,
+						&len))
+				return -1;
+			records = realloc(s->records, s->records_len + len);
+			if (!records)
+				return -1;
+			memcpy(records + s->records_len,
+				(char *) ustctl_get_mmap_base(stream) + offset,
+				len);
+			s->records = records;
+			s->records_len += len;
+			(void) ustctl_put_next_subbuf(stream);
+		}
+	}
+	return 0;
+}
+
+/* Number of records of @s with @text as string field. */
+int session_count_records(struct session *s, const char *text)
+{
+	size_t len = strlen(text) + 1;
+	const char *p = s->records, *end = s->records + s->records_len;
+	int count = 0;
+
+	while (p && (p = memmem(p, end - p, text, len))) {
+		count++;
+		p += len;
+	}
+	return count;
+}
@@ -0,0 +1,52 @@
+#ifndef _SESSIOND_STUB_H
+#define _SESSIOND_STUB_H
+
+/*
+ * sessiond-stub.h
+ *
+ * Stand in for the per-user session daemon and the consumer of a traced
+ * application.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+
+struct ustctl_consumer_channel;
+struct ustctl_consumer_stream;
+
+struct session {
+	int handle;
+	struct ustctl_consumer_channel *chan;
+	struct ustctl_consumer_stream **streams;
+	int nr_streams;
+	char *records;			/* Sub-buffers read, end to end */
+	size_t records_len;
+};
+
+int sessiond_listen(const char *home);
+void sessiond_cleanup(const char *home);
+int sessiond_accept(int listen_fd);
+void *sessiond_notify_thread(void *arg);
+
+int session_start(int cmd_fd, struct session *s, const char *event);
+int session_read(struct session *s);
+int session_count_records(struct session *s, const char *text);
+
+#endif /* _SESSIOND_STUB_H */